@@ -0,0 +1,48 @@
+//! Benchmark of the read-to-genome comparison of the seed search: reads cut from the ERCC
+//! reference at random suffix array entries, with random mismatches, are compared to these
+//! entries with STAR's vector comparison and with a byte-by-byte loop. Fails if they disagree.
+//!
+//! Run with `cargo bench --features compare-benchmark [-- <genome dir>]`
+
+use std::ffi::CString;
+use std::os::raw::{c_char, c_int};
+
+const ERCC_REF: &str = "test/ercc92-1.2.0/star/";
+const N_READS: usize = 200_000;
+
+/// Seconds taken by the vector and the byte-by-byte comparison of `n` reads of `read_len`
+/// bases, and the number of reads on which they disagree
+fn compare(genome_dir: &str, n: usize, read_len: usize) -> (f64, f64, usize) {
+    let args: Vec<CString> = ["STAR", "--genomeDir", genome_dir]
+        .iter()
+        .map(|s| CString::new(*s).unwrap())
+        .collect();
+    let argv: Vec<*const c_char> = args.iter().map(|s| s.as_ptr()).collect();
+    let (mut vector_seconds, mut scalar_seconds) = (0.0, 0.0);
+    let n_diff = unsafe {
+        star_sys::compare_benchmark(
+            argv.len() as c_int,
+            argv.as_ptr(),
+            n,
+            read_len,
+            &mut vector_seconds,
+            &mut scalar_seconds,
+        )
+    };
+    (vector_seconds, scalar_seconds, n_diff)
+}
+
+fn main() {
+    // cargo bench passes --bench to the binary
+    let genome_dir = std::env::args()
+        .skip(1)
+        .find(|arg| !arg.starts_with("--"))
+        .unwrap_or_else(|| ERCC_REF.to_string());
+    for read_len in [30, 91, 150] {
+        let (vector_seconds, scalar_seconds, n_diff) = compare(&genome_dir, N_READS, read_len);
+        println!(
+            "{read_len} bp: vector {vector_seconds:.4}s, byte-by-byte {scalar_seconds:.4}s per {N_READS} reads"
+        );
+        assert_eq!(n_diff, 0, "the comparisons disagree on {n_diff} reads");
+    }
+}
@@ -0,0 +1,63 @@
+//! Benchmark of `StarSettings::huge_pages`: the reads of test/test_ercc_reads.fastq are aligned
+//! with a reference index on normal pages, then on transparent huge pages, and the mean time
+//! per read of each is reported with the number of huge pages obtained.
+//!
+//! Run with `cargo bench --bench huge_pages [-- <genome dir> [<fastq>]]`. The ERCC reference is
+//! too small for the TLB to matter, pass a full genome to see a difference
+
+use orbit::{HugePages, StarReference, StarSettings};
+use std::time::Instant;
+
+const ERCC_REF: &str = "test/ercc92-1.2.0/star/";
+const ERCC_READS: &str = "test/test_ercc_reads.fastq";
+const N_PASSES: usize = 20;
+
+/// Names, sequences and qualities of the reads of a fastq file
+fn read_fastq(path: &str) -> Vec<(Vec<u8>, Vec<u8>, Vec<u8>)> {
+    let text = std::fs::read(path).unwrap();
+    let lines: Vec<&[u8]> = text.split(|&c| c == b'\n').collect();
+    lines
+        .chunks_exact(4)
+        .map(|read| (read[0][1..].to_vec(), read[1].to_vec(), read[3].to_vec()))
+        .collect()
+}
+
+/// Mean seconds per read of aligning `reads` `N_PASSES` times after one warm-up pass, and the
+/// huge pages obtained out of the total
+fn time_reads(
+    settings: StarSettings,
+    reads: &[(Vec<u8>, Vec<u8>, Vec<u8>)],
+) -> (f64, (usize, usize)) {
+    let reference = StarReference::load(settings).unwrap();
+    let mut aligner = reference.get_aligner();
+    for (name, read, qual) in reads {
+        aligner.align_read(name, read, qual);
+    }
+    let start = Instant::now();
+    for _ in 0..N_PASSES {
+        for (name, read, qual) in reads {
+            aligner.align_read(name, read, qual);
+        }
+    }
+    let seconds = start.elapsed().as_secs_f64() / (N_PASSES * reads.len()) as f64;
+    (seconds, reference.huge_pages())
+}
+
+fn main() {
+    // cargo bench passes --bench to the binary
+    let args: Vec<String> = std::env::args()
+        .skip(1)
+        .filter(|arg| !arg.starts_with("--"))
+        .collect();
+    let genome_dir = args.get(0).map_or(ERCC_REF, String::as_str);
+    let reads = read_fastq(args.get(1).map_or(ERCC_READS, String::as_str));
+
+    let (normal_seconds, _) = time_reads(StarSettings::new(genome_dir), &reads);
+    let settings = StarSettings::new(genome_dir).huge_pages(HugePages::Transparent);
+    let (huge_seconds, (huge_pages, total)) = time_reads(settings, &reads);
+    println!(
+        "normal pages: {:.2} us per read, huge pages ({huge_pages} of {total}): {:.2} us per read",
+        normal_seconds * 1e6,
+        huge_seconds * 1e6
+    );
+}
@@ -5,14 +5,21 @@ use rust_htslib::bam;
 use rust_htslib::bam::header::{Header, HeaderRecord};
 use rust_htslib::bam::HeaderView;
 use star_sys::{self as bindings, Aligner as BindAligner, StarRef as BindRef};
+use std::collections::{BTreeMap, HashMap};
+use std::convert::TryInto;
 use std::ffi::{CStr, CString};
-use std::fs::File;
-use std::io::prelude::*;
-use std::io::BufReader;
-use std::os::raw::{c_char, c_int};
+use std::future::Future;
+use std::os::raw::{c_char, c_int, c_void};
+use std::os::unix::ffi::OsStrExt;
+use std::panic::{self, AssertUnwindSafe};
 use std::path::Path;
+use std::pin::Pin;
 use std::slice;
-use std::sync::Arc;
+use std::sync::atomic::{AtomicBool, AtomicU64, Ordering};
+use std::sync::{mpsc, Arc, Condvar, Mutex};
+use std::task::{Context, Poll, Waker};
+use std::thread;
+use std::time::Duration;
 
 pub struct StarReference {
     inner: Arc<InnerStarReference>,
@@ -43,9 +50,6 @@ impl StarReference {
     /// index will be free'd when all `Aligner`s that use this `StarReference`
     /// have been dropped.
     pub fn load(settings: StarSettings) -> Result<StarReference, Error> {
-        // Load headers
-        let (header, header_view) = generate_header(&settings.reference_path);
-
         // Load reference
         let nvec = settings
             .args
@@ -56,6 +60,17 @@ impl StarReference {
         let length = nvec.len() as c_int;
 
         let reference = unsafe { bindings::init_star_ref(length, c_args.as_ptr()) };
+        let error = unsafe { bindings::ref_load_error(reference) };
+        if !error.is_null() {
+            let error = unsafe { CStr::from_ptr(error) }
+                .to_string_lossy()
+                .into_owned();
+            unsafe { bindings::destroy_ref(reference) };
+            return Err(format_err!("{}", error.trim_end()));
+        }
+
+        // Load headers
+        let (header, header_view) = generate_header(reference);
 
         let inner = InnerStarReference {
             reference,
@@ -81,8 +96,160 @@ impl StarReference {
         &self.inner.as_ref().settings.reference_path
     }
 
+    /// Create an aligner. With `NumaPlacement::Replicate` it uses the replica of the reference on
+    /// the NUMA node of the calling thread
     pub fn get_aligner(&self) -> StarAligner {
-        StarAligner::new(self.inner.clone())
+        StarAligner::new(self.inner.clone(), None)
+    }
+
+    /// Create an aligner that uses the replica of the reference on NUMA node `node`, or the main
+    /// copy if there is none. The aligner should run on a thread bound to that node, see
+    /// `bind_thread_to_numa_node`
+    pub fn get_aligner_on_numa_node(&self, node: usize) -> StarAligner {
+        StarAligner::new(self.inner.clone(), Some(node))
+    }
+
+    /// The NUMA nodes the reference index was placed on by `StarSettings::numa`: the node of
+    /// each replica, or the nodes it is interleaved over. Empty if it was not placed, including
+    /// on hosts with a single node
+    pub fn numa_nodes(&self) -> Vec<usize> {
+        let reference = self.inner.reference;
+        let n = unsafe { bindings::ref_numa_nodes(reference, std::ptr::null_mut(), 0) };
+        let mut nodes = vec![0; n];
+        unsafe { bindings::ref_numa_nodes(reference, nodes.as_mut_ptr(), n) };
+        nodes.into_iter().map(|node| node as usize).collect()
+    }
+
+    /// Write the loaded reference into a single file, which `StarSettings::new` accepts in place of
+    /// the genome directory. Loading a bundle maps it without parsing any text files, like
+    /// `StarSettings::mmap`. The file is written under a temporary name and renamed when complete
+    pub fn write_bundle(&self, path: impl AsRef<Path>) -> Result<(), Error> {
+        let path = CString::new(path.as_ref().as_os_str().as_bytes())?;
+        write_result(unsafe { bindings::write_ref_bundle(self.inner.reference, path.as_ptr()) })
+    }
+
+    /// Write the checksums of the index files into the reference directory, so that later loads
+    /// can check them with `StarSettings::verify_checksums`. Only needed for reference
+    /// directories generated before checksums were written, and only while they are known to be
+    /// intact
+    pub fn write_checksums(&self) -> Result<(), Error> {
+        write_result(unsafe { bindings::write_ref_checksums(self.inner.reference) })
+    }
+
+    /// Write the common prefix lengths of neighbouring suffix array entries into the reference
+    /// directory, so that loads with `StarSettings::sa_lcp` read them instead of computing them
+    pub fn write_sa_lcp(&self) -> Result<(), Error> {
+        write_result(unsafe { bindings::write_ref_sa_lcp(self.inner.reference) })
+    }
+
+    /// How many of the 2 MB pages holding the reference index are huge pages, out of the total,
+    /// as counted after loading it. Both are 0 unless `StarSettings::huge_pages` was used
+    pub fn huge_pages(&self) -> (usize, usize) {
+        let (mut huge, mut total) = (0, 0);
+        unsafe { bindings::ref_huge_pages(self.inner.reference, &mut huge, &mut total) };
+        (huge, total)
+    }
+
+    /// Read every page of the parts of the reference index selected by `level`, using all CPUs,
+    /// so that the page faults of a mapped or shared-memory reference are taken now rather than
+    /// by the first reads. Returns the time spent on each part
+    pub fn warm_up(&self, level: WarmUpLevel) -> WarmUpTiming {
+        let level = match level {
+            WarmUpLevel::SuffixArrayIndex => 0,
+            WarmUpLevel::Genome => 1,
+            WarmUpLevel::All => 2,
+        };
+        let n_threads = thread::available_parallelism().map_or(1, usize::from);
+        let mut timing = bindings::OrbitWarmUpTiming::default();
+        unsafe { bindings::ref_warm_up(self.inner.reference, level, n_threads, &mut timing) };
+        WarmUpTiming {
+            suffix_array_index: Duration::from_secs_f64(timing.sa_index_seconds),
+            genome: Duration::from_secs_f64(timing.genome_seconds),
+            suffix_array: Duration::from_secs_f64(timing.sa_seconds),
+        }
+    }
+
+    /// Start a pool of `n_threads` aligners of this reference, which align reads submitted
+    /// without blocking and allows at most `capacity` reads in flight.
+    pub fn align_pool(&self, n_threads: usize, capacity: usize) -> AlignPool {
+        AlignPool::new(self.inner.clone(), n_threads, capacity)
+    }
+
+    /// Align a stream of reads or read pairs on `n_threads` aligners of this reference, and
+    /// return an iterator over their alignments in input order.  Reads are dealt round-robin to
+    /// the aligners in batches of `batch_size`, each aligned with a single call into STAR.  At most
+    /// `2 * n_threads` batches are in flight, so the input is only pulled as fast as the
+    /// alignments are consumed.
+    pub fn align_stream<I>(
+        &self,
+        reads: I,
+        n_threads: usize,
+        batch_size: usize,
+    ) -> AlignStream<I::Item>
+    where
+        I: IntoIterator,
+        I::IntoIter: Send + 'static,
+        I::Item: StreamRead,
+    {
+        assert!(n_threads > 0 && batch_size > 0);
+        let max_in_flight = 2 * n_threads;
+        // A slot in `credits` is taken for each batch sent and released when it is consumed
+        let (credit_tx, credit_rx) = mpsc::sync_channel::<()>(max_in_flight);
+        let (done_tx, done_rx) = mpsc::sync_channel(max_in_flight);
+        // Each aligner has its own work channel, and batches are dealt round-robin: the batches
+        // are consumed in input order, so no aligner can run further ahead than its share
+        let (work_txs, work_rxs): (Vec<_>, Vec<_>) = (0..n_threads)
+            .map(|_| mpsc::sync_channel::<(usize, Vec<I::Item>)>(max_in_flight / n_threads))
+            .unzip();
+
+        let mut threads = Vec::with_capacity(n_threads + 1);
+        let mut reads = reads.into_iter();
+        threads.push(thread::spawn(move || {
+            for index in 0.. {
+                let batch: Vec<_> = reads.by_ref().take(batch_size).collect();
+                if batch.is_empty() || credit_tx.send(()).is_err() {
+                    break;
+                }
+                if work_txs[index % n_threads].send((index, batch)).is_err() {
+                    break;
+                }
+            }
+        }));
+        // With a replicated reference the aligners are spread over the NUMA nodes, each one
+        // running on the node of its replica
+        let nodes = self.numa_nodes();
+        for (i, work_rx) in work_rxs.into_iter().enumerate() {
+            let mut aligner = match nodes.get(i % nodes.len().max(1)) {
+                Some(&node) => self.get_aligner_on_numa_node(node),
+                None => self.get_aligner(),
+            };
+            let numa_node = aligner.numa_node();
+            let done_tx = done_tx.clone();
+            threads.push(thread::spawn(move || {
+                if let Some(node) = numa_node {
+                    bind_thread_to_numa_node(node);
+                }
+                for (index, batch) in work_rx {
+                    // A panic is handed to the consumer, which would otherwise wait for this batch
+                    let alns = panic::catch_unwind(AssertUnwindSafe(|| {
+                        I::Item::align_batch(&mut aligner, &batch)
+                    }));
+                    let failed = alns.is_err();
+                    if done_tx.send((index, alns)).is_err() || failed {
+                        break;
+                    }
+                }
+            }));
+        }
+
+        AlignStream {
+            done_rx,
+            credit_rx,
+            pending: BTreeMap::new(),
+            next_index: 0,
+            current: Vec::new().into_iter(),
+            threads,
+        }
     }
 }
 
@@ -128,6 +295,93 @@ impl StarSettings {
         self
     }
 
+    /// Place the reference index on the NUMA nodes of a multi-socket host, so that aligners on
+    /// every socket read it from local memory. Does nothing on hosts with a single node, see
+    /// `StarReference::numa_nodes` for the placement that was used. Not used with `mmap`, and
+    /// `StarReference::load` fails with a bundle
+    pub fn numa(self, placement: NumaPlacement) -> Self {
+        let placement = match placement {
+            NumaPlacement::Interleave => "Interleave",
+            NumaPlacement::Replicate => "Replicate",
+        };
+        self.arg("--genomeNUMA").arg(placement)
+    }
+
+    /// Memory-map the reference files read-only instead of loading a private copy of them, so
+    /// that processes aligning to the same reference share it through the page cache and load it
+    /// instantly once it is cached
+    pub fn mmap(self, advice: MmapAdvice) -> Self {
+        let advice = match advice {
+            MmapAdvice::OnDemand => "None",
+            MmapAdvice::Populate => "Populate",
+            MmapAdvice::WillNeed => "WillNeed",
+            MmapAdvice::Random => "Random",
+        };
+        self.arg("--genomeLoad")
+            .arg("Mmap")
+            .arg("--genomeMmapAdvice")
+            .arg(advice)
+    }
+
+    /// Back the reference index with 2 MB huge pages, which reduces TLB misses during the seed
+    /// search. Falls back to normal pages when huge pages are not available, see
+    /// `StarReference::huge_pages` for how many were obtained. Not used with `mmap`
+    pub fn huge_pages(self, source: HugePages) -> Self {
+        let source = match source {
+            HugePages::Transparent => "Transparent",
+            HugePages::Hugetlb => "Hugetlb",
+        };
+        self.arg("--genomeHugePages").arg(source)
+    }
+
+    /// Check the loaded index against the checksums of its files, in parallel: `StarReference::load`
+    /// returns an error if a file is truncated or corrupted, or if the reference is a bundle. See
+    /// `StarReference::write_checksums`
+    pub fn verify_checksums(self) -> Self {
+        self.arg("--genomeChecksums").arg("Verify")
+    }
+
+    /// Narrow the seed search with the common prefix lengths of neighbouring suffix array
+    /// entries, instead of comparing the read to the genome at each step once the range is
+    /// small. Uses 1 byte per suffix array entry, computed while loading unless written with
+    /// `StarReference::write_sa_lcp`. Alignments are unchanged. `StarReference::load` fails with a
+    /// bundle
+    pub fn sa_lcp(self) -> Self {
+        self.arg("--genomeSAlcp").arg("Use")
+    }
+
+    /// Hash the `k`-base prefixes of the suffixes while loading, so that the seed search starts
+    /// from the suffix array range of a seed's first `k` bases. Only the suffixes of the index
+    /// prefixes with at least `range_min` of them are hashed, using 16 bytes per distinct `k`-mer
+    /// at a load of at most 1/2. `k` must be longer than the index prefixes, and at most 31.
+    /// Alignments are unchanged. `StarReference::load` fails with a bundle. Not used with a
+    /// reference generated with a shorter `--genomeSuffixLengthMax`
+    pub fn sa_hash(self, k: usize, range_min: usize) -> Self {
+        self.arg("--genomeSAhashNbases")
+            .arg(&k.to_string())
+            .arg("--genomeSAhashRangeMin")
+            .arg(&range_min.to_string())
+    }
+
+    /// Re-encode the suffix array after loading it with 40-bit byte-aligned entries, which are
+    /// decoded with a single load. Uses about 20% more memory for the suffix array. Only with a
+    /// private copy of the reference, i.e. not with `mmap` or `shared_memory`
+    pub fn byte_aligned_suffix_array(self) -> Self {
+        self.arg("--genomeSAencoding").arg("Byte40")
+    }
+
+    /// Load the reference into a POSIX shared memory segment keyed by the reference path. The
+    /// first process creates the segment and loads the reference into it, later processes attach
+    /// to it and wait until it is loaded. The segment is reference counted, see
+    /// `SharedMemoryMode` for when it is removed
+    pub fn shared_memory(self, mode: SharedMemoryMode) -> Self {
+        let mode = match mode {
+            SharedMemoryMode::Keep => "LoadAndKeep",
+            SharedMemoryMode::RemoveWithLast => "LoadAndRemove",
+        };
+        self.arg("--genomeLoad").arg(mode)
+    }
+
     /// Add the given read group strings to the arguments
     pub fn add_rg(&mut self, rg_tags: Vec<String>) {
         self.args.push("--outSAMattrRGline".to_string());
@@ -139,6 +393,10 @@ impl StarSettings {
     /// Provide an estimate of the memory usage (in bytes) of the reference
     pub fn est_mem(&self) -> Result<usize, Error> {
         let refpath = Path::new(&self.reference_path);
+        if refpath.is_file() {
+            // a bundle written by `StarReference::write_bundle`
+            return Ok(std::fs::metadata(refpath)?.len() as usize);
+        }
         ["Genome", "SA", "SAindex"]
             .iter()
             .try_fold(0usize, |acc, file| {
@@ -147,53 +405,223 @@ impl StarSettings {
     }
 }
 
+/// How the reference files are brought into memory by `StarSettings::mmap`
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum MmapAdvice {
+    /// Pages are read as alignment touches them
+    OnDemand,
+    /// All pages are read while loading the reference
+    Populate,
+    /// All pages are read in the background, starting while loading the reference
+    WillNeed,
+    /// Pages are read as alignment touches them, without read-ahead
+    Random,
+}
+
+/// Where `StarSettings::huge_pages` gets huge pages from
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum HugePages {
+    /// Transparent huge pages, if /sys/kernel/mm/transparent_hugepage allows them
+    Transparent,
+    /// The hugetlbfs pool, falling back to transparent huge pages if it is too small. Shared
+    /// memory references always use transparent huge pages
+    Hugetlb,
+}
+
+/// The parts of the reference index `StarReference::warm_up` reads. Each level includes the
+/// previous ones
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum WarmUpLevel {
+    /// The suffix array index, which every seed search starts from
+    SuffixArrayIndex,
+    /// The genome sequence
+    Genome,
+    /// The suffix array, the largest part of the index
+    All,
+}
+
+/// Time spent by `StarReference::warm_up` on each part of the index, zero for the parts it
+/// did not read
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct WarmUpTiming {
+    pub suffix_array_index: Duration,
+    pub genome: Duration,
+    pub suffix_array: Duration,
+}
+
+/// What happens to the shared reference of `StarSettings::shared_memory` when its last user detaches
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum SharedMemoryMode {
+    /// The segment is kept, so that later processes attach to it without loading the reference
+    Keep,
+    /// The segment is removed once the last process using it drops its reference
+    RemoveWithLast,
+}
+
+/// How `StarSettings::numa` places the reference index on the NUMA nodes
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub enum NumaPlacement {
+    /// The pages are interleaved over all nodes, so that all aligners see the same latency
+    Interleave,
+    /// One copy per node, each aligner uses the copy on its node. Needs a private copy of the
+    /// reference, i.e. not `shared_memory`
+    Replicate,
+}
+
+/// Restrict the calling thread to the CPUs of NUMA node `node`, so that an aligner from
+/// `StarReference::get_aligner_on_numa_node` keeps reading its replica from local memory.
+/// Returns false if the node does not exist or the thread could not be bound
+pub fn bind_thread_to_numa_node(node: usize) -> bool {
+    unsafe { bindings::bind_thread_to_numa_node(node as c_int) == 0 }
+}
+
 /// StarAligner aligns single reads or read-pairs to the reference it is initialized with, and returns
 /// rust_htslib Record objects
 pub struct StarAligner {
     aligner: *mut BindAligner,
     reference: Arc<InnerStarReference>,
-    sam_buf: Vec<u8>,
-    aln_buf: Vec<u8>,
-    fastq1: Vec<u8>,
-    fastq2: Vec<u8>,
-    header_view: HeaderView,
+    batch: BatchBuffers,
 }
 
 unsafe impl Send for StarAligner {}
 
+/// A read pair given as `(name, read1, qual1, read2, qual2)`
+pub type ReadPair<'a> = (&'a [u8], &'a [u8], &'a [u8], &'a [u8], &'a [u8]);
+
+/// Reusable buffers for passing a batch of reads to STAR and holding the resulting alignments
+struct BatchBuffers {
+    arena: bindings::OrbitArena,
+    offsets: Vec<usize>,
+    status: Vec<c_int>,
+    names: Vec<*const c_char>,
+    name_lens: Vec<usize>,
+    tags: Vec<*const c_char>,
+    tag_lens: Vec<usize>,
+    seqs: Vec<*const c_char>,
+    seq_lens: Vec<usize>,
+    quals: Vec<*const c_char>,
+    qual_lens: Vec<usize>,
+}
+
+impl BatchBuffers {
+    fn new() -> BatchBuffers {
+        BatchBuffers {
+            arena: bindings::OrbitArena {
+                data: std::ptr::null_mut(),
+                capacity: 0,
+                offsets: std::ptr::null_mut(),
+                status: std::ptr::null_mut(),
+            },
+            offsets: Vec::new(),
+            status: Vec::new(),
+            names: Vec::new(),
+            name_lens: Vec::new(),
+            tags: Vec::new(),
+            tag_lens: Vec::new(),
+            seqs: Vec::new(),
+            seq_lens: Vec::new(),
+            quals: Vec::new(),
+            qual_lens: Vec::new(),
+        }
+    }
+
+    fn clear(&mut self) {
+        self.names.clear();
+        self.name_lens.clear();
+        self.tags.clear();
+        self.tag_lens.clear();
+        self.seqs.clear();
+        self.seq_lens.clear();
+        self.quals.clear();
+        self.qual_lens.clear();
+    }
+
+    /// Queue the name and SAM tags of a read or pair, followed by its mates. The slices must
+    /// stay alive until `align` returns.
+    fn push_name(&mut self, name: &[u8], tags: &[u8]) {
+        self.names.push(name.as_ptr() as *const c_char);
+        self.name_lens.push(name.len());
+        self.tags.push(tags.as_ptr() as *const c_char);
+        self.tag_lens.push(tags.len());
+    }
+
+    /// Queue a read or mate. The slices must stay alive until `align` returns.
+    fn push(&mut self, read: &[u8], qual: &[u8]) {
+        self.seqs.push(read.as_ptr() as *const c_char);
+        self.seq_lens.push(read.len());
+        self.quals.push(qual.as_ptr() as *const c_char);
+        self.qual_lens.push(qual.len());
+    }
+
+    /// Align all queued reads, consecutive entries forming a pair if `n_mates` is 2
+    fn align(&mut self, al: *mut BindAligner, n_mates: usize) {
+        let n = self.names.len();
+        self.offsets.resize(n + 1, 0);
+        self.status.resize(n, 0);
+        self.arena.offsets = self.offsets.as_mut_ptr();
+        self.arena.status = self.status.as_mut_ptr();
+        unsafe {
+            bindings::align_reads_batch(
+                al,
+                n,
+                n_mates,
+                self.names.as_ptr(),
+                self.name_lens.as_ptr(),
+                self.tags.as_ptr(),
+                self.tag_lens.as_ptr(),
+                self.seqs.as_ptr(),
+                self.seq_lens.as_ptr(),
+                self.quals.as_ptr(),
+                self.qual_lens.as_ptr(),
+                &mut self.arena,
+            );
+        }
+    }
+
+    /// The BAM records produced for the i-th aligned read, named as given to `push_name`
+    fn output(&self, i: usize, what: &str) -> Result<Vec<bam::Record>, Error> {
+        if self.status[i] != 0 {
+            return Err(align_error(self.status[i], what));
+        }
+        let (start, end) = (self.offsets[i], self.offsets[i + 1]);
+        if start == end {
+            return Ok(Vec::new());
+        }
+        let bam =
+            unsafe { slice::from_raw_parts(self.arena.data.add(start) as *const u8, end - start) };
+        Ok(bam_to_records(bam))
+    }
+}
+
+impl Drop for BatchBuffers {
+    fn drop(&mut self) {
+        unsafe {
+            libc::free(self.arena.data as *mut libc::c_void);
+        }
+    }
+}
+
 enum AlignedRecords<'a> {
     Read1(&'a mut Vec<bam::Record>),
     Read2(&'a mut Vec<bam::Record>),
 }
 
 impl StarAligner {
-    fn new(reference: Arc<InnerStarReference>) -> StarAligner {
-        let aligner = unsafe { bindings::init_aligner_from_ref(reference.as_ref().reference) };
-        let header_view = reference.as_ref().header_view.clone();
+    fn new(reference: Arc<InnerStarReference>, numa_node: Option<usize>) -> StarAligner {
+        let aligner = match numa_node {
+            Some(node) => unsafe {
+                bindings::init_aligner_on_numa_node(reference.as_ref().reference, node as c_int)
+            },
+            None => unsafe { bindings::init_aligner_from_ref(reference.as_ref().reference) },
+        };
 
         StarAligner {
             aligner,
             reference,
-            sam_buf: Vec::new(),
-            aln_buf: Vec::new(),
-            fastq1: Vec::new(),
-            fastq2: Vec::new(),
-            header_view,
+            batch: BatchBuffers::new(),
         }
     }
 
-    /// Prepare a read and qual for processing by formatting as FASTQ
-    fn prepare_fastq(buf: &mut Vec<u8>, _name: &[u8], read: &[u8], qual: &[u8]) {
-        buf.clear();
-        // for now, we fixup the read name on the backend, avoid the copy for now
-        buf.extend_from_slice(b"@a\n");
-        buf.extend_from_slice(read);
-        buf.extend_from_slice(b"\n+\n");
-        buf.extend_from_slice(qual);
-        buf.push(b'\n');
-        buf.push(b'\0');
-    }
-
     fn empty_record(name: &[u8], read: &[u8], qual: &[u8]) -> bam::Record {
         let mut rec = bam::Record::new();
         rec.set_tid(-1);
@@ -245,41 +673,157 @@ impl StarAligner {
         recs
     }
 
-    /// Aligns a given read and produces BAM records
+    /// Aligns a given read and produces BAM records. A name longer than the 254 bytes a BAM
+    /// record can hold is truncated to 254 bytes.
     pub fn align_read(&mut self, name: &[u8], read: &[u8], qual: &[u8]) -> Vec<bam::Record> {
+        self.align_read_with_tags(truncate_read_name(name), read, qual, b"")
+            .unwrap()
+    }
+
+    /// Aligns a given read and produces BAM records which carry the given SAM tags in addition
+    /// to those from STAR, e.g. `b"CB:Z:AAACCTGAGAAACCAT-1\tUB:Z:AGCTTGATCA"`.  Tags of type A,
+    /// i, f and Z separated by single tabs are supported; other tags give an error.
+    pub fn align_read_with_tags(
+        &mut self,
+        name: &[u8],
+        read: &[u8],
+        qual: &[u8],
+        tags: &[u8],
+    ) -> Result<Vec<bam::Record>, Error> {
         // STAR will throw an error on empty reads - so just construct an empty record.
         if read.is_empty() {
+            check_read_name(name)?;
             // Make an unmapped record and return it
-            return vec![Self::empty_record(name, read, qual)];
-        }
-
-        Self::prepare_fastq(&mut self.fastq1, name, read, qual);
-        align_read_rust(self.aligner, self.fastq1.as_slice(), &mut self.aln_buf).unwrap();
-        let mut records = self.parse_sam_to_records(name);
-        // hts_lib parses reads of length 1 with a "*" quality score the same as
-        // no quality score and sets it to a flag value of 255, handle this edge case by
-        // restoring the quality value.  Note aligning reads of length 1 not a great idea...
-        if qual.len() == 1 && qual[0] == 42 {
-            records.iter_mut().for_each(|r| {
-                // Kind of nasty way to mutate data that isn't exposed.
-                let data: &mut [u8] =
-                    unsafe { slice::from_raw_parts_mut(r.inner.data, r.inner.l_data as usize) };
-                data[r.inner.core.l_qname as usize
-                    + r.cigar_len() * 4
-                    + r.seq_len().div_ceil(2)..][0] = 42 - 33;
-            });
+            let mut rec = Self::empty_record(name, read, qual);
+            push_sam_tags(&mut rec, tags)?;
+            return Ok(vec![rec]);
+        }
+
+        let bam = align_read_bam_rust(self.aligner, name, tags, read, qual)?;
+        Ok(bam_to_records(bam))
+    }
+
+    /// Aligns a batch of reads with a single call into STAR, and produces the BAM records of
+    /// each read in input order.  Each read is given as a `(name, read, qual)` tuple.  Names are
+    /// truncated as by `align_read`.
+    pub fn align_batch(&mut self, reads: &[(&[u8], &[u8], &[u8])]) -> Vec<Vec<bam::Record>> {
+        let reads: Vec<_> = reads
+            .iter()
+            .map(|&(name, read, qual)| (truncate_read_name(name), read, qual))
+            .collect();
+        self.align_batch_with_tags(&reads, &[])
+            .into_iter()
+            .map(Result::unwrap)
+            .collect()
+    }
+
+    /// Aligns a batch of reads as `align_batch`, adding `tags[i]` to the records of the i-th read
+    /// as `align_read_with_tags` does.  `tags` is either empty, for no tags, or has an entry per
+    /// read.  A read with invalid tags or a name too long for a BAM record gets an error, without
+    /// affecting the other reads.
+    pub fn align_batch_with_tags(
+        &mut self,
+        reads: &[(&[u8], &[u8], &[u8])],
+        tags: &[&[u8]],
+    ) -> Vec<Result<Vec<bam::Record>, Error>> {
+        assert!(tags.is_empty() || tags.len() == reads.len());
+        let read_tags = |i: usize| if tags.is_empty() { &b""[..] } else { tags[i] };
+        self.batch.clear();
+        for (i, &(name, read, qual)) in reads.iter().enumerate() {
+            if !read.is_empty() {
+                self.batch.push_name(name, read_tags(i));
+                self.batch.push(read, qual);
+            }
+        }
+        self.batch.align(self.aligner, 1);
+
+        let mut results = Vec::with_capacity(reads.len());
+        let mut j = 0;
+        for (i, &(name, read, qual)) in reads.iter().enumerate() {
+            // STAR will throw an error on empty reads - so just construct an empty record.
+            if read.is_empty() {
+                results.push(check_read_name(name).and_then(|()| {
+                    let mut rec = Self::empty_record(name, read, qual);
+                    push_sam_tags(&mut rec, read_tags(i))?;
+                    Ok(vec![rec])
+                }));
+                continue;
+            }
+            results.push(self.batch.output(j, "read"));
+            j += 1;
+        }
+        results
+    }
+
+    /// Aligns a batch of read pairs with a single call into STAR, and produces the BAM records
+    /// of each pair in input order.  Each pair is given as a `(name, read1, qual1, read2, qual2)`
+    /// tuple.  Names are truncated as by `align_read`.
+    pub fn align_pair_batch(
+        &mut self,
+        pairs: &[ReadPair<'_>],
+    ) -> Vec<(Vec<bam::Record>, Vec<bam::Record>)> {
+        let pairs: Vec<_> = pairs
+            .iter()
+            .map(|&(name, read1, qual1, read2, qual2)| {
+                (truncate_read_name(name), read1, qual1, read2, qual2)
+            })
+            .collect();
+        self.align_pair_batch_with_tags(&pairs, &[])
+            .into_iter()
+            .map(Result::unwrap)
+            .collect()
+    }
+
+    /// Aligns a batch of read pairs as `align_pair_batch`, adding `tags[i]` to the records of
+    /// the i-th pair as `align_read_pair_with_tags` does.  `tags` is either empty, for no tags,
+    /// or has an entry per pair.  Errors are reported per pair, as by `align_batch_with_tags`.
+    pub fn align_pair_batch_with_tags(
+        &mut self,
+        pairs: &[ReadPair<'_>],
+        tags: &[&[u8]],
+    ) -> Vec<Result<(Vec<bam::Record>, Vec<bam::Record>), Error>> {
+        assert!(tags.is_empty() || tags.len() == pairs.len());
+        let pair_tags = |i: usize| if tags.is_empty() { &b""[..] } else { tags[i] };
+        self.batch.clear();
+        for (i, &(name, read1, qual1, read2, qual2)) in pairs.iter().enumerate() {
+            if !read1.is_empty() && !read2.is_empty() {
+                self.batch.push_name(name, pair_tags(i));
+                self.batch.push(read1, qual1);
+                self.batch.push(read2, qual2);
+            }
         }
-        records
+        self.batch.align(self.aligner, 2);
+
+        let mut results = Vec::with_capacity(pairs.len());
+        let mut j = 0;
+        for (i, &(name, read1, qual1, read2, qual2)) in pairs.iter().enumerate() {
+            if read1.is_empty() || read2.is_empty() {
+                results.push(self.align_read_pair_with_tags(
+                    name,
+                    read1,
+                    qual1,
+                    read2,
+                    qual2,
+                    pair_tags(i),
+                ));
+                continue;
+            }
+            results.push(self.batch.output(j, "read pair").map(Self::split_mates));
+            j += 1;
+        }
+        results
     }
 
-    /// Aligns a given read and return the resulting SAM string
+    /// Aligns a given read and return the resulting SAM string, with the name truncated as by
+    /// `align_read`
     pub fn align_read_sam(&mut self, name: &[u8], read: &[u8], qual: &[u8]) -> String {
-        Self::prepare_fastq(&mut self.fastq1, name, read, qual);
-        align_read_rust(self.aligner, self.fastq1.as_slice(), &mut self.aln_buf).unwrap();
-        String::from_utf8(self.aln_buf.clone()).unwrap()
+        let name = truncate_read_name(name);
+        let sam = align_read_sam_rust(self.aligner, name, b"", read, qual).unwrap();
+        String::from_utf8(sam.to_vec()).unwrap()
     }
 
-    /// Aligns a given pair of reads and produces BAM records
+    /// Aligns a given pair of reads and produces BAM records, with the name truncated as by
+    /// `align_read`
     pub fn align_read_pair(
         &mut self,
         name: &[u8],
@@ -288,28 +832,44 @@ impl StarAligner {
         read2: &[u8],
         qual2: &[u8],
     ) -> (Vec<bam::Record>, Vec<bam::Record>) {
+        let name = truncate_read_name(name);
+        self.align_read_pair_with_tags(name, read1, qual1, read2, qual2, b"")
+            .unwrap()
+    }
+
+    /// Aligns a given pair of reads and produces BAM records which carry the given SAM tags, as
+    /// `align_read_with_tags`
+    pub fn align_read_pair_with_tags(
+        &mut self,
+        name: &[u8],
+        read1: &[u8],
+        qual1: &[u8],
+        read2: &[u8],
+        qual2: &[u8],
+        tags: &[u8],
+    ) -> Result<(Vec<bam::Record>, Vec<bam::Record>), Error> {
         use AlignedRecords::{Read1, Read2};
         if read1.is_empty() {
-            let mut recs2 = self.align_read(name, read2, qual2);
-            let recs1 = Self::empty_records(name, read1, qual1, Read2(&mut recs2));
-            return (recs1, recs2);
+            let mut recs2 = self.align_read_with_tags(name, read2, qual2, tags)?;
+            let mut recs1 = Self::empty_records(name, read1, qual1, Read2(&mut recs2));
+            for rec in &mut recs1 {
+                push_sam_tags(rec, tags)?;
+            }
+            return Ok((recs1, recs2));
         } else if read2.is_empty() {
-            let mut recs1 = self.align_read(name, read1, qual1);
-            let recs2 = Self::empty_records(name, read2, qual2, Read1(&mut recs1));
-            return (recs1, recs2);
-        }
-        Self::prepare_fastq(&mut self.fastq1, name, read1, qual1);
-        Self::prepare_fastq(&mut self.fastq2, name, read2, qual2);
-        align_read_pair_rust(
-            self.aligner,
-            self.fastq1.as_slice(),
-            self.fastq2.as_slice(),
-            &mut self.aln_buf,
-        )
-        .unwrap();
-        let full_vec = self.parse_sam_to_records(name);
+            let mut recs1 = self.align_read_with_tags(name, read1, qual1, tags)?;
+            let mut recs2 = Self::empty_records(name, read2, qual2, Read1(&mut recs1));
+            for rec in &mut recs2 {
+                push_sam_tags(rec, tags)?;
+            }
+            return Ok((recs1, recs2));
+        }
+        let bam = align_read_pair_bam_rust(self.aligner, name, tags, read1, qual1, read2, qual2)?;
+        Ok(Self::split_mates(bam_to_records(bam)))
+    }
 
-        // Partition the records into first mate and second mate
+    /// Partition the records of a read pair into first mate and second mate
+    fn split_mates(full_vec: Vec<bam::Record>) -> (Vec<bam::Record>, Vec<bam::Record>) {
         let mut first_vec: Vec<bam::Record> = Vec::new();
         let mut second_vec: Vec<bam::Record> = Vec::new();
         for rec in full_vec {
@@ -322,7 +882,8 @@ impl StarAligner {
         (first_vec, second_vec)
     }
 
-    /// Aligns a given read and return the resulting SAM string
+    /// Aligns a given read and return the resulting SAM string, with the name truncated as by
+    /// `align_read`
     pub fn align_read_pair_sam(
         &mut self,
         name: &[u8],
@@ -331,40 +892,58 @@ impl StarAligner {
         read2: &[u8],
         qual2: &[u8],
     ) -> String {
-        Self::prepare_fastq(&mut self.fastq1, name, read1, qual1);
-        Self::prepare_fastq(&mut self.fastq2, name, read2, qual2);
-        align_read_pair_rust(
-            self.aligner,
-            self.fastq1.as_slice(),
-            self.fastq2.as_slice(),
-            &mut self.aln_buf,
-        )
-        .unwrap();
-        String::from_utf8(self.aln_buf.clone()).unwrap()
-    }
-
-    /// Given a list of BAM records as a SAM-format string in which records are separated by new
-    /// lines, add the records to a vector and append the read name to the beginning of them so
-    /// that they conform with BAM specifications
-    fn parse_sam_to_records(&mut self, name: &[u8]) -> Vec<bam::Record> {
-        let mut records = Vec::new();
-        for slc in self.aln_buf.split(|c| *c == b'\n') {
-            if !slc.is_empty() {
-                self.sam_buf.clear();
-                self.sam_buf.extend_from_slice(name);
-                self.sam_buf.extend_from_slice(slc);
-                let record = bam::Record::from_sam(&self.header_view, &self.sam_buf).unwrap();
-                records.push(record);
-            }
+        let name = truncate_read_name(name);
+        let sam =
+            align_read_pair_sam_rust(self.aligner, name, b"", read1, qual1, read2, qual2).unwrap();
+        String::from_utf8(sam.to_vec()).unwrap()
+    }
+
+    /// The NUMA node of the replica of the reference this aligner uses, `None` if the reference
+    /// is not replicated
+    pub fn numa_node(&self) -> Option<usize> {
+        let node = unsafe { bindings::aligner_numa_node(self.aligner) };
+        node.try_into().ok()
+    }
+
+    /// Returns the size of the per-read working memory STAR has allocated for this aligner, which
+    /// starts small and grows as reads need more, with the peak usage of any read so far
+    pub fn scratch_usage(&self) -> ScratchUsage {
+        let mut usage = bindings::OrbitScratchUsage::default();
+        unsafe { bindings::aligner_scratch_usage(self.aligner, &mut usage) };
+        ScratchUsage {
+            bytes: usage.bytes,
+            peak_seeds: usage.peak_seeds,
+            peak_windows: usage.peak_windows,
+            peak_transcripts: usage.peak_transcripts,
+            peak_multimappers: usage.peak_multimappers,
         }
+    }
 
-        records
+    /// Returns the number of seed searches of this aligner that started from the suffix array
+    /// range of a hashed k-mer, see `StarSettings::sa_hash`
+    pub fn sa_hash_searches(&self) -> usize {
+        unsafe { bindings::aligner_sa_hash_searches(self.aligner) }
     }
 }
 
+/// Per-read working memory of a `StarAligner`, from `StarAligner::scratch_usage`
+#[derive(Debug, Clone, Copy, PartialEq, Eq)]
+pub struct ScratchUsage {
+    /// Bytes currently allocated
+    pub bytes: usize,
+    /// Most seeds stored for one read
+    pub peak_seeds: usize,
+    /// Most alignment windows created for one read
+    pub peak_windows: usize,
+    /// Most transcripts stitched for one read
+    pub peak_transcripts: usize,
+    /// Most multimapping alignments selected for one read
+    pub peak_multimappers: usize,
+}
+
 impl Clone for StarAligner {
     fn clone(&self) -> StarAligner {
-        StarAligner::new(self.reference.clone())
+        StarAligner::new(self.reference.clone(), self.numa_node())
     }
 }
 
@@ -374,146 +953,859 @@ impl Drop for StarAligner {
     }
 }
 
-/// Read in the lines from a file and store each line as its own string in a vector
-fn get_lines(path: &Path) -> Vec<String> {
-    let file = match File::open(path) {
-        Err(error) => panic!("error: {}: {}", path.display(), error),
-        Ok(file) => file,
-    };
-    BufReader::new(file).lines().map(Result::unwrap).collect()
-}
-
-/// Produces a header from the genome reference directory by looking up the contig names and
-/// lengths and formatting them properly
-fn generate_header(genome_path: impl AsRef<Path>) -> (Header, HeaderView) {
-    let mut header = Header::new();
+/// A read as `(name, read, qual)` owned by the caller, for `StarReference::align_stream`
+pub type OwnedRead = (Vec<u8>, Vec<u8>, Vec<u8>);
 
-    let contig_names_path = genome_path.as_ref().join(Path::new("chrName.txt"));
-    let contig_names = get_lines(&contig_names_path);
+/// A read pair as `(name, read1, qual1, read2, qual2)` owned by the caller, for
+/// `StarReference::align_stream`
+pub type OwnedReadPair = (Vec<u8>, Vec<u8>, Vec<u8>, Vec<u8>, Vec<u8>);
 
-    let contig_lengths_path = genome_path.as_ref().join(Path::new("chrLength.txt"));
-    let contig_lengths = get_lines(&contig_lengths_path);
-    for (contig_name, len) in contig_names.iter().zip(contig_lengths.into_iter()) {
-        add_ref_to_bam_header(&mut header, contig_name, len.parse::<usize>().unwrap());
-    }
+/// A read or read pair that can be aligned by `StarReference::align_stream`
+pub trait StreamRead: Send + Sized + 'static {
+    /// The alignments of one read or read pair
+    type Output: Send + 'static;
 
-    let hv = HeaderView::from_header(&header);
-    (header, hv)
+    /// Align a batch of reads with one aligner, producing the alignments of each read in order
+    fn align_batch(aligner: &mut StarAligner, batch: &[Self]) -> Vec<Self::Output>;
 }
 
-/// Given a reference genome contig's name and length, add a corresponding line to the given BAM
-/// header
-fn add_ref_to_bam_header(header: &mut Header, seq_name: &str, seq_len: usize) {
-    let mut header_rec = HeaderRecord::new(b"SQ");
-    header_rec.push_tag(b"SN", seq_name);
-    header_rec.push_tag(b"LN", seq_len);
-    header.push_record(&header_rec);
-}
+impl StreamRead for OwnedRead {
+    type Output = Vec<bam::Record>;
 
-/// Below are wrappers for different Orbit functions, but with arguments as datatypes which are
-/// more natural rather than the wrappers around C datatypes.  Each function below makes any
-/// necessary conversions to the inputs, calls the library function, and makes any necessary
-/// conversions to the outputs.
-fn align_read_rust(al: *mut BindAligner, fastq: &[u8], aln_buf: &mut Vec<u8>) -> Result<(), Error> {
-    let fastq = CStr::from_bytes_with_nul(fastq)?;
-    let res: *const c_char = unsafe { bindings::align_read(al, fastq.as_ptr()) };
-    if res.is_null() {
-        return Err(format_err!("STAR returned null alignment"));
+    fn align_batch(aligner: &mut StarAligner, batch: &[Self]) -> Vec<Self::Output> {
+        let reads: Vec<_> = batch
+            .iter()
+            .map(|(name, read, qual)| (name.as_slice(), read.as_slice(), qual.as_slice()))
+            .collect();
+        aligner.align_batch(&reads)
     }
+}
 
-    let cstr = unsafe { CStr::from_ptr(res) };
-    aln_buf.clear();
-    aln_buf.extend_from_slice(cstr.to_bytes());
+impl StreamRead for OwnedReadPair {
+    type Output = (Vec<bam::Record>, Vec<bam::Record>);
 
-    unsafe {
-        libc::free(res as *mut libc::c_void);
+    fn align_batch(aligner: &mut StarAligner, batch: &[Self]) -> Vec<Self::Output> {
+        let pairs: Vec<_> = batch
+            .iter()
+            .map(|(name, read1, qual1, read2, qual2)| {
+                (
+                    name.as_slice(),
+                    read1.as_slice(),
+                    qual1.as_slice(),
+                    read2.as_slice(),
+                    qual2.as_slice(),
+                )
+            })
+            .collect();
+        aligner.align_pair_batch(&pairs)
     }
-    Ok(())
 }
 
-fn align_read_pair_rust(
-    al: *mut BindAligner,
-    fastq1: &[u8],
-    fastq2: &[u8],
-    aln_buf: &mut Vec<u8>,
-) -> Result<(), Error> {
-    let fastq1 = CStr::from_bytes_with_nul(fastq1)?;
-    let fastq2 = CStr::from_bytes_with_nul(fastq2)?;
-    let res: *const c_char =
-        unsafe { bindings::align_read_pair(al, fastq1.as_ptr(), fastq2.as_ptr()) };
-    if res.is_null() {
-        return Err(format_err!("STAR returned null alignment"));
-    }
-
-    let cstr = unsafe { CStr::from_ptr(res) };
-    aln_buf.clear();
-    aln_buf.extend_from_slice(cstr.to_bytes());
+/// Iterator over the alignments produced by `StarReference::align_stream`, in input order.
+/// Batches completed out of order are held until all earlier batches have been returned.
+/// Dropping the iterator stops the alignment threads once their current batch is done.
+pub struct AlignStream<R: StreamRead> {
+    done_rx: mpsc::Receiver<(usize, thread::Result<Vec<R::Output>>)>,
+    credit_rx: mpsc::Receiver<()>,
+    pending: BTreeMap<usize, Vec<R::Output>>,
+    next_index: usize,
+    current: std::vec::IntoIter<R::Output>,
+    threads: Vec<thread::JoinHandle<()>>,
+}
 
-    unsafe {
-        libc::free(res as *mut libc::c_void);
+impl<R: StreamRead> Iterator for AlignStream<R> {
+    type Item = R::Output;
+
+    fn next(&mut self) -> Option<R::Output> {
+        loop {
+            if let Some(alns) = self.current.next() {
+                return Some(alns);
+            }
+            while !self.pending.contains_key(&self.next_index) {
+                match self.done_rx.recv() {
+                    Ok((index, Ok(alns))) => {
+                        self.pending.insert(index, alns);
+                    }
+                    Ok((_, Err(panic))) => panic::resume_unwind(panic),
+                    Err(_) => {
+                        // All threads have exited: either the input is exhausted or one panicked
+                        for handle in self.threads.drain(..) {
+                            if let Err(panic) = handle.join() {
+                                panic::resume_unwind(panic);
+                            }
+                        }
+                        return None;
+                    }
+                }
+            }
+            let alns = self.pending.remove(&self.next_index).unwrap();
+            self.next_index += 1;
+            self.current = alns.into_iter();
+            // Let the reader thread queue another batch
+            let _ = self.credit_rx.recv();
+        }
     }
-    Ok(())
 }
 
-#[cfg(test)]
-mod test {
-    use super::*;
-    use rust_htslib::bam::record::Aux;
-    use rust_htslib::bam::Read;
+/// Called by STAR from a worker thread of an `AlignPool` when a read has been aligned
+type Completer = Box<dyn FnOnce(Result<Vec<bam::Record>, Error>) + Send>;
+
+/// State shared between an `AlignPool`, its dispatcher thread and the STAR workers
+struct PoolShared {
+    /// Completers of the submitted reads, by tag
+    pending: Mutex<HashMap<u64, Completer>>,
+    /// Set by the workers when completions are ready to be polled
+    ready: Mutex<bool>,
+    wake: Condvar,
+    stop: AtomicBool,
+}
 
-    /// References to some commonly used reference genomes for testing purposes
-    pub const DEFAULT_REF_1: &str = "/mnt/opt/refdata_cellranger/mm10-3.0.0/star";
-    pub const DEFAULT_REF_2: &str = "/mnt/opt/refdata_cellranger/GRCh38-3.0.0/star";
-    pub const DEFAULT_REF_3: &str = "/mnt/opt/refdata_cellranger/GRCh38-1.2.0/star";
-    pub const DEFAULT_REF_4: &str = "//mnt/opt/refdata_cellranger/hg19_and_mm10-3.0.0/star";
+extern "C" fn pool_notify(ctx: *mut c_void) {
+    let shared = unsafe { &*(ctx as *const PoolShared) };
+    *shared.ready.lock().unwrap() = true;
+    shared.wake.notify_one();
+}
 
-    const ERCC_REF: &str = "test/ercc92-1.2.0/star/";
+struct PoolPtr(*mut bindings::OrbitPool);
 
-    const NAME: &[u8] = b"NAME";
-    const ERCC_READ_1: &[u8] = b"GCATCCAGACCGTCGGCTGATCGTGGTTTTACTAGGCTAGACTAGCGTACGAGCACTATGGTCAGTAATTCCTGGAGGAATAGGTACCAAGAAAAAAACG";
-    const ERCC_QUAL_1: &[u8] = b"????????????????????????????????????????????????????????????????????????????????????????????????????";
+unsafe impl Send for PoolPtr {}
 
-    const ERCC_READ_2: &[u8] = b"GGAGACGAATTGCCAGAATTATTAACTGCGCAGTTAGGGCAGCGTCTGAGGAAGTTTGCTGCGGTTTCGCCTTGACCGCGGGAAGGAGACATAACGATAG";
-    const ERCC_QUAL_2: &[u8] = b"????????????????????????????????????????????????????????????????????????????????????????????????????";
+/// AlignPool aligns reads asynchronously on worker threads owned by STAR.  Submitting a read
+/// never blocks: it is queued and a future is returned which resolves to the BAM records once
+/// a worker has aligned the read, so a single event loop can keep all the workers busy.
+/// Futures are resolved by a dispatcher thread and do not depend on a particular async runtime.
+/// Dropping the pool cancels the reads not yet aligned.
+pub struct AlignPool {
+    pool: *mut bindings::OrbitPool,
+    shared: Arc<PoolShared>,
+    dispatcher: Option<thread::JoinHandle<()>>,
+    next_tag: AtomicU64,
+    reference: Arc<InnerStarReference>,
+}
 
-    const ERCC_READ_3: &[u8] = b"AACTTAATGGACGGG";
-    const ERCC_QUAL_3: &[u8] = b"???????????????";
+unsafe impl Send for AlignPool {}
+unsafe impl Sync for AlignPool {}
+
+impl AlignPool {
+    fn new(reference: Arc<InnerStarReference>, n_threads: usize, capacity: usize) -> AlignPool {
+        assert!(n_threads > 0 && capacity > 0);
+        let shared = Arc::new(PoolShared {
+            pending: Mutex::new(HashMap::new()),
+            ready: Mutex::new(false),
+            wake: Condvar::new(),
+            stop: AtomicBool::new(false),
+        });
+        let pool = unsafe {
+            bindings::init_pool(
+                reference.reference,
+                n_threads,
+                capacity,
+                Some(pool_notify),
+                Arc::as_ptr(&shared) as *mut c_void,
+            )
+        };
 
-    const ERCC_READ_4: &[u8] = b"AATCCACTCAATAAATCTAAAAAC";
-    const ERCC_QUAL_4: &[u8] = b"????????????????????????";
+        let dispatcher = {
+            let shared = shared.clone();
+            let pool = PoolPtr(pool);
+            thread::spawn(move || Self::dispatch(&pool, &shared))
+        };
 
-    fn have_refs() -> bool {
-        Path::new("/mnt/opt/refdata_cellranger").exists()
+        AlignPool {
+            pool,
+            shared,
+            dispatcher: Some(dispatcher),
+            next_tag: AtomicU64::new(0),
+            reference,
+        }
     }
 
-    #[test]
-    fn test_empty_tiny_reads() {
-        let settings = StarSettings::new(ERCC_REF);
-        let reference = StarReference::load(settings).unwrap();
-        let mut aligner = reference.get_aligner();
+    /// Hand the completions polled from STAR to their completers until the pool is dropped
+    fn dispatch(pool: &PoolPtr, shared: &PoolShared) {
+        const MAX_POLL: usize = 64;
+        let mut completions = Vec::with_capacity(MAX_POLL);
+        loop {
+            {
+                let mut ready = shared.ready.lock().unwrap();
+                while !*ready && !shared.stop.load(Ordering::Acquire) {
+                    ready = shared.wake.wait(ready).unwrap();
+                }
+                if shared.stop.load(Ordering::Acquire) {
+                    return;
+                }
+                // Completions pushed after this point notify again
+                *ready = false;
+            }
+            loop {
+                let n = unsafe { bindings::orbit_poll(pool.0, completions.as_mut_ptr(), MAX_POLL) };
+                unsafe { completions.set_len(n) };
+                for c in &completions {
+                    let completer = shared.pending.lock().unwrap().remove(&c.tag);
+                    let Some(completer) = completer else {
+                        continue;
+                    };
+                    // A panic here would leave every pending future unresolved
+                    let res = panic::catch_unwind(AssertUnwindSafe(|| {
+                        if c.status == 0 {
+                            Ok(bam_to_records(output_slice(c.data, c.len)))
+                        } else {
+                            Err(align_error(c.status, "read"))
+                        }
+                    }));
+                    completer(
+                        res.unwrap_or_else(|_| Err(format_err!("failed to parse BAM records"))),
+                    );
+                }
+                if n < MAX_POLL {
+                    break;
+                }
+            }
+        }
+    }
 
-        let recs = aligner.align_read(b"a", b"", b"");
-        println!("{recs:?}");
-        let recs = aligner.align_read(b"b", b"A", b"?");
-        let expected_qual: &[u8] = &[63 - 33];
-        println!("{recs:?}");
-        assert_eq!(recs[0].qual(), expected_qual, "Quality value incorrect");
-        let recs = aligner.align_read(b"Hello there", b"C", b"*");
-        let record = &recs[0];
-        let expected_qual: &[u8] = &[42 - 33];
-        assert_eq!(
-            record.qual(),
-            expected_qual,
-            "Quality value was not corrected."
-        );
-        assert_eq!(record.qname(), b"Hello there");
-        let aux_tags: Vec<(&[u8], Aux)> = record.aux_iter().map(|z| z.unwrap()).collect();
-        let expected_aux_tags = ["NH", "HI", "AS", "nM", "uT"];
-        println!("Aux Tags {aux_tags:?}");
-        for (i, tag) in aux_tags.into_iter().enumerate() {
-            assert_eq!(
-                String::from_utf8(tag.0.into()).unwrap(),
-                expected_aux_tags[i]
+    /// Queue a read for a worker, with the completer to call with its records
+    fn submit(
+        &self,
+        name: &[u8],
+        mates: &[(&[u8], &[u8])],
+        completer: Completer,
+    ) -> Result<(), Error> {
+        let mut read = bindings::OrbitRead {
+            name: name.as_ptr() as *const c_char,
+            name_len: name.len(),
+            tags: std::ptr::null(),
+            tags_len: 0,
+            n_mates: mates.len(),
+            seq: [std::ptr::null(); 2],
+            seq_len: [0; 2],
+            qual: [std::ptr::null(); 2],
+            qual_len: [0; 2],
+        };
+        for (i, &(seq, qual)) in mates.iter().enumerate() {
+            read.seq[i] = seq.as_ptr() as *const c_char;
+            read.seq_len[i] = seq.len();
+            read.qual[i] = qual.as_ptr() as *const c_char;
+            read.qual_len[i] = qual.len();
+        }
+        // The completer must be registered before a worker can complete the read
+        let tag = self.next_tag.fetch_add(1, Ordering::Relaxed);
+        self.shared.pending.lock().unwrap().insert(tag, completer);
+        let res = unsafe { bindings::orbit_submit(self.pool, &read, tag) };
+        if res != 0 {
+            self.shared.pending.lock().unwrap().remove(&tag);
+            return Err(if res > 0 {
+                format_err!("alignment pool is full")
+            } else if res == bindings::ORBIT_BAD_READ {
+                format_err!("cannot align an empty read")
+            } else {
+                align_error(res, "read")
+            });
+        }
+        Ok(())
+    }
+
+    /// Queue a read for alignment, and return a future resolving to its BAM records.  Returns an
+    /// error if `capacity` reads are already in flight.
+    pub fn align_read(
+        &self,
+        name: &[u8],
+        read: &[u8],
+        qual: &[u8],
+    ) -> Result<AlignFuture<Vec<bam::Record>>, Error> {
+        let (future, resolve) = AlignFuture::new();
+        // STAR will throw an error on empty reads - so just construct an empty record.
+        if read.is_empty() {
+            resolve(Ok(vec![StarAligner::empty_record(name, read, qual)]));
+            return Ok(future);
+        }
+        self.submit(name, &[(read, qual)], Box::new(resolve))?;
+        Ok(future)
+    }
+
+    /// Queue a read pair for alignment, and return a future resolving to the BAM records of each
+    /// mate.  Returns an error if `capacity` reads are already in flight.
+    pub fn align_read_pair(
+        &self,
+        name: &[u8],
+        read1: &[u8],
+        qual1: &[u8],
+        read2: &[u8],
+        qual2: &[u8],
+    ) -> Result<PairAlignFuture, Error> {
+        use AlignedRecords::{Read1, Read2};
+        let (future, resolve) = AlignFuture::new();
+        if read1.is_empty() && read2.is_empty() {
+            let mut recs2 = vec![StarAligner::empty_record(name, read2, qual2)];
+            let recs1 = StarAligner::empty_records(name, read1, qual1, Read2(&mut recs2));
+            resolve(Ok((recs1, recs2)));
+            return Ok(future);
+        }
+        // A single non-empty mate is aligned alone, as by StarAligner::align_read_pair
+        let completer: Completer = if read1.is_empty() {
+            let (name, read1, qual1) = (name.to_vec(), read1.to_vec(), qual1.to_vec());
+            Box::new(move |res| {
+                resolve(res.map(|mut recs2| {
+                    let recs1 =
+                        StarAligner::empty_records(&name, &read1, &qual1, Read2(&mut recs2));
+                    (recs1, recs2)
+                }));
+            })
+        } else if read2.is_empty() {
+            let (name, read2, qual2) = (name.to_vec(), read2.to_vec(), qual2.to_vec());
+            Box::new(move |res| {
+                resolve(res.map(|mut recs1| {
+                    let recs2 =
+                        StarAligner::empty_records(&name, &read2, &qual2, Read1(&mut recs1));
+                    (recs1, recs2)
+                }));
+            })
+        } else {
+            Box::new(move |res| resolve(res.map(StarAligner::split_mates)))
+        };
+        let mates: &[(&[u8], &[u8])] = if read1.is_empty() {
+            &[(read2, qual2)]
+        } else if read2.is_empty() {
+            &[(read1, qual1)]
+        } else {
+            &[(read1, qual1), (read2, qual2)]
+        };
+        self.submit(name, mates, completer)?;
+        Ok(future)
+    }
+
+    /// The number of reads submitted and not yet completed
+    pub fn in_flight(&self) -> usize {
+        self.shared.pending.lock().unwrap().len()
+    }
+
+    pub fn header_view(&self) -> &HeaderView {
+        &self.reference.header_view
+    }
+}
+
+impl Drop for AlignPool {
+    fn drop(&mut self) {
+        {
+            let _ready = self.shared.ready.lock().unwrap();
+            self.shared.stop.store(true, Ordering::Release);
+        }
+        self.shared.wake.notify_one();
+        if let Some(dispatcher) = self.dispatcher.take() {
+            let _ = dispatcher.join();
+        }
+        unsafe { bindings::destroy_pool(self.pool) };
+        let pending = std::mem::take(&mut *self.shared.pending.lock().unwrap());
+        for (_, completer) in pending {
+            completer(Err(format_err!("alignment pool was dropped")));
+        }
+    }
+}
+
+/// The alignments of a read pair submitted to an `AlignPool`, for each mate
+pub type PairAlignFuture = AlignFuture<(Vec<bam::Record>, Vec<bam::Record>)>;
+
+struct FutureState<T> {
+    result: Option<Result<T, Error>>,
+    waker: Option<Waker>,
+}
+
+/// The alignments of a read submitted to an `AlignPool`.  Can be awaited on any executor, or
+/// waited for by blocking the current thread.
+pub struct AlignFuture<T> {
+    state: Arc<(Mutex<FutureState<T>>, Condvar)>,
+}
+
+impl<T: Send + 'static> AlignFuture<T> {
+    /// A future and the function resolving it
+    fn new() -> (
+        AlignFuture<T>,
+        impl FnOnce(Result<T, Error>) + Send + 'static,
+    ) {
+        let state = Arc::new((
+            Mutex::new(FutureState {
+                result: None,
+                waker: None,
+            }),
+            Condvar::new(),
+        ));
+        let resolve = {
+            let state = state.clone();
+            move |result| {
+                let waker = {
+                    let mut s = state.0.lock().unwrap();
+                    s.result = Some(result);
+                    s.waker.take()
+                };
+                state.1.notify_all();
+                if let Some(waker) = waker {
+                    waker.wake();
+                }
+            }
+        };
+        (AlignFuture { state }, resolve)
+    }
+
+    /// Block the current thread until the read is aligned
+    pub fn wait(self) -> Result<T, Error> {
+        let mut s = self.state.0.lock().unwrap();
+        loop {
+            if let Some(result) = s.result.take() {
+                return result;
+            }
+            s = self.state.1.wait(s).unwrap();
+        }
+    }
+}
+
+impl<T> Future for AlignFuture<T> {
+    type Output = Result<T, Error>;
+
+    fn poll(self: Pin<&mut Self>, cx: &mut Context<'_>) -> Poll<Self::Output> {
+        let mut s = self.state.0.lock().unwrap();
+        match s.result.take() {
+            Some(result) => Poll::Ready(result),
+            None => {
+                s.waker = Some(cx.waker().clone());
+                Poll::Pending
+            }
+        }
+    }
+}
+
+/// Produces a header from the contig names and lengths of a loaded reference, which works for
+/// both genome directories and bundles
+fn generate_header(reference: *const BindRef) -> (Header, HeaderView) {
+    let mut header = Header::new();
+
+    for chr in 0..unsafe { bindings::ref_chr_count(reference) } {
+        let (name, len) = unsafe {
+            (
+                CStr::from_ptr(bindings::ref_chr_name(reference, chr)),
+                bindings::ref_chr_length(reference, chr),
+            )
+        };
+        add_ref_to_bam_header(&mut header, &name.to_string_lossy(), len as usize);
+    }
+
+    let hv = HeaderView::from_header(&header);
+    (header, hv)
+}
+
+/// The result of a `write_ref_` function, which returns NULL or the error
+fn write_result(error: *const c_char) -> Result<(), Error> {
+    if error.is_null() {
+        return Ok(());
+    }
+    let error = unsafe { CStr::from_ptr(error) }.to_string_lossy();
+    Err(format_err!("{}", error.trim_end()))
+}
+
+/// Given a reference genome contig's name and length, add a corresponding line to the given BAM
+/// header
+fn add_ref_to_bam_header(header: &mut Header, seq_name: &str, seq_len: usize) {
+    let mut header_rec = HeaderRecord::new(b"SQ");
+    header_rec.push_tag(b"SN", seq_name);
+    header_rec.push_tag(b"LN", seq_len);
+    header.push_record(&header_rec);
+}
+
+/// Below are wrappers for different Orbit functions, but with arguments as datatypes which are
+/// more natural rather than the wrappers around C datatypes.  Each function below makes any
+/// necessary conversions to the inputs, calls the library function, and makes any necessary
+/// conversions to the outputs.
+fn align_read_sam_rust<'a>(
+    al: *mut BindAligner,
+    name: &[u8],
+    tags: &[u8],
+    read: &[u8],
+    qual: &[u8],
+) -> Result<&'a [u8], Error> {
+    let mut out: *const c_char = std::ptr::null();
+    let mut out_len = 0;
+    let res = unsafe {
+        bindings::align_read_sam(
+            al,
+            name.as_ptr() as *const c_char,
+            name.len(),
+            tags.as_ptr() as *const c_char,
+            tags.len(),
+            read.as_ptr() as *const c_char,
+            read.len(),
+            qual.as_ptr() as *const c_char,
+            qual.len(),
+            &mut out,
+            &mut out_len,
+        )
+    };
+    if res != 0 {
+        return Err(align_error(res, "read"));
+    }
+    Ok(output_slice(out, out_len))
+}
+
+fn align_read_pair_sam_rust<'a>(
+    al: *mut BindAligner,
+    name: &[u8],
+    tags: &[u8],
+    read1: &[u8],
+    qual1: &[u8],
+    read2: &[u8],
+    qual2: &[u8],
+) -> Result<&'a [u8], Error> {
+    let mut out: *const c_char = std::ptr::null();
+    let mut out_len = 0;
+    let res = unsafe {
+        bindings::align_read_pair_sam(
+            al,
+            name.as_ptr() as *const c_char,
+            name.len(),
+            tags.as_ptr() as *const c_char,
+            tags.len(),
+            read1.as_ptr() as *const c_char,
+            read1.len(),
+            qual1.as_ptr() as *const c_char,
+            qual1.len(),
+            read2.as_ptr() as *const c_char,
+            read2.len(),
+            qual2.as_ptr() as *const c_char,
+            qual2.len(),
+            &mut out,
+            &mut out_len,
+        )
+    };
+    if res != 0 {
+        return Err(align_error(res, "read pair"));
+    }
+    Ok(output_slice(out, out_len))
+}
+
+fn align_read_bam_rust<'a>(
+    al: *mut BindAligner,
+    name: &[u8],
+    tags: &[u8],
+    read: &[u8],
+    qual: &[u8],
+) -> Result<&'a [u8], Error> {
+    let mut out: *const c_char = std::ptr::null();
+    let mut out_len = 0;
+    let res = unsafe {
+        bindings::align_read_bam(
+            al,
+            name.as_ptr() as *const c_char,
+            name.len(),
+            tags.as_ptr() as *const c_char,
+            tags.len(),
+            read.as_ptr() as *const c_char,
+            read.len(),
+            qual.as_ptr() as *const c_char,
+            qual.len(),
+            &mut out,
+            &mut out_len,
+        )
+    };
+    if res != 0 {
+        return Err(align_error(res, "read"));
+    }
+    Ok(output_slice(out, out_len))
+}
+
+fn align_read_pair_bam_rust<'a>(
+    al: *mut BindAligner,
+    name: &[u8],
+    tags: &[u8],
+    read1: &[u8],
+    qual1: &[u8],
+    read2: &[u8],
+    qual2: &[u8],
+) -> Result<&'a [u8], Error> {
+    let mut out: *const c_char = std::ptr::null();
+    let mut out_len = 0;
+    let res = unsafe {
+        bindings::align_read_pair_bam(
+            al,
+            name.as_ptr() as *const c_char,
+            name.len(),
+            tags.as_ptr() as *const c_char,
+            tags.len(),
+            read1.as_ptr() as *const c_char,
+            read1.len(),
+            qual1.as_ptr() as *const c_char,
+            qual1.len(),
+            read2.as_ptr() as *const c_char,
+            read2.len(),
+            qual2.as_ptr() as *const c_char,
+            qual2.len(),
+            &mut out,
+            &mut out_len,
+        )
+    };
+    if res != 0 {
+        return Err(align_error(res, "read pair"));
+    }
+    Ok(output_slice(out, out_len))
+}
+
+/// The error for a failed alignment call, given its status
+fn align_error(res: c_int, what: &str) -> Error {
+    if res == bindings::ORBIT_BAD_READ {
+        format_err!("{what} is too long or its quality string has another length")
+    } else if res == bindings::ORBIT_BAD_TAGS {
+        format_err!("invalid SAM tags for {what}")
+    } else if res == bindings::ORBIT_BAD_NAME {
+        format_err!("name of {what} is longer than 254 bytes")
+    } else if res == bindings::ORBIT_BAD_MATES {
+        format_err!("{what} does not have 1 or 2 mates")
+    } else {
+        format_err!("STAR failed to align {what}: {res}")
+    }
+}
+
+/// The longest read name a BAM record can hold, without its 0-char
+const READ_NAME_MAX: usize = 254;
+
+/// Fail as STAR does for a read name too long for a BAM record, for the records built in Rust
+fn check_read_name(name: &[u8]) -> Result<(), Error> {
+    if name.len() > READ_NAME_MAX {
+        return Err(align_error(bindings::ORBIT_BAD_NAME, "read"));
+    }
+    Ok(())
+}
+
+/// The first `READ_NAME_MAX` bytes of a read name, for the methods that do not return errors
+fn truncate_read_name(name: &[u8]) -> &[u8] {
+    &name[..name.len().min(READ_NAME_MAX)]
+}
+
+fn output_slice<'a>(out: *const c_char, out_len: usize) -> &'a [u8] {
+    if out_len == 0 {
+        return &[];
+    }
+    unsafe { slice::from_raw_parts(out as *const u8, out_len) }
+}
+
+/// Adopt the BAM records written by STAR, each preceded by its block_size as in a BAM file
+fn bam_to_records(mut bam: &[u8]) -> Vec<bam::Record> {
+    let mut records = Vec::new();
+    while !bam.is_empty() {
+        let block_size = u32::from_le_bytes(bam[..4].try_into().unwrap()) as usize;
+        records.push(bam_to_record(&bam[4..4 + block_size]));
+        bam = &bam[4 + block_size..];
+    }
+    records
+}
+
+/// Build a record from a BAM block: the fixed-size fields followed by the variable-length data,
+/// which is copied as-is since STAR pads the read name to keep it 4-byte aligned, except for
+/// names too long to be padded within the length byte, which are padded here
+fn bam_to_record(block: &[u8]) -> bam::Record {
+    let u16_at = |i: usize| u16::from_le_bytes(block[i..i + 2].try_into().unwrap());
+    let i32_at = |i: usize| i32::from_le_bytes(block[i..i + 4].try_into().unwrap());
+    let data = &block[32..];
+    let l_qname = block[8] as usize;
+    let pad = (4 - l_qname % 4) % 4;
+    let name_len = data.iter().position(|&c| c == 0).unwrap();
+
+    let mut rec = bam::Record::new();
+    rec.set_tid(i32_at(0));
+    rec.set_pos(i32_at(4) as i64);
+    rec.set_mapq(block[9]);
+    rec.set_bin(u16_at(10));
+    rec.set_flags(u16_at(14));
+    rec.set_mtid(i32_at(20));
+    rec.set_mpos(i32_at(24) as i64);
+    rec.set_insert_size(i32_at(28) as i64);
+    let inner = &mut rec.inner;
+    inner.core.l_qname = (l_qname + pad) as u16;
+    inner.core.l_extranul = (l_qname + pad - name_len - 1) as u8;
+    inner.core.n_cigar = u16_at(12) as u32;
+    inner.core.l_qseq = i32_at(16);
+    let l_data = data.len() + pad;
+    unsafe {
+        // Record::new() owns a malloc'd data block which it frees on drop
+        let buf = libc::realloc(inner.data as *mut libc::c_void, l_data) as *mut u8;
+        assert!(!buf.is_null(), "failed to allocate BAM record data");
+        std::ptr::copy_nonoverlapping(data.as_ptr(), buf, l_qname);
+        std::ptr::write_bytes(buf.add(l_qname), 0, pad);
+        std::ptr::copy_nonoverlapping(
+            data.as_ptr().add(l_qname),
+            buf.add(l_qname + pad),
+            data.len() - l_qname,
+        );
+        inner.data = buf;
+    }
+    inner.l_data = l_data as i32;
+    inner.m_data = l_data as u32;
+    rec
+}
+
+/// Add SAM tags given as text, e.g. `b"CB:Z:ACGT\tUB:Z:TTGC"`, to a record built in Rust, as STAR
+/// does for the records it produces
+fn push_sam_tags(rec: &mut bam::Record, tags: &[u8]) -> Result<(), Error> {
+    if tags.is_empty() {
+        return Ok(());
+    }
+    let invalid = || format_err!("invalid SAM tags: {}", String::from_utf8_lossy(tags));
+    for tag in tags.split(|&c| c == b'\t') {
+        if tag.len() < 5 || tag[2] != b':' || tag[4] != b':' {
+            return Err(invalid());
+        }
+        let value = std::str::from_utf8(&tag[5..]).map_err(|_| invalid())?;
+        let aux = match tag[3] {
+            b'A' if value.len() == 1 => bam::record::Aux::Char(value.as_bytes()[0]),
+            b'i' => bam::record::Aux::I32(value.parse().map_err(|_| invalid())?),
+            b'f' => bam::record::Aux::Float(value.parse().map_err(|_| invalid())?),
+            b'Z' => bam::record::Aux::String(value),
+            _ => return Err(invalid()),
+        };
+        rec.push_aux(&tag[..2], aux).map_err(|_| invalid())?;
+    }
+    Ok(())
+}
+
+#[cfg(test)]
+mod test {
+    use super::*;
+    use rust_htslib::bam::record::Aux;
+    use rust_htslib::bam::Read;
+
+    /// References to some commonly used reference genomes for testing purposes
+    pub const DEFAULT_REF_1: &str = "/mnt/opt/refdata_cellranger/mm10-3.0.0/star";
+    pub const DEFAULT_REF_2: &str = "/mnt/opt/refdata_cellranger/GRCh38-3.0.0/star";
+    pub const DEFAULT_REF_3: &str = "/mnt/opt/refdata_cellranger/GRCh38-1.2.0/star";
+    pub const DEFAULT_REF_4: &str = "//mnt/opt/refdata_cellranger/hg19_and_mm10-3.0.0/star";
+
+    const ERCC_REF: &str = "test/ercc92-1.2.0/star/";
+
+    const NAME: &[u8] = b"NAME";
+    const ERCC_READ_1: &[u8] = b"GCATCCAGACCGTCGGCTGATCGTGGTTTTACTAGGCTAGACTAGCGTACGAGCACTATGGTCAGTAATTCCTGGAGGAATAGGTACCAAGAAAAAAACG";
+    const ERCC_QUAL_1: &[u8] = b"????????????????????????????????????????????????????????????????????????????????????????????????????";
+
+    const ERCC_READ_2: &[u8] = b"GGAGACGAATTGCCAGAATTATTAACTGCGCAGTTAGGGCAGCGTCTGAGGAAGTTTGCTGCGGTTTCGCCTTGACCGCGGGAAGGAGACATAACGATAG";
+    const ERCC_QUAL_2: &[u8] = b"????????????????????????????????????????????????????????????????????????????????????????????????????";
+
+    const ERCC_READ_3: &[u8] = b"AACTTAATGGACGGG";
+    const ERCC_QUAL_3: &[u8] = b"???????????????";
+
+    const ERCC_READ_4: &[u8] = b"AATCCACTCAATAAATCTAAAAAC";
+    const ERCC_QUAL_4: &[u8] = b"????????????????????????";
+
+    /// The ERCC reads aligned single-end by `assert_aligner_as_default`
+    const ERCC_READS: [(&[u8], &[u8]); 4] = [
+        (ERCC_READ_1, ERCC_QUAL_1),
+        (ERCC_READ_2, ERCC_QUAL_2),
+        (ERCC_READ_3, ERCC_QUAL_3),
+        (ERCC_READ_4, ERCC_QUAL_4),
+    ];
+
+    fn have_refs() -> bool {
+        Path::new("/mnt/opt/refdata_cellranger").exists()
+    }
+
+    /// Assert that the ERCC reference loaded with `settings` aligns like the ERCC reference
+    /// loaded with the default settings
+    fn assert_aligns_as_default(settings: StarSettings) {
+        let reference = StarReference::load(settings).unwrap();
+        assert_aligner_as_default(&mut reference.get_aligner());
+    }
+
+    /// Assert that `aligner` gives the same SAM records as an aligner of the ERCC reference
+    /// loaded with the default settings, for the four ERCC reads single-end and one pair
+    fn assert_aligner_as_default(aligner: &mut StarAligner) {
+        let reference = StarReference::load(StarSettings::new(ERCC_REF)).unwrap();
+        let mut expected = reference.get_aligner();
+        for (read, qual) in ERCC_READS {
+            assert_eq!(
+                aligner.align_read_sam(NAME, read, qual),
+                expected.align_read_sam(NAME, read, qual)
+            );
+        }
+        assert_eq!(
+            aligner.align_read_pair_sam(NAME, ERCC_READ_1, ERCC_QUAL_1, ERCC_READ_3, ERCC_QUAL_3),
+            expected.align_read_pair_sam(NAME, ERCC_READ_1, ERCC_QUAL_1, ERCC_READ_3, ERCC_QUAL_3)
+        );
+    }
+
+    /// Reads of 20 to 100 bases cut every 97 bases from the ERCC genome, every third one with a
+    /// mismatch in its middle, so that many seeds go through the suffix array search
+    fn ercc_genome_reads() -> Vec<Vec<u8>> {
+        let genome = std::fs::read(Path::new(ERCC_REF).join("Genome")).unwrap();
+        let mut reads = Vec::new();
+        for pos in (0..genome.len() - 100).step_by(97) {
+            let window = &genome[pos..pos + 20 + pos % 81];
+            if window.iter().any(|&b| b > 3) {
+                continue; // N or spacer between the sequences
+            }
+            let mut read: Vec<u8> = window.iter().map(|&b| b"ACGT"[b as usize]).collect();
+            if pos % 3 == 0 {
+                let mid = read.len() / 2;
+                read[mid] = b"ACGT"[(window[mid] as usize + 1) % 4];
+            }
+            reads.push(read);
+        }
+        reads
+    }
+
+    /// Assert that `aligner` gives the same SAM records as an aligner of the ERCC reference
+    /// loaded with the default settings, for the reads of `ercc_genome_reads`
+    fn assert_genome_reads_as_default(aligner: &mut StarAligner) {
+        let reference = StarReference::load(StarSettings::new(ERCC_REF)).unwrap();
+        let mut expected = reference.get_aligner();
+        let reads = ercc_genome_reads();
+        assert!(reads.len() > 500);
+        for read in &reads {
+            let qual = vec![b'?'; read.len()];
+            assert_eq!(
+                aligner.align_read_sam(NAME, read, &qual),
+                expected.align_read_sam(NAME, read, &qual)
+            );
+        }
+    }
+
+    /// A path in the temporary directory, unique to this process and `name`
+    fn temp_path(name: &str) -> std::path::PathBuf {
+        std::env::temp_dir().join(format!("orbit-test-{}-{name}", std::process::id()))
+    }
+
+    /// Copy the files of the ERCC reference into the temporary directory `temp_path(name)`,
+    /// to be removed by the test
+    fn copy_ercc_ref(name: &str) -> std::path::PathBuf {
+        let dir = temp_path(name);
+        std::fs::create_dir_all(&dir).unwrap();
+        for entry in std::fs::read_dir(ERCC_REF).unwrap() {
+            let path = entry.unwrap().path();
+            std::fs::copy(&path, dir.join(path.file_name().unwrap())).unwrap();
+        }
+        dir
+    }
+
+    #[test]
+    fn test_empty_tiny_reads() {
+        let settings = StarSettings::new(ERCC_REF);
+        let reference = StarReference::load(settings).unwrap();
+        let mut aligner = reference.get_aligner();
+
+        let recs = aligner.align_read(b"a", b"", b"");
+        println!("{recs:?}");
+        let recs = aligner.align_read(b"b", b"A", b"?");
+        let expected_qual: &[u8] = &[63 - 33];
+        println!("{recs:?}");
+        assert_eq!(recs[0].qual(), expected_qual, "Quality value incorrect");
+        let recs = aligner.align_read(b"Hello there", b"C", b"*");
+        let record = &recs[0];
+        let expected_qual: &[u8] = &[42 - 33];
+        assert_eq!(
+            record.qual(),
+            expected_qual,
+            "Quality value was not corrected."
+        );
+        assert_eq!(record.qname(), b"Hello there");
+        let aux_tags: Vec<(&[u8], Aux)> = record.aux_iter().map(|z| z.unwrap()).collect();
+        let expected_aux_tags = ["NH", "HI", "AS", "nM", "uT"];
+        println!("Aux Tags {aux_tags:?}");
+        for (i, tag) in aux_tags.into_iter().enumerate() {
+            assert_eq!(
+                String::from_utf8(tag.0.into()).unwrap(),
+                expected_aux_tags[i]
             );
             println!("TAG {:?}", String::from_utf8(tag.0.into()));
         }
@@ -570,6 +1862,214 @@ mod test {
         assert_eq!(recs[1].mapq(), 3);
     }
 
+    #[test]
+    fn test_ercc_align_mmap() {
+        for advice in [MmapAdvice::OnDemand, MmapAdvice::Populate] {
+            assert_aligns_as_default(StarSettings::new(ERCC_REF).mmap(advice));
+        }
+    }
+
+    #[test]
+    fn test_ercc_align_bundle() {
+        let settings = StarSettings::new(ERCC_REF);
+        let reference = StarReference::load(settings).unwrap();
+
+        let path = temp_path("ercc.bundle");
+        reference.write_bundle(&path).unwrap();
+        let settings = StarSettings::new(path.to_str().unwrap());
+        assert_eq!(
+            settings.est_mem().unwrap(),
+            std::fs::metadata(&path).unwrap().len() as usize
+        );
+        let bundle = StarReference::load(settings).unwrap();
+
+        assert_eq!(bundle.header_view().target_count(), 92);
+        assert_eq!(bundle.header().to_bytes(), reference.header().to_bytes());
+        assert_aligner_as_default(&mut bundle.get_aligner());
+
+        // options that need the genome directory
+        let bundle_settings = StarSettings::new(path.to_str().unwrap());
+        for settings in [
+            bundle_settings.clone().verify_checksums(),
+            bundle_settings.clone().sa_lcp(),
+            bundle_settings.clone().sa_hash(20, 64),
+            bundle_settings.clone().numa(NumaPlacement::Interleave),
+        ] {
+            let error = StarReference::load(settings).err().unwrap().to_string();
+            assert!(
+                error.contains("cannot be used with a genome bundle"),
+                "{}",
+                error
+            );
+        }
+        std::fs::remove_file(&path).unwrap();
+
+        // a directory that does not exist
+        let path = temp_path("missing").join("ercc.bundle");
+        let error = reference.write_bundle(&path).unwrap_err().to_string();
+        assert!(
+            error.contains("could not write the genome bundle"),
+            "{}",
+            error
+        );
+    }
+
+    #[test]
+    fn test_ercc_align_checksums() {
+        let dir = copy_ercc_ref("checksums");
+        let settings = StarSettings::new(dir.to_str().unwrap());
+        let reference = StarReference::load(settings.clone()).unwrap();
+        reference.write_checksums().unwrap();
+        assert!(dir.join("checksums.txt").exists());
+
+        for settings in [
+            settings.clone(),
+            settings.clone().mmap(MmapAdvice::OnDemand),
+        ] {
+            assert_aligns_as_default(settings.verify_checksums());
+        }
+
+        // flip a byte of the copied suffix array
+        let sa_path = dir.join("SA");
+        let mut sa = std::fs::read(&sa_path).unwrap();
+        let mid = sa.len() / 2;
+        sa[mid] ^= 0x40;
+        std::fs::write(&sa_path, &sa).unwrap();
+        for settings in [settings.clone(), settings.mmap(MmapAdvice::OnDemand)] {
+            let err = StarReference::load(settings.verify_checksums())
+                .err()
+                .unwrap();
+            assert!(err.to_string().contains("SA is corrupted"), "{err}");
+        }
+
+        // the checksums are computed from the files, which must still be there
+        std::fs::remove_file(&sa_path).unwrap();
+        let err = reference.write_checksums().unwrap_err();
+        assert!(
+            err.to_string().contains("could not open genome file"),
+            "{err}"
+        );
+        assert!(dir.join("checksums.txt").exists());
+        std::fs::remove_dir_all(&dir).unwrap();
+    }
+
+    #[test]
+    fn test_ercc_align_sa_lcp() {
+        let dir = copy_ercc_ref("sa-lcp");
+        let settings = StarSettings::new(dir.to_str().unwrap()).sa_lcp();
+        let computed = StarReference::load(settings.clone()).unwrap();
+        computed.write_sa_lcp().unwrap();
+        assert!(dir.join("SAlcp").exists());
+        assert_aligner_as_default(&mut computed.get_aligner());
+        assert_genome_reads_as_default(&mut computed.get_aligner());
+        assert_aligns_as_default(settings.clone());
+
+        // a truncated file is computed again rather than loaded
+        let lcp_path = dir.join("SAlcp");
+        let lcp = std::fs::read(&lcp_path).unwrap();
+        std::fs::write(&lcp_path, &lcp[..lcp.len() / 2]).unwrap();
+        assert_aligns_as_default(settings);
+
+        std::fs::remove_dir_all(&dir).unwrap();
+        let err = computed.write_sa_lcp().unwrap_err();
+        assert!(
+            err.to_string()
+                .contains("could not write the suffix array LCPs"),
+            "{err}"
+        );
+    }
+
+    #[test]
+    fn test_ercc_align_sa_hash() {
+        for (k, range_min) in [(20, 1), (12, 8)] {
+            assert_aligns_as_default(StarSettings::new(ERCC_REF).sa_hash(k, range_min));
+        }
+
+        // the seeds of the multimapping reads start from the ranges of their 12-mers
+        let settings = StarSettings::new(ERCC_REF).sa_hash(12, 8);
+        let reference = StarReference::load(settings).unwrap();
+        let mut aligner = reference.get_aligner();
+        aligner.align_read_sam(NAME, ERCC_READ_3, ERCC_QUAL_3);
+        let searches = aligner.sa_hash_searches();
+        assert!(searches > 0);
+        aligner.align_read_sam(NAME, ERCC_READ_4, ERCC_QUAL_4);
+        assert!(aligner.sa_hash_searches() > searches);
+        assert_genome_reads_as_default(&mut aligner);
+
+        // the index ranges of the seeds of ERCC_READ_4 are too small to be hashed with 64
+        let settings = StarSettings::new(ERCC_REF).sa_hash(20, 64);
+        let reference = StarReference::load(settings).unwrap();
+        let mut aligner = reference.get_aligner();
+        aligner.align_read_sam(NAME, ERCC_READ_4, ERCC_QUAL_4);
+        assert_eq!(aligner.sa_hash_searches(), 0);
+    }
+
+    #[test]
+    fn test_ercc_align_huge_pages() {
+        let settings = StarSettings::new(ERCC_REF);
+        let reference = StarReference::load(settings).unwrap();
+        assert_eq!(reference.huge_pages(), (0, 0));
+
+        // Hugetlb falls back to transparent huge pages, so both need them to be enabled
+        let enabled = std::fs::read_to_string("/sys/kernel/mm/transparent_hugepage/enabled");
+        if enabled.map_or(true, |enabled| enabled.contains("[never]")) {
+            eprintln!("skipping test_ercc_align_huge_pages: transparent huge pages are disabled");
+            return;
+        }
+        for source in [HugePages::Transparent, HugePages::Hugetlb] {
+            let settings = StarSettings::new(ERCC_REF).huge_pages(source);
+            let huge = StarReference::load(settings).unwrap();
+            let (huge_pages, total) = huge.huge_pages();
+            assert!(huge_pages > 0 && huge_pages <= total, "{:?}", source);
+            assert_aligner_as_default(&mut huge.get_aligner());
+        }
+    }
+
+    #[test]
+    fn test_ercc_align_byte_aligned_suffix_array() {
+        assert_aligns_as_default(StarSettings::new(ERCC_REF).byte_aligned_suffix_array());
+    }
+
+    #[test]
+    fn test_ercc_align_warm_up() {
+        let settings = StarSettings::new(ERCC_REF).mmap(MmapAdvice::OnDemand);
+        let mapped = StarReference::load(settings).unwrap();
+        let timing = mapped.warm_up(WarmUpLevel::Genome);
+        assert_eq!(timing.suffix_array, Duration::ZERO);
+        mapped.warm_up(WarmUpLevel::All);
+        assert_aligner_as_default(&mut mapped.get_aligner());
+    }
+
+    #[test]
+    fn test_ercc_align_numa() {
+        // on a single-node host the reference is not placed and the aligners have no node
+        let settings = StarSettings::new(ERCC_REF).numa(NumaPlacement::Replicate);
+        let replicated = StarReference::load(settings).unwrap();
+        let nodes = replicated.numa_nodes();
+        assert!(nodes.len() != 1);
+        let expected = if nodes.is_empty() {
+            vec![0]
+        } else {
+            nodes.clone()
+        };
+        for node in expected {
+            let mut numa_aligner = replicated.get_aligner_on_numa_node(node);
+            assert_eq!(numa_aligner.numa_node(), nodes.first().map(|_| node));
+            assert_eq!(numa_aligner.clone().numa_node(), numa_aligner.numa_node());
+            assert_aligner_as_default(&mut numa_aligner);
+        }
+    }
+
+    #[test]
+    fn test_ercc_align_shared_memory() {
+        // the second reference attaches to the segment loaded by the first one
+        let settings = StarSettings::new(ERCC_REF).shared_memory(SharedMemoryMode::RemoveWithLast);
+        let first = StarReference::load(settings.clone()).unwrap();
+        let second = StarReference::load(settings).unwrap();
+        drop(first);
+        assert_aligner_as_default(&mut second.get_aligner());
+    }
+
     #[test]
     fn test_transcriptome_min_score() {
         let settings = StarSettings::new(ERCC_REF).arg("--outFilterScoreMin=20");
@@ -618,6 +2118,463 @@ mod test {
         assert_eq!(zero_base_recs[0].flags(), one_base_recs[0].flags());
     }
 
+    #[test]
+    fn test_ercc_align_batch() {
+        let settings = StarSettings::new(ERCC_REF);
+        let reference = StarReference::load(settings).unwrap();
+        let mut aligner = reference.get_aligner();
+
+        let reads: Vec<(&[u8], &[u8], &[u8])> = vec![
+            (NAME, ERCC_READ_1, ERCC_QUAL_1),
+            (NAME, b"", b""),
+            (NAME, ERCC_READ_2, ERCC_QUAL_2),
+            (NAME, ERCC_READ_3, ERCC_QUAL_3),
+            (NAME, b"G", b"*"),
+            (NAME, ERCC_READ_4, ERCC_QUAL_4),
+        ];
+        let batch = aligner.align_batch(&reads);
+        assert_eq!(batch.len(), reads.len());
+        for (recs, &(name, read, qual)) in batch.iter().zip(&reads) {
+            assert_eq!(recs, &aligner.align_read(name, read, qual));
+        }
+
+        let pairs: Vec<ReadPair<'_>> = vec![
+            (NAME, ERCC_READ_1, ERCC_QUAL_1, ERCC_READ_2, ERCC_QUAL_2),
+            (NAME, b"", b"", ERCC_READ_3, ERCC_QUAL_3),
+            (NAME, ERCC_READ_3, ERCC_QUAL_3, ERCC_READ_4, ERCC_QUAL_4),
+        ];
+        let batch = aligner.align_pair_batch(&pairs);
+        assert_eq!(batch.len(), pairs.len());
+        for (recs, &(name, read1, qual1, read2, qual2)) in batch.iter().zip(&pairs) {
+            assert_eq!(
+                recs,
+                &aligner.align_read_pair(name, read1, qual1, read2, qual2)
+            );
+        }
+    }
+
+    #[test]
+    fn test_ercc_align_stream() {
+        let settings = StarSettings::new(ERCC_REF);
+        let reference = StarReference::load(settings).unwrap();
+        let mut aligner = reference.get_aligner();
+
+        let inputs: [(&[u8], &[u8]); 5] = [
+            (ERCC_READ_1, ERCC_QUAL_1),
+            (ERCC_READ_2, ERCC_QUAL_2),
+            (b"", b""),
+            (ERCC_READ_3, ERCC_QUAL_3),
+            (ERCC_READ_4, ERCC_QUAL_4),
+        ];
+        let reads: Vec<OwnedRead> = (0..1000)
+            .map(|i| {
+                let (read, qual) = inputs[i % inputs.len()];
+                (format!("r{i}").into_bytes(), read.to_vec(), qual.to_vec())
+            })
+            .collect();
+        // a small batch size gives many batches to be reordered
+        let stream: Vec<_> = reference.align_stream(reads.clone(), 4, 7).collect();
+        assert_eq!(stream.len(), reads.len());
+        for (recs, (name, read, qual)) in stream.iter().zip(&reads) {
+            assert_eq!(recs, &aligner.align_read(name, read, qual));
+        }
+
+        let pairs: Vec<OwnedReadPair> = (0..200)
+            .map(|i| {
+                let (read1, qual1) = inputs[i % inputs.len()];
+                let (read2, qual2) = inputs[(i + 1) % inputs.len()];
+                let name = format!("p{i}").into_bytes();
+                (
+                    name,
+                    read1.to_vec(),
+                    qual1.to_vec(),
+                    read2.to_vec(),
+                    qual2.to_vec(),
+                )
+            })
+            .collect();
+        let stream: Vec<_> = reference.align_stream(pairs.clone(), 3, 16).collect();
+        assert_eq!(stream.len(), pairs.len());
+        for (recs, (name, read1, qual1, read2, qual2)) in stream.iter().zip(&pairs) {
+            assert_eq!(
+                recs,
+                &aligner.align_read_pair(name, read1, qual1, read2, qual2)
+            );
+        }
+
+        // dropping the stream early stops the threads
+        let mut stream = reference.align_stream(reads, 2, 3);
+        assert!(stream.next().is_some());
+    }
+
+    #[test]
+    fn test_ercc_pool_bad_mates() {
+        let settings = StarSettings::new(ERCC_REF);
+        let reference = StarReference::load(settings).unwrap();
+        let pool = reference.align_pool(1, 4);
+
+        // OrbitRead holds two mates, more or none are rejected before anything is copied
+        for n_mates in [0, 3, usize::MAX] {
+            let read = bindings::OrbitRead {
+                name: NAME.as_ptr() as *const c_char,
+                name_len: NAME.len(),
+                tags: std::ptr::null(),
+                tags_len: 0,
+                n_mates,
+                seq: [ERCC_READ_3.as_ptr() as *const c_char; 2],
+                seq_len: [ERCC_READ_3.len(); 2],
+                qual: [ERCC_QUAL_3.as_ptr() as *const c_char; 2],
+                qual_len: [ERCC_QUAL_3.len(); 2],
+            };
+            let res = unsafe { bindings::orbit_submit(pool.pool, &read, 0) };
+            assert_eq!(res, bindings::ORBIT_BAD_MATES);
+        }
+        let err = pool.submit(NAME, &[], Box::new(|_| ())).unwrap_err();
+        assert!(err.to_string().contains("1 or 2 mates"));
+
+        let recs = pool
+            .align_read(NAME, ERCC_READ_3, ERCC_QUAL_3)
+            .unwrap()
+            .wait()
+            .unwrap();
+        let mut aligner = reference.get_aligner();
+        assert_eq!(recs, aligner.align_read(NAME, ERCC_READ_3, ERCC_QUAL_3));
+    }
+
+    #[test]
+    fn test_ercc_align_pool() {
+        let settings = StarSettings::new(ERCC_REF);
+        let reference = StarReference::load(settings).unwrap();
+        let mut aligner = reference.get_aligner();
+        let pool = reference.align_pool(3, 16);
+
+        let inputs: [(&[u8], &[u8]); 5] = [
+            (ERCC_READ_1, ERCC_QUAL_1),
+            (ERCC_READ_2, ERCC_QUAL_2),
+            (b"", b""),
+            (ERCC_READ_3, ERCC_QUAL_3),
+            (ERCC_READ_4, ERCC_QUAL_4),
+        ];
+        let mut futures = std::collections::VecDeque::new();
+        for i in 0..200 {
+            let (read, qual) = inputs[i % inputs.len()];
+            let name = format!("r{i}").into_bytes();
+            // wait for the oldest read when the pool is full
+            let future = loop {
+                match pool.align_read(&name, read, qual) {
+                    Ok(future) => break future,
+                    Err(_) => {
+                        let (name, read, qual, future): (Vec<u8>, &[u8], &[u8], AlignFuture<_>) =
+                            futures.pop_front().unwrap();
+                        let recs: Vec<bam::Record> = future.wait().unwrap();
+                        assert_eq!(recs, aligner.align_read(&name, read, qual));
+                    }
+                }
+            };
+            futures.push_back((name, read, qual, future));
+        }
+        for (name, read, qual, future) in futures {
+            assert_eq!(
+                future.wait().unwrap(),
+                aligner.align_read(&name, read, qual)
+            );
+        }
+
+        for i in 0..inputs.len() {
+            let (read1, qual1) = inputs[i];
+            let (read2, qual2) = inputs[(i + 2) % inputs.len()];
+            let recs = pool
+                .align_read_pair(NAME, read1, qual1, read2, qual2)
+                .unwrap()
+                .wait()
+                .unwrap();
+            assert_eq!(
+                recs,
+                aligner.align_read_pair(NAME, read1, qual1, read2, qual2)
+            );
+        }
+        let recs = pool
+            .align_read_pair(NAME, b"", b"", b"", b"")
+            .unwrap()
+            .wait()
+            .unwrap();
+        assert_eq!(recs, aligner.align_read_pair(NAME, b"", b"", b"", b""));
+
+        // reads still queued are cancelled when the pool is dropped
+        let future = pool.align_read(NAME, ERCC_READ_1, ERCC_QUAL_1).unwrap();
+        drop(pool);
+        let _ = future.wait();
+    }
+
+    #[test]
+    fn test_ercc_align_attributes() {
+        let mut settings = StarSettings::new(ERCC_REF)
+            .arg("--outSAMattributes")
+            .arg("NH")
+            .arg("HI")
+            .arg("AS")
+            .arg("nM")
+            .arg("NM")
+            .arg("MD")
+            .arg("XS");
+        settings.add_rg(vec!["ID:rg1".to_string(), "SM:ercc".to_string()]);
+        let reference = StarReference::load(settings).unwrap();
+        let mut aligner = reference.get_aligner();
+
+        let reads: Vec<(&[u8], &[u8], &[u8])> = vec![
+            (NAME, ERCC_READ_1, ERCC_QUAL_1),
+            (NAME, ERCC_READ_2, ERCC_QUAL_2),
+            (NAME, ERCC_READ_3, ERCC_QUAL_3),
+            (NAME, ERCC_READ_4, ERCC_QUAL_4),
+        ];
+        let batch = aligner.align_batch(&reads);
+        for (recs, &(name, read, qual)) in batch.iter().zip(&reads) {
+            assert_eq!(recs, &aligner.align_read(name, read, qual));
+        }
+        let recs = aligner.align_read(NAME, ERCC_READ_1, ERCC_QUAL_1);
+        assert_eq!(recs[0].qname(), NAME);
+        assert_eq!(recs[0].aux(b"RG").unwrap(), Aux::String("rg1"));
+        assert!(recs[0].aux(b"MD").is_ok());
+
+        let settings = StarSettings::new(ERCC_REF)
+            .arg("--outSAMattributes")
+            .arg("NH")
+            .arg("jM")
+            .arg("jI");
+        let reference = StarReference::load(settings).unwrap();
+        let mut aligner = reference.get_aligner();
+        let batch = aligner.align_batch(&reads);
+        for (recs, &(name, read, qual)) in batch.iter().zip(&reads) {
+            assert_eq!(recs, &aligner.align_read(name, read, qual));
+        }
+    }
+
+    #[test]
+    fn test_ercc_align_tags() {
+        let settings = StarSettings::new(ERCC_REF);
+        let reference = StarReference::load(settings).unwrap();
+        let mut aligner = reference.get_aligner();
+        let tags: &[u8] = b"CB:Z:ACGTACGT-1\tUB:Z:TTGCA\txf:i:-17\tgx:A:g";
+
+        let sam = aligner.align_read_sam(NAME, ERCC_READ_3, ERCC_QUAL_3);
+        assert_eq!(sam.lines().count(), 2);
+        assert!(sam.lines().all(|line| line.starts_with("NAME\t")));
+
+        let empty: &[u8] = b"";
+        for (read, qual) in [(ERCC_READ_3, ERCC_QUAL_3), (empty, empty)] {
+            let recs = aligner
+                .align_read_with_tags(NAME, read, qual, tags)
+                .unwrap();
+            for rec in &recs {
+                assert_eq!(rec.qname(), NAME);
+                assert_eq!(rec.aux(b"CB").unwrap(), Aux::String("ACGTACGT-1"));
+                assert_eq!(rec.aux(b"UB").unwrap(), Aux::String("TTGCA"));
+                assert_eq!(rec.aux(b"xf").unwrap(), Aux::I32(-17));
+                assert_eq!(rec.aux(b"gx").unwrap(), Aux::Char(b'g'));
+            }
+        }
+        let (recs1, recs2) = aligner
+            .align_read_pair_with_tags(NAME, ERCC_READ_1, ERCC_QUAL_1, b"", b"", tags)
+            .unwrap();
+        for rec in recs1.iter().chain(&recs2) {
+            assert_eq!(rec.aux(b"CB").unwrap(), Aux::String("ACGTACGT-1"));
+        }
+
+        let reads: Vec<(&[u8], &[u8], &[u8])> = vec![
+            (NAME, ERCC_READ_3, ERCC_QUAL_3),
+            (NAME, b"", b""),
+            (NAME, ERCC_READ_1, ERCC_QUAL_1),
+        ];
+        let read_tags: Vec<&[u8]> = vec![tags, tags, b""];
+        let batch = aligner.align_batch_with_tags(&reads, &read_tags);
+        for ((recs, &(name, read, qual)), &t) in batch.iter().zip(&reads).zip(&read_tags) {
+            assert_eq!(
+                recs.as_ref().unwrap(),
+                &aligner.align_read_with_tags(name, read, qual, t).unwrap()
+            );
+        }
+        let pairs: Vec<ReadPair<'_>> = vec![
+            (NAME, ERCC_READ_1, ERCC_QUAL_1, ERCC_READ_2, ERCC_QUAL_2),
+            (NAME, ERCC_READ_1, ERCC_QUAL_1, b"", b""),
+        ];
+        let batch = aligner.align_pair_batch_with_tags(&pairs, &[tags, tags]);
+        for (recs, &(name, read1, qual1, read2, qual2)) in batch.iter().zip(&pairs) {
+            let expected = aligner
+                .align_read_pair_with_tags(name, read1, qual1, read2, qual2, tags)
+                .unwrap();
+            assert_eq!(recs.as_ref().unwrap(), &expected);
+        }
+
+        for bad in [&b"CB:Z:A\t"[..], b"CB:B:c,1", b"xf:i:one", b"CB"] {
+            assert!(aligner
+                .align_read_with_tags(NAME, ERCC_READ_1, ERCC_QUAL_1, bad)
+                .is_err());
+            assert!(aligner.align_read_with_tags(NAME, b"", b"", bad).is_err());
+            // only the read with the bad tags fails
+            for bad_read in [1, 2] {
+                let mut read_tags: Vec<&[u8]> = vec![b""; 3];
+                read_tags[bad_read] = bad;
+                let batch = aligner.align_batch_with_tags(&reads, &read_tags);
+                for (i, recs) in batch.iter().enumerate() {
+                    assert_eq!(recs.is_err(), i == bad_read);
+                }
+            }
+        }
+    }
+
+    #[test]
+    fn test_ercc_align_long_name() {
+        let settings = StarSettings::new(ERCC_REF);
+        let reference = StarReference::load(settings).unwrap();
+        let mut aligner = reference.get_aligner();
+        let expected = aligner.align_read(NAME, ERCC_READ_3, ERCC_QUAL_3);
+
+        // 254 bytes with the 0-char fill the BAM length byte, too long to be padded by STAR
+        for len in [251, 252, 254] {
+            let name = vec![b'r'; len];
+            let recs = aligner
+                .align_read_with_tags(&name, ERCC_READ_3, ERCC_QUAL_3, b"")
+                .unwrap();
+            assert_eq!(recs.len(), expected.len());
+            for (rec, exp) in recs.iter().zip(&expected) {
+                assert_eq!(rec.qname(), &name[..]);
+                assert_eq!(rec.pos(), exp.pos());
+                assert_eq!(rec.cigar(), exp.cigar());
+                assert_eq!(rec.seq().as_bytes(), exp.seq().as_bytes());
+            }
+            let (recs1, recs2) = aligner
+                .align_read_pair_with_tags(
+                    &name,
+                    ERCC_READ_1,
+                    ERCC_QUAL_1,
+                    ERCC_READ_2,
+                    ERCC_QUAL_2,
+                    b"",
+                )
+                .unwrap();
+            assert!(recs1
+                .iter()
+                .chain(&recs2)
+                .all(|rec| rec.qname() == &name[..]));
+        }
+
+        let name = vec![b'r'; 255];
+        assert!(aligner
+            .align_read_with_tags(&name, ERCC_READ_3, ERCC_QUAL_3, b"")
+            .is_err());
+        assert!(aligner.align_read_with_tags(&name, b"", b"", b"").is_err());
+        assert!(aligner
+            .align_read_pair_with_tags(
+                &name,
+                ERCC_READ_1,
+                ERCC_QUAL_1,
+                ERCC_READ_2,
+                ERCC_QUAL_2,
+                b""
+            )
+            .is_err());
+        let reads: Vec<(&[u8], &[u8], &[u8])> = vec![
+            (NAME, ERCC_READ_1, ERCC_QUAL_1),
+            (&name, ERCC_READ_3, ERCC_QUAL_3),
+        ];
+        let batch = aligner.align_batch_with_tags(&reads, &[]);
+        let expected_1 = aligner.align_read(NAME, ERCC_READ_1, ERCC_QUAL_1);
+        assert_eq!(batch[0].as_ref().unwrap(), &expected_1);
+        assert!(batch[1].is_err());
+        // the aligner is still usable
+        assert_eq!(aligner.align_read(NAME, ERCC_READ_3, ERCC_QUAL_3), expected);
+
+        // the methods without errors truncate the name
+        let recs = aligner.align_read(&name, ERCC_READ_3, ERCC_QUAL_3);
+        assert!(recs.iter().all(|rec| rec.qname() == &name[..254]));
+        let batch = aligner.align_batch(&reads);
+        assert!(batch[1].iter().all(|rec| rec.qname() == &name[..254]));
+        let sam = aligner.align_read_sam(&name, ERCC_READ_3, ERCC_QUAL_3);
+        assert!(sam.starts_with(std::str::from_utf8(&name[..254]).unwrap()));
+    }
+
+    #[test]
+    fn test_ercc_align_bad_read() {
+        let settings = StarSettings::new(ERCC_REF);
+        let reference = StarReference::load(settings).unwrap();
+        let mut aligner = reference.get_aligner();
+        let expected = aligner.align_read(NAME, ERCC_READ_3, ERCC_QUAL_3);
+
+        let long_read = ERCC_READ_1.repeat(651 / ERCC_READ_1.len() + 1);
+        let long_qual = vec![b'?'; long_read.len()];
+        let half_read = &long_read[..long_read.len() / 2];
+        let half_qual = &long_qual[..half_read.len()];
+        assert!(aligner
+            .align_read_with_tags(NAME, ERCC_READ_3, ERCC_QUAL_1, b"")
+            .is_err());
+        assert!(aligner
+            .align_read_with_tags(NAME, &long_read, &long_qual, b"")
+            .is_err());
+        // each mate fits, the pair does not
+        assert!(aligner
+            .align_read_with_tags(NAME, half_read, half_qual, b"")
+            .is_ok());
+        assert!(aligner
+            .align_read_pair_with_tags(NAME, half_read, half_qual, half_read, half_qual, b"")
+            .is_err());
+        let reads: Vec<(&[u8], &[u8], &[u8])> = vec![
+            (NAME, ERCC_READ_3, ERCC_QUAL_1),
+            (NAME, ERCC_READ_3, ERCC_QUAL_3),
+        ];
+        let batch = aligner.align_batch_with_tags(&reads, &[]);
+        assert!(batch[0].is_err());
+        assert_eq!(batch[1].as_ref().unwrap(), &expected);
+        assert_eq!(aligner.align_read(NAME, ERCC_READ_3, ERCC_QUAL_3), expected);
+    }
+
+    #[test]
+    fn test_ercc_batch_bad_mates() {
+        let settings = StarSettings::new(ERCC_REF);
+        let reference = StarReference::load(settings).unwrap();
+        let mut aligner = reference.get_aligner();
+        let expected = aligner.align_read(NAME, ERCC_READ_3, ERCC_QUAL_3);
+
+        // the C API takes the number of mates from the caller, only 1 and 2 are aligned
+        let mut batch = BatchBuffers::new();
+        for n_mates in [0, 3] {
+            batch.clear();
+            for _ in 0..2 {
+                batch.push_name(NAME, b"");
+                for _ in 0..3 {
+                    batch.push(ERCC_READ_3, ERCC_QUAL_3);
+                }
+            }
+            batch.align(aligner.aligner, n_mates);
+            for i in 0..2 {
+                assert_eq!(batch.status[i], bindings::ORBIT_BAD_MATES);
+                assert_eq!(batch.offsets[i + 1], 0);
+                let err = batch.output(i, "read").unwrap_err();
+                assert!(err.to_string().contains("1 or 2 mates"));
+            }
+        }
+        assert_eq!(aligner.align_read(NAME, ERCC_READ_3, ERCC_QUAL_3), expected);
+    }
+
+    #[test]
+    fn test_ercc_scratch_usage() {
+        let settings = StarSettings::new(ERCC_REF);
+        let reference = StarReference::load(settings).unwrap();
+        let mut aligner = reference.get_aligner();
+        let initial = aligner.scratch_usage();
+        assert_eq!(initial.peak_seeds, 0);
+        // far below what the per-read limits of STAR would need
+        assert!(initial.bytes < 1 << 20);
+
+        aligner.align_read(NAME, ERCC_READ_3, ERCC_QUAL_3);
+        aligner.align_read_pair(NAME, ERCC_READ_1, ERCC_QUAL_1, ERCC_READ_2, ERCC_QUAL_2);
+        let usage = aligner.scratch_usage();
+        assert!(usage.peak_seeds > 0);
+        assert!(usage.peak_windows > 0);
+        assert!(usage.peak_transcripts > 0);
+        assert!(usage.peak_multimappers > 0);
+        assert_eq!(usage.bytes, initial.bytes);
+    }
+
     #[test]
     fn test_multithreaded_alignment() {
         let settings = StarSettings::new(ERCC_REF);
@@ -661,7 +2618,7 @@ mod test {
         let qual = b"GGGAGIGIIIGIIGGGGIIGGIGGAGGAGGAAG.GGIIIG<AGGAGGGIGGGGIIIIIGGIGGGGGIGIIGGAGGGGGIGGGIGIIGGGGIIGGGIIG";
 
         let res = aligner.align_read_sam(b"name", read, qual);
-        assert!(res == "\t0\t6\t30070474\t255\t98M\t*\t0\t0\tGTGCGGGGAGAAGTTTCAAGAAGGTTCTTATGGAAAAAAGGCTGTGAGCATAGAAAGCAGTCATAGGAGGTTGGGGAACTAGCTTGTCCCTCCCCACC\tGGGAGIGIIIGIIGGGGIIGGIGGAGGAGGAAG.GGIIIG<AGGAGGGIGGGGIIIIIGGIGGGGGIGIIGGAGGGGGIGGGIGIIGGGGIIGGGIIG\tNH:i:1\tHI:i:1\tAS:i:96\tnM:i:0\n");
+        assert!(res == "name\t0\t6\t30070474\t255\t98M\t*\t0\t0\tGTGCGGGGAGAAGTTTCAAGAAGGTTCTTATGGAAAAAAGGCTGTGAGCATAGAAAGCAGTCATAGGAGGTTGGGGAACTAGCTTGTCCCTCCCCACC\tGGGAGIGIIIGIIGGGGIIGGIGGAGGAGGAAG.GGIIIG<AGGAGGGIGGGGIIIIIGGIGGGGGIGIIGGAGGGGGIGGGIGIIGGGGIIGGGIIG\tNH:i:1\tHI:i:1\tAS:i:96\tnM:i:0\n");
     }
 
     // random selection of genome sequences
@@ -735,7 +2692,7 @@ mod test {
 
         let res = aligner.align_read_sam(b"name", read, qual);
         println!("res: {res}");
-        assert!(res == "\t0\thg19_6\t30038251\t255\t98M\t*\t0\t0\tGTGCGGGGAGAAGTTTCAAGAAGGTTCTTATGGAAAAAAGGCTGTGAGCATAGAAAGCAGTCATAGGAGGTTGGGGAACTAGCTTGTCCCTCCCCACC\tGGGAGIGIIIGIIGGGGIIGGIGGAGGAGGAAG.GGIIIG<AGGAGGGIGGGGIIIIIGGIGGGGGIGIIGGAGGGGGIGGGIGIIGGGGIIGGGIIG\tNH:i:1\tHI:i:1\tAS:i:96\tnM:i:0\n");
+        assert!(res == "name\t0\thg19_6\t30038251\t255\t98M\t*\t0\t0\tGTGCGGGGAGAAGTTTCAAGAAGGTTCTTATGGAAAAAAGGCTGTGAGCATAGAAAGCAGTCATAGGAGGTTGGGGAACTAGCTTGTCCCTCCCCACC\tGGGAGIGIIIGIIGGGGIIGGIGGAGGAGGAAG.GGIIIG<AGGAGGGIGGGGIIIIIGGIGGGGGIGIIGGAGGGGGIGGGIGIIGGGGIIGGGIIG\tNH:i:1\tHI:i:1\tAS:i:96\tnM:i:0\n");
     }
 
     #[test]
@@ -789,8 +2746,8 @@ mod test {
         let res = aligner.align_read_sam(b"name", read, qual);
         let res2 = aligner.align_read_sam(b"name2", read2, qual2);
 
-        assert!(res == "\t0\t6\t30070474\t255\t98M\t*\t0\t0\tGTGCGGGGAGAAGTTTCAAGAAGGTTCTTATGGAAAAAAGGCTGTGAGCATAGAAAGCAGTCATAGGAGGTTGGGGAACTAGCTTGTCCCTCCCCACC\tGGGAGIGIIIGIIGGGGIIGGIGGAGGAGGAAG.GGIIIG<AGGAGGGIGGGGIIIIIGGIGGGGGIGIIGGAGGGGGIGGGIGIIGGGGIIGGGIIG\tNH:i:1\tHI:i:1\tAS:i:96\tnM:i:0\n");
-        assert!(res2 == "\t0\t6\t132816509\t255\t55M396N43M\t*\t0\t0\tGTATGTCAAGTTGGTGGAGGCCCTTTGTGCTGAACACCAAATCAACCTAATTAAGGTTGATGACAACAAGAAACTAGGAGAATGGGTAGGCCTTTGTA\tAGGAGGGGIG.GAGGGGIGGIGIIGGGIIAAGGGGGIGGIIGAGIGIA.GGGGIGGGGGGGGGGGGGGIGIIIIGGGGGGIGGGGIIIGA.G.<.GGG\tNH:i:1\tHI:i:1\tAS:i:98\tnM:i:0\n");
+        assert!(res == "name\t0\t6\t30070474\t255\t98M\t*\t0\t0\tGTGCGGGGAGAAGTTTCAAGAAGGTTCTTATGGAAAAAAGGCTGTGAGCATAGAAAGCAGTCATAGGAGGTTGGGGAACTAGCTTGTCCCTCCCCACC\tGGGAGIGIIIGIIGGGGIIGGIGGAGGAGGAAG.GGIIIG<AGGAGGGIGGGGIIIIIGGIGGGGGIGIIGGAGGGGGIGGGIGIIGGGGIIGGGIIG\tNH:i:1\tHI:i:1\tAS:i:96\tnM:i:0\n");
+        assert!(res2 == "name2\t0\t6\t132816509\t255\t55M396N43M\t*\t0\t0\tGTATGTCAAGTTGGTGGAGGCCCTTTGTGCTGAACACCAAATCAACCTAATTAAGGTTGATGACAACAAGAAACTAGGAGAATGGGTAGGCCTTTGTA\tAGGAGGGGIG.GAGGGGIGGIGIIGGGIIAAGGGGGIGGIIGAGIGIA.GGGGIGGGGGGGGGGGGGGIGIIIIGGGGGGIGGGGIIIGA.G.<.GGG\tNH:i:1\tHI:i:1\tAS:i:98\tnM:i:0\n");
     }
 
     #[test]
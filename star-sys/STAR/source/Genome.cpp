@@ -9,10 +9,25 @@
 #include <time.h>
 #include <cmath>
 #include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
+#include <thread>
+#include <pthread.h>
 
+#define SHM_projectID 23 //ftok project ID for the key of the shared genome
+#define SHM_sizeG 0 //offsets in the shared segment: nGenome, recorded once the genome is loaded
+#define SHM_sizeSA 8 //nSAbyte
+#define SHM_loadState 16 //SHM_loadLocked once the loading job holds the mutex at SHM_loadMutex
+#define SHM_loadMutex 24 //robust mutex held by the loading job until the genome is loaded
+#define SHM_startG 64 //start of G1, followed by SA and SAi
+#define SHM_loadLocked 1
+#define SHM_loadWaitMax 3600 //seconds to wait for another job to start loading the genome into shared memory
+static_assert(SHM_loadMutex+sizeof(pthread_mutex_t)<=SHM_startG, "the load mutex overlaps the genome in shared memory");
+#define HUGE_PAGE_bytes (1LLU<<21) //--genomeHugePages always asks for 2 MB pages
 
-Genome::Genome (Parameters &Pin ): pGe(Pin.pGe), P(Pin) {
+
+Genome::Genome (Parameters &Pin ): pGe(Pin.pGe), hugePagesN(0), hugePagesTotal(0), P(Pin), G1(NULL) {
 
 
     sjdbOverhang = pGe.sjdbOverhang; //will be re-defined later if another value was used for the generated genome
@@ -26,12 +41,25 @@ Genome::~Genome()
 
 void Genome::freeMemory(){//free big chunks of memory used by genome and suffix array
 
-    if (pGe.gLoad=="NoSharedMemory") {//can deallocate only for non-shared memory
+    if (!mmapRegions.empty()) {//--genomeLoad Mmap, or private arrays backed by huge pages
+        for (auto &region : mmapRegions)
+            munmap(region.first, region.second);
+        mmapRegions.clear();
+        G1=NULL;
+        SA.pointArray(NULL);
+        SApass2.deallocateArray();
+        SAi.pointArray(NULL);
+    } else if (pGe.gLoad=="NoSharedMemory") {//can deallocate only for non-shared memory
         if (G1 != NULL) delete[] G1;
         G1=NULL;
         SA.deallocateArray();
         SApass2.deallocateArray();
         SAi.deallocateArray();
+    } else if (sharedMemory) {//detach, the last job with --genomeLoad LoadAndRemove removes the segment
+        sharedMemory.reset();
+        G1=NULL;
+        SA.pointArray(NULL);
+        SAi.pointArray(NULL);
     };
 };
 
@@ -68,6 +96,214 @@ uint Genome::OpenStream(string name, ifstream & stream, uint size)
     return size;
 };
 
+char* Genome::mmapFile(string name, uint fileBytes, uint headBytes, uint tailBytes, char fill)
+{//map the first fileBytes of a genome file read-only, with headBytes before and tailBytes after it set to fill
+    uint pageBytes=sysconf(_SC_PAGESIZE);
+    uint headMapBytes=(headBytes+pageBytes-1)/pageBytes*pageBytes;
+    uint mapBytes=headMapBytes+(fileBytes+tailBytes+pageBytes-1)/pageBytes*pageBytes;
+
+    int fd=open((pGe.gDir+ "/" +name).c_str(), O_RDONLY);
+    struct stat fileStat;
+    if (fd<0 || fstat(fd,&fileStat)!=0 || (uint) fileStat.st_size<fileBytes) {
+        ostringstream errOut;
+        errOut << "EXITING because of FATAL ERROR: could not open genome file, or it is too short: "<< pGe.gDir << "/" << name <<"\n";
+        errOut << "SOLUTION: check that the path to genome files, specified in --genomeDir is correct and the files are present, and have user read permissions\n" <<flush;
+        exitWithError(errOut.str(),std::cerr, P.inOut->logMain, EXIT_CODE_GENOME_FILES, P);
+    };
+
+    //reserve the whole range with anonymous memory, which provides the guards, then map the file over its middle
+    int mapFlags=MAP_PRIVATE|MAP_FIXED;
+    #ifdef MAP_POPULATE
+    if (pGe.gMmapAdvice=="Populate") mapFlags|=MAP_POPULATE;
+    #endif
+    char *mapStart=(char*) mmap(NULL, mapBytes, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    char *fileStart=mapStart+headMapBytes;
+    if (mapStart==MAP_FAILED || mmap(fileStart, fileBytes, PROT_READ, mapFlags, fd, 0)==MAP_FAILED) {
+        ostringstream errOut;
+        errOut <<"EXITING: fatal error trying to map genome file " << pGe.gDir << "/" << name << ": " << strerror(errno) <<"\n";
+        errOut <<"Possible cause: not enough virtual memory allowed with ulimit. SOLUTION: run ulimit -v " <<  mapBytes+2000000000<<endl <<flush;
+        exitWithError(errOut.str(),std::cerr, P.inOut->logMain, EXIT_CODE_MEMORY_ALLOCATION, P);
+    };
+    close(fd);
+    mmapRegions.push_back({mapStart, mapBytes});
+
+    if (pGe.gMmapAdvice=="WillNeed") {
+        madvise(fileStart, fileBytes, MADV_WILLNEED);
+    } else if (pGe.gMmapAdvice=="Random") {
+        madvise(fileStart, fileBytes, MADV_RANDOM);
+    #ifndef MAP_POPULATE
+    } else if (pGe.gMmapAdvice=="Populate") {
+        madvise(fileStart, fileBytes, MADV_WILLNEED);
+    #endif
+    };
+
+    if (fill!=0) {//anonymous memory and the bytes past the end of the file are already 0
+        memset(fileStart-headBytes, fill, headBytes);
+        char *tailStart=fileStart+fileBytes;
+        if (fileBytes%pageBytes!=0) {//the tail starts in the last page of the file, which has to be copied to write into it
+            mprotect(tailStart-fileBytes%pageBytes, pageBytes, PROT_READ|PROT_WRITE);
+        };
+        memset(tailStart, fill, tailBytes);
+    };
+    mprotect(mapStart, mapBytes, PROT_READ);
+
+    P.inOut->logMain << "Mapped " << name << ": " << fileBytes << " bytes, --genomeMmapAdvice " << pGe.gMmapAdvice << "\n" << flush;
+    return fileStart;
+};
+
+char* Genome::hugePagesAlloc(uint bytes)
+{//allocate private anonymous memory backed by huge pages if possible, recorded in mmapRegions
+    uint mapBytes=(bytes+HUGE_PAGE_bytes-1)/HUGE_PAGE_bytes*HUGE_PAGE_bytes;
+    #ifdef MAP_HUGETLB
+    if (pGe.gHugePages=="Hugetlb") {
+        int mapFlags=MAP_PRIVATE|MAP_ANONYMOUS|MAP_HUGETLB;
+        #ifdef MAP_HUGE_SHIFT
+        mapFlags|=21<<MAP_HUGE_SHIFT;
+        #endif
+        char *mapStart=(char*) mmap(NULL, mapBytes, PROT_READ|PROT_WRITE, mapFlags, -1, 0);
+        if (mapStart!=MAP_FAILED) {
+            mmapRegions.push_back({mapStart, mapBytes});
+            return mapStart;
+        };
+        P.inOut->logMain << "WARNING: could not obtain " << mapBytes/HUGE_PAGE_bytes << " huge pages from the hugetlbfs pool: " << strerror(errno) << ". Will request transparent huge pages instead\n" <<flush;
+    };
+    #endif
+
+    //over-allocate to align the array to a huge page, then trim the ends
+    char *reserved=(char*) mmap(NULL, mapBytes+HUGE_PAGE_bytes, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+    if (reserved==MAP_FAILED) {
+        ostringstream errOut;
+        errOut <<"EXITING: fatal error trying to allocate genome arrays: " << strerror(errno) <<"\n";
+        errOut <<"Possible cause: not enough virtual memory allowed with ulimit. SOLUTION: run ulimit -v " <<  mapBytes+2000000000<<endl <<flush;
+        exitWithError(errOut.str(),std::cerr, P.inOut->logMain, EXIT_CODE_MEMORY_ALLOCATION, P);
+    };
+    char *mapStart=reserved+(HUGE_PAGE_bytes-(uintptr_t) reserved%HUGE_PAGE_bytes)%HUGE_PAGE_bytes;
+    if (mapStart>reserved)
+        munmap(reserved, mapStart-reserved);
+    munmap(mapStart+mapBytes, reserved+HUGE_PAGE_bytes-mapStart);
+    mmapRegions.push_back({mapStart, mapBytes});
+    hugePagesAdvise(mapStart, mapBytes);
+    return mapStart;
+};
+
+void Genome::hugePagesAdvise(char *start, uint bytes)
+{//ask for transparent huge pages, which are used if /sys/kernel/mm/transparent_hugepage allows them
+    #ifdef MADV_HUGEPAGE
+    if (madvise(start, bytes, MADV_HUGEPAGE)==0)
+        return;
+    #endif
+    P.inOut->logMain << "WARNING: transparent huge pages are not available: " << strerror(errno) << "\n" <<flush;
+};
+
+void Genome::hugePagesLog()
+{//count the huge pages backing the genome arrays in /proc/self/smaps. Mappings next to each other can be merged, so only the total is reported
+    vector<pair<char*,uint>> arrays={{G1,nGenome+2*(G-G1)}, {SA.charArray,SA.lengthByte}, {SAi.charArray,SAi.lengthByte}};
+    hugePagesTotal=0;
+    for (auto &a : arrays)
+        hugePagesTotal+=(a.second+HUGE_PAGE_bytes-1)/HUGE_PAGE_bytes;
+
+    uint hugeBytes=0;
+    bool overlaps=false;
+    ifstream smaps("/proc/self/smaps");
+    string line;
+    while (getline(smaps,line)) {
+        unsigned long long vmStart, vmEnd;
+        if (sscanf(line.c_str(), "%llx-%llx ", &vmStart, &vmEnd)==2) {//a new mapping
+            overlaps=false;
+            for (auto &a : arrays)
+                overlaps = overlaps || ((uintptr_t) a.first<vmEnd && (uintptr_t) a.first+a.second>vmStart);
+        } else if (overlaps) {
+            string field;
+            uint kB=0;
+            istringstream(line) >> field >> kB;
+            if (field=="AnonHugePages:" || field=="ShmemPmdMapped:" || field=="FilePmdMapped:" || field=="Private_Hugetlb:" || field=="Shared_Hugetlb:")
+                hugeBytes+=kB*1024;
+        };
+    };
+    hugePagesN=min(hugeBytes/HUGE_PAGE_bytes,hugePagesTotal);
+    P.inOut->logMain << "--genomeHugePages " << pGe.gHugePages << ": Genome, SA and SAindex are backed by " << hugePagesN << " huge pages out of " << hugePagesTotal << "\n" <<flush;
+};
+
+bool Genome::sharedMemoryAttach(uint L)
+{//attach to the genome in shared memory, creating the segment if no other job has. Returns true if this job has to load the genome into it
+    uint shmStartSA=(SHM_startG+nGenome+L+L+7)/8*8; //keep SA 8-byte aligned
+    uint shmSize=shmStartSA+SA.lengthByte+SAi.lengthByte;
+    shmKey=ftok(pGe.gDir.c_str(),SHM_projectID);
+    try {
+        sharedMemory.reset(new SharedMemory(shmKey, pGe.gLoad=="LoadAndRemove"));
+        sharedMemory->SetErrorStream(&P.inOut->logMain);
+        if (sharedMemory->NeedsAllocation())
+            sharedMemory->Allocate(shmSize);
+    } catch (const SharedMemoryException & exc) {
+        ostringstream errOut;
+        errOut << "EXITING: fatal error with the genome in shared memory, key=" << shmKey << ", error code: " << exc.GetErrorCode() << ", errno: " << exc.GetErrorDetail() << " " << strerror(exc.GetErrorDetail()) << "\n";
+        errOut << "SOLUTION: check that /dev/shm is writable and has " << shmSize << " bytes available, or run with --genomeLoad NoSharedMemory\n" <<flush;
+        exitWithError(errOut.str(),std::cerr, P.inOut->logMain, EXIT_CODE_SHM, P);
+    };
+
+    shmStart=(char*) sharedMemory->GetMapped();
+    if (pGe.gHugePages!="None") {//POSIX shared memory is on tmpfs, which can use transparent huge pages but not hugetlbfs
+        uint pageBytes=sysconf(_SC_PAGESIZE);
+        char *mapStart=shmStart-(uintptr_t) shmStart%pageBytes;
+        hugePagesAdvise(mapStart, shmStart+shmSize-mapStart);
+    };
+    if (sharedMemory->GetSize()!=shmSize) {
+        ostringstream errOut;
+        errOut << "EXITING: fatal error, the genome in shared memory (key=" << shmKey << ") has " << sharedMemory->GetSize() << " bytes, while the genome files need " << shmSize << " bytes\n";
+        errOut << "SOLUTION: the genome files have changed since they were loaded into shared memory. Remove the old segment /dev/shm/" << shmKey << " once no jobs use it\n" <<flush;
+        exitWithError(errOut.str(),std::cerr, P.inOut->logMain, EXIT_CODE_SHM, P);
+    };
+    G1=shmStart+SHM_startG;
+    SA.pointArray(shmStart+shmStartSA);
+    SAi.pointArray(SA.charArray+SA.lengthByte);
+
+    pthread_mutex_t *loadMutex=(pthread_mutex_t*) (shmStart+SHM_loadMutex);
+    uint *shmState=(uint*) (shmStart+SHM_loadState);
+    if (sharedMemory->IsAllocator()) {//hold the load mutex until the genome is published; robust, so that it is released if this job dies
+        pthread_mutexattr_t attr;
+        pthread_mutexattr_init(&attr);
+        pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+        pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+        pthread_mutex_init(loadMutex, &attr);
+        pthread_mutexattr_destroy(&attr);
+        pthread_mutex_lock(loadMutex);
+        __atomic_store_n(shmState, SHM_loadLocked, __ATOMIC_RELEASE);
+        P.inOut->logMain << "Created shared memory segment for the genome: key=" << shmKey << ", " << shmSize << " bytes\n" <<flush;
+        return true;
+    };
+
+    //another job loads the genome, it records the sizes and releases the load mutex once it is done
+    uint *shmNG=(uint*) (shmStart+SHM_sizeG);
+    if (__atomic_load_n(shmNG, __ATOMIC_ACQUIRE)==0) {
+        for (uint iwait=0; __atomic_load_n(shmState, __ATOMIC_ACQUIRE)!=SHM_loadLocked; iwait++) {//the creator is about to take the mutex
+            if (iwait==SHM_loadWaitMax*1000) {
+                ostringstream errOut;
+                errOut << "EXITING: waited " << SHM_loadWaitMax << " seconds for another job to load the genome into shared memory, key=" << shmKey << "\n";
+                errOut << "SOLUTION: if the loading job has failed, remove the segment /dev/shm/" << shmKey << " and restart\n" <<flush;
+                exitWithError(errOut.str(),std::cerr, P.inOut->logMain, EXIT_CODE_GENOME_LOADING_WAITED_TOO_LONG, P);
+            };
+            usleep(1000);
+        };
+        P.inOut->logMain << "Another job is loading the genome into shared memory, waiting\n" <<flush;
+        int lockStatus=pthread_mutex_lock(loadMutex);
+        if (lockStatus==0 || lockStatus==EOWNERDEAD) //a dead owner's mutex is released without pthread_mutex_consistent, so that the other waiting jobs fail as well
+            pthread_mutex_unlock(loadMutex);
+        if (__atomic_load_n(shmNG, __ATOMIC_ACQUIRE)==0) {
+            ostringstream errOut;
+            errOut << "EXITING: the job loading the genome into shared memory, key=" << shmKey << ", died before the genome was loaded\n";
+            errOut << "SOLUTION: remove the segment /dev/shm/" << shmKey << " and restart\n" <<flush;
+            exitWithError(errOut.str(),std::cerr, P.inOut->logMain, EXIT_CODE_SHM, P);
+        };
+    };
+    if (*shmNG!=nGenome || *(uint*) (shmStart+SHM_sizeSA)!=nSAbyte) {
+        ostringstream errOut;
+        errOut << "EXITING: fatal error, the genome in shared memory (key=" << shmKey << ") does not match the genome files: nGenome=" << *shmNG << " vs " << nGenome << "\n";
+        errOut << "SOLUTION: remove the old segment /dev/shm/" << shmKey << " once no jobs use it\n" <<flush;
+        exitWithError(errOut.str(),std::cerr, P.inOut->logMain, EXIT_CODE_SHM, P);
+    };
+    P.inOut->logMain << "Found the genome in shared memory: key=" << shmKey << "\n" <<flush;
+    return false;
+};
 
 void Genome::genomeLoad(){//allocate and load Genome
 
@@ -75,6 +311,12 @@ void Genome::genomeLoad(){//allocate and load Genome
     time ( &rawtime );
     *(P.inOut->logStdOut) << timeMonthDayTime(rawtime) << " ..... loading genome\n" <<flush;
 
+    struct stat gDirStat;
+    if (stat(pGe.gDir.c_str(), &gDirStat)==0 && S_ISREG(gDirStat.st_mode)) {//--genomeDir is a bundle written by bundleWrite
+        bundleLoad();
+        return;
+    };
+
     uint L=200,K=6;
 
     Parameters P1;
@@ -158,6 +400,17 @@ void Genome::genomeLoad(){//allocate and load Genome
     pGe.gChrBinNbits=P1.pGe.gChrBinNbits;
     genomeChrBinNbases=1LLU<<pGe.gChrBinNbits;
     pGe.gSAsparseD=P1.pGe.gSAsparseD;
+    P.genomeSAhashCheck();
+
+    //the SA is loaded as it was generated, and re-encoded after loading if another --genomeSAencoding was requested
+    string SAencodingMap = P.parArray.at(pGe.gSAencoding_par)->inputLevel==0 ? P1.pGe.gSAencoding : pGe.gSAencoding;
+    pGe.gSAencoding=P1.pGe.gSAencoding;
+    if (SAencodingMap!=pGe.gSAencoding && pGe.gLoad!="NoSharedMemory") {
+        ostringstream errOut;
+        errOut << "EXITING because of fatal PARAMETERS error: --genomeSAencoding " << SAencodingMap << " is not the encoding of the genome: " << pGe.gSAencoding << ", and it cannot be re-encoded with --genomeLoad " << pGe.gLoad << "\n";
+        errOut << "SOLUTION: re-generate the genome with --genomeSAencoding " << SAencodingMap << ", or use --genomeLoad NoSharedMemory\n" <<flush;
+        exitWithError(errOut.str(),std::cerr, P.inOut->logMain, EXIT_CODE_PARAMETER, P);
+    };
 
     if (P1.pGe.gFileSizes.size()>0)
     {//genomeFileSize was recorded in the genomeParameters file, copy the values to P
@@ -201,25 +454,7 @@ void Genome::genomeLoad(){//allocate and load Genome
     P.inOut->logMain << "Read from SAindex: pGe.gSAindexNbases=" << pGe.gSAindexNbases <<"  nSAi="<< nSAi <<endl;
 
     /////////////////////////////////// at this point all array sizes should be known: calculate packed array lengths
-    if (GstrandBit==0) {//not defined before
-        GstrandBit = (uint) floor(log(nGenome)/log(2))+1;
-        if (GstrandBit<32) GstrandBit=32; //TODO: use simple access function for SA
-    };
-
-
-    GstrandMask = ~(1LLU<<GstrandBit);
-    nSA=(nSAbyte*8)/(GstrandBit+1);
-    SA.defineBits(GstrandBit+1,nSA);
-
-    SAiMarkNbit=GstrandBit+1;
-    SAiMarkAbsentBit=GstrandBit+2;
-
-    SAiMarkNmaskC=1LLU << SAiMarkNbit;
-    SAiMarkNmask=~SAiMarkNmaskC;
-    SAiMarkAbsentMaskC=1LLU << SAiMarkAbsentBit;
-    SAiMarkAbsentMask=~SAiMarkAbsentMaskC;
-
-    SAi.defineBits(GstrandBit+3,nSAi);
+    packedArraysDefine();
 
     P.inOut->logMain << "nGenome=" << nGenome << ";  nSAbyte=" << nSAbyte <<endl<< flush;
     P.inOut->logMain <<"GstrandBit="<<int(GstrandBit)<<"   SA number of indices="<<nSA<<endl<<flush;
@@ -233,51 +468,100 @@ void Genome::genomeLoad(){//allocate and load Genome
         genomeInsertL=genomeScanFastaFiles(P, G, false, *this)-oldlen;
     };
 
-    try {
-        G1=new char[nGenome+L+L];
-        SA.allocateArray();
-        SAi.allocateArray();
-        P.inOut->logMain <<"Shared memory is not used for genomes. Allocated a private copy of the genome.\n"<<flush;
-    } catch (exception & exc) {
+    if (pGe.gLoad!="NoSharedMemory" && genomeInsertL>0) {
         ostringstream errOut;
-        errOut <<"EXITING: fatal error trying to allocate genome arrays, exception thrown: "<<exc.what()<<endl;
-        errOut <<"Possible cause 1: not enough RAM. Check if you have enough RAM " << nGenome+L+L+SA.lengthByte+SAi.lengthByte+2000000000 << " bytes\n";
-        errOut <<"Possible cause 2: not enough virtual memory allowed with ulimit. SOLUTION: run ulimit -v " <<  nGenome+L+L+SA.lengthByte+SAi.lengthByte+2000000000<<endl <<flush;
-        exitWithError(errOut.str(),std::cerr, P.inOut->logMain, EXIT_CODE_MEMORY_ALLOCATION, P);
+        errOut << "EXITING because of fatal PARAMETERS error: --genomeFastaFiles sequences cannot be inserted into a genome loaded with --genomeLoad " << pGe.gLoad << "\n";
+        errOut << "SOLUTION: run STAR with --genomeLoad NoSharedMemory to insert sequences at the mapping stage\n" <<flush;
+        exitWithError(errOut.str(),std::cerr, P.inOut->logMain, EXIT_CODE_PARAMETER, P);
     };
 
+    if (pGe.gNUMA=="Replicate" && pGe.gLoad!="NoSharedMemory") {
+        ostringstream errOut;
+        errOut << "EXITING because of fatal PARAMETERS error: --genomeNUMA Replicate needs a private copy of the genome, it cannot be used with --genomeLoad " << pGe.gLoad << "\n";
+        errOut << "SOLUTION: use --genomeLoad NoSharedMemory, or --genomeNUMA Interleave\n" <<flush;
+        exitWithError(errOut.str(),std::cerr, P.inOut->logMain, EXIT_CODE_PARAMETER, P);
+    };
 
-    G=G1+L;
+    bool loadFiles=true; //false if the genome is mapped, or has been loaded into shared memory by another job
+    if (pGe.gLoad=="Mmap") {//genome files are mapped read-only, and shared with other processes through the page cache
+        loadFiles=false;
+        G=mmapFile("Genome", nGenome, L, L, K-1);
+        G1=G-L;
+        SA.pointArray(mmapFile("SA", nSAbyte, 0, sizeof(uint), 0));
+        SAi.pointArray(mmapFile("SAindex", SAiInBytes+SAi.lengthByte, 0, sizeof(uint), 0)+SAiInBytes);
+    } else if (pGe.gLoad=="NoSharedMemory") {
+        try {
+            if (pGe.gHugePages!="None") {
+                G1=hugePagesAlloc(nGenome+L+L);
+                SA.pointArray(hugePagesAlloc(SA.lengthByte));
+                SAi.pointArray(hugePagesAlloc(SAi.lengthByte));
+            } else {
+                G1=new char[nGenome+L+L];
+                SA.allocateArray();
+                SAi.allocateArray();
+            };
+            P.inOut->logMain <<"Shared memory is not used for genomes. Allocated a private copy of the genome.\n"<<flush;
+        } catch (exception & exc) {
+            ostringstream errOut;
+            errOut <<"EXITING: fatal error trying to allocate genome arrays, exception thrown: "<<exc.what()<<endl;
+            errOut <<"Possible cause 1: not enough RAM. Check if you have enough RAM " << nGenome+L+L+SA.lengthByte+SAi.lengthByte+2000000000 << " bytes\n";
+            errOut <<"Possible cause 2: not enough virtual memory allowed with ulimit. SOLUTION: run ulimit -v " <<  nGenome+L+L+SA.lengthByte+SAi.lengthByte+2000000000<<endl <<flush;
+            exitWithError(errOut.str(),std::cerr, P.inOut->logMain, EXIT_CODE_MEMORY_ALLOCATION, P);
+        };
+    } else if (pGe.gLoad=="LoadAndKeep" || pGe.gLoad=="LoadAndRemove") {
+        loadFiles=sharedMemoryAttach(L);
+    } else {
+        ostringstream errOut;
+        errOut << "EXITING because of fatal PARAMETERS error: --genomeLoad " << pGe.gLoad << " is not supported when loading a genome for alignment\n";
+        errOut << "SOLUTION: use --genomeLoad LoadAndKeep, or LoadAndRemove to remove the shared genome after the last job detaches\n" <<flush;
+        exitWithError(errOut.str(),std::cerr, P.inOut->logMain, EXIT_CODE_PARAMETER, P);
+    };
 
-    //load genome
-    P.inOut->logMain <<"Genome file size: "<<nGenome <<" bytes; state: good=" <<GenomeIn.good()\
-            <<" eof="<<GenomeIn.eof()<<" fail="<<GenomeIn.fail()<<" bad="<<GenomeIn.bad()<<"\n"<<flush;
-    P.inOut->logMain <<"Loading Genome ... " << flush;
-    uint genomeReadBytesN=fstreamReadBig(GenomeIn,G,nGenome);
-    P.inOut->logMain <<"done! state: good=" <<GenomeIn.good()\
-            <<" eof="<<GenomeIn.eof()<<" fail="<<GenomeIn.fail()<<" bad="<<GenomeIn.bad()<<"; loaded "<<genomeReadBytesN<<" bytes\n" << flush;
     GenomeIn.close();
-
-    for (uint ii=0;ii<L;ii++) {// attach a tail with the largest symbol
-        G1[ii]=K-1;
-        G[nGenome+ii]=K-1;
+    SAin.close();
+    SAiIn.close();
+    G=G1+L;
+    if (pGe.gLoad!="Mmap") {
+        numaPlace(L);
+    } else if (pGe.gNUMA!="None") {
+        P.inOut->logMain << "WARNING: --genomeNUMA " << pGe.gNUMA << " is not used with --genomeLoad Mmap, the files are placed by the page cache\n" <<flush;
     };
+    if (loadFiles) {
+        //read the three files concurrently, large files in chunks
+        vector<FileReadRegion> genomeFiles={{pGe.gDir+"/Genome", 0, nGenome, G, 0},
+                                            {pGe.gDir+"/SA", 0, SA.lengthByte, SA.charArray, 0},
+                                            {pGe.gDir+"/SAindex", SAiInBytes, SAi.lengthByte, SAi.charArray, 0}};
+        preadParallel(genomeFiles, GENOME_loadThreadN, GENOME_loadChunkBytes, P);
+
+        for (uint ii=0;ii<L;ii++) {// attach a tail with the largest symbol
+            G1[ii]=K-1;
+            G[nGenome+ii]=K-1;
+        };
 
-    //load SAs
-    P.inOut->logMain <<"SA file size: "<<SA.lengthByte <<" bytes; state: good=" <<SAin.good()\
-            <<" eof="<<SAin.eof()<<" fail="<<SAin.fail()<<" bad="<<SAin.bad()<<"\n"<<flush;
-    P.inOut->logMain <<"Loading SA ... " << flush;
-    genomeReadBytesN=fstreamReadBig(SAin,SA.charArray, SA.lengthByte);
-    P.inOut->logMain <<"done! state: good=" <<SAin.good()\
-            <<" eof="<<SAin.eof()<<" fail="<<SAin.fail()<<" bad="<<SAin.bad()<<"; loaded "<<genomeReadBytesN<<" bytes\n" << flush;
-    SAin.close();
+        if (sharedMemory) {//publish the genome to the jobs waiting for it
+            *(uint*) (shmStart+SHM_sizeSA)=nSAbyte;
+            __atomic_store_n((uint*) (shmStart+SHM_sizeG), nGenome, __ATOMIC_RELEASE);
+            pthread_mutex_unlock((pthread_mutex_t*) (shmStart+SHM_loadMutex));
+        };
+    };
 
-    P.inOut->logMain <<"Loading SAindex ... " << flush;
-    SAiInBytes +=fstreamReadBig(SAiIn,SAi.charArray, SAi.lengthByte);
-    P.inOut->logMain <<"done: "<<SAiInBytes<<" bytes\n" << flush;
+    loadError=checksumsVerify();
+    if (!loadError.empty()) {//the genome is not usable, the caller reports the error
+        P.inOut->logMain << loadError <<flush;
+        P1.inOut = nullptr;
+        return;
+    };
 
+    if (SAencodingMap!=pGe.gSAencoding)
+        SAencode(SAencodingMap);
 
-    SAiIn.close();
+    if (pGe.gHugePages!="None") {
+        if (pGe.gLoad=="Mmap") {
+            P.inOut->logMain << "WARNING: --genomeHugePages " << pGe.gHugePages << " is not used with --genomeLoad Mmap, the files are mapped with normal pages\n" <<flush;
+        } else {
+            hugePagesLog();
+        };
+    };
 
     time ( &rawtime );
     P.inOut->logMain << "Finished ljk loading the genome: " << asctime (localtime ( &rawtime )) <<"\n"<<flush;
@@ -297,6 +581,8 @@ void Genome::genomeLoad(){//allocate and load Genome
     #endif
 
     insertSequences();
+    SAlcpLoad(P1.pGe.gSuffixLengthMax);
+    SAhashBuild(P1.pGe.gSuffixLengthMax);
 
     chrBinFill();
 
@@ -349,7 +635,98 @@ void Genome::genomeLoad(){//allocate and load Genome
         };
     };
 
-    //check and redefine some parameters
+    winBinDefine();
+    numaReplicate();
+
+    // reset P1.inOut here to avoid double-free (of P.inOut later)
+    P1.inOut = nullptr;
+};
+
+void Genome::packedArraysDefine() {//SA and SAi bit widths and lengths, and the masks of SA and SAi values
+    if (GstrandBit==0) {//not defined before
+        GstrandBit = (uint) floor(log(nGenome)/log(2))+1;
+        if (GstrandBit<32) GstrandBit=32; //TODO: use simple access function for SA
+    };
+
+
+    if (SAbits()<(uint) GstrandBit+1) {
+        ostringstream errOut;
+        errOut << "EXITING because of FATAL ERROR: --genomeSAencoding " << pGe.gSAencoding << " cannot store " << (uint) GstrandBit+1 << "-bit suffix array entries\n";
+        errOut << "SOLUTION: use --genomeSAencoding Packed\n" <<flush;
+        exitWithError(errOut.str(),std::cerr, P.inOut->logMain, EXIT_CODE_PARAMETER, P);
+    };
+
+    GstrandMask = ~(1LLU<<GstrandBit);
+    nSA=(nSAbyte*8)/SAbits();
+    SA.defineBits(SAbits(),nSA);
+
+    SAiMarkNbit=GstrandBit+1;
+    SAiMarkAbsentBit=GstrandBit+2;
+
+    SAiMarkNmaskC=1LLU << SAiMarkNbit;
+    SAiMarkNmask=~SAiMarkNmaskC;
+    SAiMarkAbsentMaskC=1LLU << SAiMarkAbsentBit;
+    SAiMarkAbsentMask=~SAiMarkAbsentMaskC;
+
+    SAi.defineBits(GstrandBit+3,nSAi);
+};
+
+void Genome::SAencode(string encoding) {//re-encode the loaded private SA with another --genomeSAencoding
+    PackedArray SA1;
+    pGe.gSAencoding=encoding;
+    SA1.defineBits(SAbits(),nSA);
+    try {
+        if (pGe.gHugePages!="None") {
+            SA1.pointArray(hugePagesAlloc(SA1.lengthByte));
+        } else {
+            SA1.allocateArray();
+        };
+    } catch (exception & exc) {
+        ostringstream errOut;
+        errOut <<"EXITING: fatal error trying to allocate the re-encoded suffix array, exception thrown: "<<exc.what()<<endl;
+        errOut <<"SOLUTION: check if you have enough RAM " << SA.lengthByte+SA1.lengthByte << " bytes, or re-generate the genome with --genomeSAencoding " << encoding <<endl <<flush;
+        exitWithError(errOut.str(),std::cerr, P.inOut->logMain, EXIT_CODE_MEMORY_ALLOCATION, P);
+    };
+
+    if (SA1.wordLength%8==0) {//byte-aligned entries do not share bytes, copy them in parallel
+        uint wordBytes=SA1.wordLength/8;
+        auto encodeRange = [&](uint i1, uint i2) {
+            for (uint ii=i1; ii<i2; ii++) {
+                uint a1=SA[ii];
+                memcpy(SA1.charArray+ii*wordBytes, &a1, wordBytes);
+            };
+        };
+        vector<std::thread> threads;
+        uint iStep=(nSA+GENOME_loadThreadN-1)/GENOME_loadThreadN;
+        for (uint i1=0; i1<nSA; i1+=iStep)
+            threads.emplace_back(encodeRange, i1, min(i1+iStep,nSA));
+        for (auto &t : threads)
+            t.join();
+    } else {
+        for (uint ii=0; ii<nSA; ii++)
+            SA1.writePacked(ii,SA[ii]);
+    };
+
+    if (pGe.gHugePages!="None") {
+        for (auto region=mmapRegions.begin(); region!=mmapRegions.end(); region++) {
+            if (region->first==SA.charArray) {
+                munmap(region->first, region->second);
+                mmapRegions.erase(region);
+                break;
+            };
+        };
+    } else {
+        SA.deallocateArray();
+    };
+    SA=SA1;
+    nSAbyte=SA.lengthByte;
+
+    time_t rawtime;
+    time ( &rawtime );
+    P.inOut->logMain << "Re-encoded the suffix array with --genomeSAencoding " << encoding << ": " << SA.wordLength << " bits per entry, " << nSAbyte << " bytes; " << asctime (localtime ( &rawtime )) <<flush;
+};
+
+void Genome::winBinDefine() {//check and redefine alignment window parameters for this genome
     //max intron size
     if (P.alignIntronMax==0 && P.alignMatesGapMax==0) {
         P.inOut->logMain << "alignIntronMax=alignMatesGapMax=0, the max intron size will be approximately determined by (2^winBinNbits)*winAnchorDistNbins=" \
@@ -381,9 +758,6 @@ void Genome::genomeLoad(){//allocate and load Genome
 
     P.winBinChrNbits=pGe.gChrBinNbits-P.winBinNbits;
     P.winBinN = nGenome/(1LLU << P.winBinNbits)+1;//this may be chenaged later
-
-    // reset P1.inOut here to avoid double-free (of P.inOut later)
-    P1.inOut = nullptr;
 };
 
 //////////////////////////////////////////////////////////////////////////////////////////
@@ -5,17 +5,30 @@
 #include "Parameters.h"
 #include "PackedArray.h"
 #include "Variation.h"
+#include "SharedMemory.h"
+
+#include <memory>
 
 class Genome {
     public:
         char *G, *sigG;
         PackedArray SA,SAinsert,SApass1,SApass2;
         PackedArray SAi;
+        vector<uint8> SAlcp; //common prefix lengths of SA[i-1] and SA[i], capped at SA_lcpMax, with --genomeSAlcp Use. Empty otherwise
+        struct SAhashEntry {
+            uint kmer; //2-bit code of the k-mer, -1 for an empty slot
+            uint iSA; //first SA index of the k-mer <<SA_hashNbits | number of its suffixes -1
+        };
+        vector<SAhashEntry> SAhash; //open addressing table of the --genomeSAhashNbases k-mers in the SAindex ranges of at least --genomeSAhashRangeMin suffixes. Empty if not used
+        uint SAhashShift; //64-log2(SAhash.size())
         Variation *Var;
 
         uint nGenomeInsert, nGenomePass1, nGenomePass2, nSAinsert, nSApass1, nSApass2;
 
         ParametersGenome &pGe;
+        uint hugePagesN, hugePagesTotal; //2 MB pages of G, SA and SAi backed by huge pages, and all of them, with --genomeHugePages
+        vector<int> numaNodes; //NUMA nodes G, SA and SAi are placed on with --genomeNUMA: the interleave set, or the node of each replica. Empty if not placed
+        string loadError; //why genomeLoad stopped with the genome not usable, e.g. failed --genomeChecksums verification. Empty if loaded
 
         //chr parameters
         vector <uint> chrStart, chrLength, chrLengthAll;
@@ -51,17 +64,70 @@ class Genome {
         void freeMemory();
         void genomeLoad();
         void chrBinFill();
+        uint SAbits() const {return pGe.gSAencoding=="Byte40" ? 40 : GstrandBit+1;}; //bits per SA entry
+        char SAbase(uint SAstr, uint ii) const {//base ii of the suffix SAstr as compared to the read: complementary on the reverse strand, >3 for N and spacers
+            if ((SAstr>>GstrandBit) == 0)
+                return G[SAstr+ii];
+            char b=G[nGenome-1-(SAstr & GstrandMask)-ii];
+            return b<4 ? 3-b : b;
+        };
+        bool SAhashFind(uint kmer, uint &iSA1, uint &iSA2) const {//SA range [iSA1,iSA2] of the k-mer, false if it is not in SAhash
+            for (uint ih=(kmer*SA_hashMult)>>SAhashShift; ; ih=(ih+1) & (SAhash.size()-1)) {
+                if (SAhash[ih].kmer==(uint)-1) {
+                    return false;
+                } else if (SAhash[ih].kmer==kmer) {
+                    iSA1=SAhash[ih].iSA>>SA_hashNbits;
+                    iSA2=iSA1+(SAhash[ih].iSA & ((1LLU<<SA_hashNbits)-1));
+                    return true;
+                };
+            };
+        };
         void chrInfoLoad();
 
         void insertSequences();
 
         void genomeGenerate();
 
+        string bundleWrite(string bundleFile); //returns the error, or an empty string if the bundle was written
+        void bundleLoad();
+
+        string checksumsWrite(); //write the checksums of the Genome, SA and SAindex files in pGe.gDir, returns the error or an empty string
+        string SAlcpWrite(); //write the SA common prefix lengths in pGe.gDir, computing them if they were not loaded. Returns the error or an empty string
+
+        const Genome& numaGenome(int node) const; //the replica placed on NUMA node, or this genome
+        int numaNode() const; //NUMA node of this genome or replica with --genomeNUMA Replicate, -1 otherwise
+        static int numaNodeCurrent(); //NUMA node of the calling thread's CPU
+        static bool numaBindThread(int node); //restrict the calling thread to the CPUs of NUMA node
+
+        vector<double> warmUp(uint level, uint threadN) const; //read every page of SAi, level>=1: and G, level>=2: and SA; returns the seconds of each of the 3 phases
+
     private:
         Parameters &P;
         key_t shmKey;
         char *shmStart;
+        shared_ptr<SharedMemory> sharedMemory; //genome segment with --genomeLoad LoadAndKeep/LoadAndRemove
+        vector<shared_ptr<const Genome>> numaReplicas; //copies of this genome on numaNodes[1...] with --genomeNUMA Replicate
         char *G1; //pointer -200 of G
+        vector<pair<char*,uint>> mmapRegions; //start and length of the regions mapped with --genomeLoad Mmap
         uint OpenStream(string name, ifstream & stream, uint size);
+        bool sharedMemoryAttach(uint L);
+        void packedArraysDefine();
+        void winBinDefine();
+        void SAencode(string encoding);
+        string checksumsVerify();
+        void SAlcpLoad(uint suffixLengthMax);
+        void SAlcpCompute();
+        void SAhashBuild(uint suffixLengthMax);
+        char* hugePagesAlloc(uint bytes);
+        void hugePagesAdvise(char *start, uint bytes);
+        void hugePagesLog();
+        char* mmapFile(string name, uint fileBytes, uint headBytes, uint tailBytes, char fill);
+
+        Genome(const Genome &genomeIn) = default; //only used by the replica constructor
+        Genome(const Genome &genomeMain, int numaNode); //replica of genomeMain with G, SA and SAi on numaNode
+        void numaPlace(uint L);
+        void numaReplicate();
+        void numaBind(char *start, uint bytes, int node, bool movePages);
+        char* numaAlloc(uint bytes, int node);
 };
 #endif
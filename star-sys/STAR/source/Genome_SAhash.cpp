@@ -0,0 +1,105 @@
+/*
+ * Hash of k-mers longer than the SAindex prefixes to their SA ranges, --genomeSAhashNbases
+ *
+ * The SAindex gives the SA range of each gSAindexNbases-long prefix, from which maxMappableLength bisects the SA.
+ * The ranges of repetitive prefixes hold thousands of suffixes, so instead their suffixes are grouped by their first
+ * gSAhashNbases bases, and the first SA index and number of suffixes of each k-mer are stored in an open addressing
+ * table, keyed by the 2-bit k-mer code. Only the prefixes with at least gSAhashRangeMin suffixes are hashed: the others
+ * take few bisection steps, and hashing all k-mers would need 16 bytes for most genome positions.
+ */
+#include "Genome.h"
+
+#include <atomic>
+#include <thread>
+
+void Genome::SAhashBuild(uint suffixLengthMax)
+{//in parallel over chunks of the SAindex prefixes, then inserted into the table
+    uint kB=pGe.gSAhashNbases, iB=pGe.gSAindexNbases;
+    if (kB==0)
+        return;
+    if (suffixLengthMax<kB) {//suffixes were sorted only up to this length, the suffixes of a k-mer are not contiguous in the SA
+        P.inOut->logMain << "WARNING: --genomeSAhashNbases " << kB << " is not used: the genome was generated with --genomeSuffixLengthMax " << suffixLengthMax << "\n" <<flush;
+        return;
+    };
+
+    time_t rawtime;
+    time ( &rawtime );
+    P.inOut->logMain << "Hashing the " << kB << "-mers of the SAindex ranges of at least " << pGe.gSAhashRangeMin << " suffixes: " << asctime (localtime ( &rawtime )) <<flush;
+
+    const uint nPrefix=1LLU << (2*iB), chunkN=1LLU << 16;
+    const uint SAiMask=SAiMarkNmask & SAiMarkAbsentMask;
+    vector<vector<SAhashEntry>> threadEntries(GENOME_loadThreadN);
+    std::atomic<uint> nextChunk(0);
+    auto hashChunks = [&](vector<SAhashEntry> &entries) {
+        for (uint p1=(nextChunk++)*chunkN; p1<nPrefix; p1=(nextChunk++)*chunkN) {
+            for (uint ind=p1; ind<min(p1+chunkN,nPrefix); ind++) {
+                uint iSA1=SAi[genomeSAindexStart[iB-1]+ind];
+                if ((iSA1 & SAiMarkAbsentMaskC) != 0)
+                    continue;
+                iSA1 &= SAiMask;
+                uint iSA2 = ind+1<nPrefix ? SAi[genomeSAindexStart[iB-1]+ind+1] & SAiMask : nSA; //end of the range, only used for its size: not recorded after the last prefix present
+                if (iSA2<iSA1+pGe.gSAhashRangeMin)
+                    continue;
+
+                uint kmer0=(uint)-1, iSA0=0; //k-mer of the current group, and its first SA index
+                for (uint iSA=iSA1; ; iSA++) {
+                    uint kmer=(uint)-1;
+                    bool inRange=false; //the suffix starts with the prefix ind
+                    if (iSA<nSA) {
+                        uint SAstr=SA[iSA], ii=0;
+                        for (kmer=0; ii<kB; ii++) {
+                            char b=SAbase(SAstr, ii);
+                            if (b>3)
+                                break;
+                            kmer = (kmer<<2) | (uint) b;
+                        };
+                        inRange = ii>=iB && (kmer>>(2*(ii-iB)))==ind;
+                        if (ii<kB) //N or spacer in the k-mer, the suffix is not in any group
+                            kmer=(uint)-1;
+                    };
+                    if (kmer!=kmer0) {
+                        if (kmer0!=(uint)-1 && iSA-iSA0 <= (1LLU<<SA_hashNbits))
+                            entries.push_back({kmer0, (iSA0<<SA_hashNbits) | (iSA-iSA0-1)});
+                        kmer0=kmer;
+                        iSA0=iSA;
+                    };
+                    if (!inRange)
+                        break;
+                };
+            };
+        };
+    };
+
+    vector<std::thread> threads;
+    for (uint it=1; it<GENOME_loadThreadN; it++)
+        threads.emplace_back(hashChunks, std::ref(threadEntries[it]));
+    hashChunks(threadEntries[0]);
+    for (auto &t : threads)
+        t.join();
+
+    uint nEntries=0;
+    for (auto &entries : threadEntries)
+        nEntries+=entries.size();
+    if (nEntries>0) {
+        uint hashBits=1;
+        while ((1LLU<<hashBits) < 2*nEntries)
+            hashBits++;
+        SAhashShift=64-hashBits;
+        SAhash.assign(1LLU<<hashBits, {(uint)-1, 0});
+        for (auto &entries : threadEntries) {
+            for (auto &e : entries) {
+                uint ih=(e.kmer*SA_hashMult)>>SAhashShift;
+                while (SAhash[ih].kmer!=(uint)-1)
+                    ih=(ih+1) & (SAhash.size()-1);
+                SAhash[ih]=e;
+            };
+            vector<SAhashEntry>().swap(entries);
+        };
+    };
+
+    if (!numaNodes.empty() && !SAhash.empty())
+        numaBind((char*) SAhash.data(), SAhash.size()*sizeof(SAhashEntry), pGe.gNUMA=="Interleave" ? -1 : numaNodes[0], true);
+
+    time ( &rawtime );
+    P.inOut->logMain << "Hashed " << nEntries << " " << kB << "-mers into " << SAhash.size() << " slots, " << SAhash.size()*sizeof(SAhashEntry) << " bytes: " << asctime (localtime ( &rawtime )) <<flush;
+};
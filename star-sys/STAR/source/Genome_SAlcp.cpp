@@ -0,0 +1,113 @@
+/*
+ * Longest common prefixes of neighbouring suffix array entries, --genomeSAlcp
+ *
+ * SAlcp[iSA] is the number of bases the suffixes SA[iSA-1] and SA[iSA] share, up to SA_lcpMax: SA_lcpMax means
+ * SA_lcpMax or more. A common prefix ends at the first N or spacer, as the read pieces of the seed search have none.
+ * maxMappableLength and findMultRange take the match length of the read to an SA entry from its neighbours with
+ * these, instead of comparing the read to the genome. The array is written to GENOME_SAlcpFile in the genome
+ * directory, and loaded from it if it is there and matches the SA, otherwise computed while loading the genome
+ */
+#include "Genome.h"
+#include "ErrorWarning.h"
+#include "streamFuns.h"
+
+#include <atomic>
+#include <thread>
+
+#define GENOME_SAlcpFile "SAlcp"
+
+void Genome::SAlcpCompute()
+{//in parallel over chunks of the SA
+    time_t rawtime;
+    time ( &rawtime );
+    P.inOut->logMain << "Computing the suffix array LCPs: " << asctime (localtime ( &rawtime )) <<flush;
+
+    SAlcp.resize(nSA);
+    const uint chunkN=GENOME_loadChunkBytes;
+    std::atomic<uint> nextChunk(0);
+    auto computeChunks = [&]() {
+        for (uint i1=(nextChunk++)*chunkN; i1<nSA; i1=(nextChunk++)*chunkN) {
+            uint SAprev = i1==0 ? 0 : SA[i1-1];
+            for (uint iSA=i1; iSA<min(i1+chunkN,nSA); iSA++) {
+                uint SAstr=SA[iSA];
+                uint ii=0;
+                if (iSA>0) {
+                    for (; ii<SA_lcpMax; ii++) {
+                        char b=SAbase(SAstr, ii);
+                        if (b>3 || b!=SAbase(SAprev, ii))
+                            break;
+                    };
+                };
+                SAlcp[iSA]=(uint8) ii;
+                SAprev=SAstr;
+            };
+        };
+    };
+
+    vector<std::thread> threads;
+    for (uint it=1; it<GENOME_loadThreadN; it++)
+        threads.emplace_back(computeChunks);
+    computeChunks();
+    for (auto &t : threads)
+        t.join();
+
+    time ( &rawtime );
+    P.inOut->logMain << "Computed the suffix array LCPs: " << asctime (localtime ( &rawtime )) <<flush;
+};
+
+void Genome::SAlcpLoad(uint suffixLengthMax)
+{//from the genome directory if the file is there and matches the SA, otherwise computed
+    if (pGe.gSAlcp=="None")
+        return;
+    if (suffixLengthMax<SA_lcpMax) {//suffixes were sorted only up to this length, longer common prefixes are not contiguous in the SA
+        P.inOut->logMain << "WARNING: --genomeSAlcp " << pGe.gSAlcp << " is not used: the genome was generated with --genomeSuffixLengthMax " << suffixLengthMax << "\n" <<flush;
+        return;
+    };
+
+    string lcpFile=pGe.gDir+"/" GENOME_SAlcpFile;
+    ifstream lcpIn(lcpFile.c_str(), ios::binary);
+    if (genomeInsertL>0) {
+        P.inOut->logMain << "--genomeSAlcp " << pGe.gSAlcp << ": sequences were inserted into the genome, the LCPs are computed rather than loaded from " << lcpFile << "\n" <<flush;
+        SAlcpCompute();
+    } else if (lcpIn.good()) {
+        lcpIn.seekg(0, ios::end);
+        uint lcpBytes=lcpIn.tellg();
+        lcpIn.seekg(0, ios::beg);
+        SAlcp.resize(nSA);
+        if (lcpBytes!=nSA || fstreamReadBig(lcpIn, (char*) SAlcp.data(), nSA)!=nSA) {//left from another genome, or truncated
+            P.inOut->logMain << "WARNING: the suffix array LCP file " << lcpFile << " has " << lcpBytes << " entries, while the suffix array has " << nSA \
+                             << ". The LCPs are computed instead, write them again to replace the file\n" <<flush;
+            SAlcpCompute();
+        } else {
+            P.inOut->logMain << "Loaded the suffix array LCPs from " << lcpFile << "\n" <<flush;
+        };
+    } else {
+        SAlcpCompute();
+    };
+
+    if (!numaNodes.empty())
+        numaBind((char*) SAlcp.data(), SAlcp.size(), pGe.gNUMA=="Interleave" ? -1 : numaNodes[0], true);
+};
+
+string Genome::SAlcpWrite()
+{//into the genome directory, under a temporary name renamed when complete. Returns the error or an empty string
+    if (SAlcp.empty())
+        SAlcpCompute();
+
+    string lcpFile=pGe.gDir+"/" GENOME_SAlcpFile;
+    string tmpFile=lcpFile+".tmp";
+    ofstream lcpOut(tmpFile.c_str(), ios::binary | ios::trunc);
+    fstreamWriteChunks(lcpOut, (char*) SAlcp.data(), SAlcp.size());
+    lcpOut.close();
+    if (lcpOut.fail() || rename(tmpFile.c_str(), lcpFile.c_str())!=0) {
+        int errnoWrite=errno;
+        remove(tmpFile.c_str());
+        ostringstream errOut;
+        errOut << "*OUTPUT FILE* error: could not write the suffix array LCPs " << lcpFile << ": " << strerror(errnoWrite) << "\n";
+        errOut << "SOLUTION: check that you have write permission for the genome directory, and there is enough space on the disk\n";
+        P.inOut->logMain << errOut.str() <<flush;
+        return errOut.str();
+    };
+    P.inOut->logMain << "Wrote the suffix array LCPs " << lcpFile << "\n" <<flush;
+    return "";
+};
@@ -0,0 +1,238 @@
+/*
+ * orbit index bundle: the loaded genome in a single file, which is mapped instead of parsed
+ *
+ * layout: a BundleHeader, then sections at BUNDLE_align-aligned offsets. Numbers are native 64-bit
+ * integers, chromosome names are 0-terminated strings, and the G1 section is the genome with its
+ * padding filled, so that all arrays are used in place
+ */
+#include "Genome.h"
+#include "ErrorWarning.h"
+#include "streamFuns.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define BUNDLE_magic "ORBITIDX"
+#define BUNDLE_version 2
+#define BUNDLE_align 4096
+
+enum BundleSection {bChrName, bChrStart, bChrLength, bChrBin, bSAindexStart, \
+                    bSjdbStart, bSjdbEnd, bSjDstart, bSjAstart, bSjdbMotif, bSjdbShiftLeft, bSjdbShiftRight, bSjdbStrand, \
+                    bSAi, bSA, bG1, BUNDLE_sectionN};
+
+struct BundleHeader {
+    char magic[8];
+    uint64 version, headerBytes; //headerBytes guards against a changed layout
+    uint64 nGenome, nSAbyte, nSAi, nChrReal, sjdbN, genomePadding;
+    uint64 GstrandBit, gSAindexNbases, gChrBinNbits, gSAsparseD, sjdbOverhang, SAbits;
+    uint64 sectionStart[BUNDLE_sectionN], sectionBytes[BUNDLE_sectionN];
+};
+
+string Genome::bundleWrite(string bundleFile)
+{//write the loaded genome as a bundle. The file is written under a temporary name and renamed, so that jobs never map a partial bundle. A failure is not fatal, the caller reports it
+    string chrNames;
+    for (uint ii=0; ii<nChrReal; ii++)
+        chrNames+=chrName[ii]+'\0';
+
+    vector<pair<const char*,uint64>> sections(BUNDLE_sectionN);
+    sections[bChrName]={chrNames.data(), chrNames.size()};
+    sections[bChrStart]={(char*) chrStart.data(), (nChrReal+1)*sizeof(uint)};
+    sections[bChrLength]={(char*) chrLength.data(), nChrReal*sizeof(uint)};
+    sections[bChrBin]={(char*) chrBin.data(), chrBin.size()*sizeof(uint)};
+    sections[bSAindexStart]={(char*) genomeSAindexStart.data(), genomeSAindexStart.size()*sizeof(uint)};
+    sections[bSjdbStart]={(char*) sjdbStart.data(), sjdbN*sizeof(uint)};
+    sections[bSjdbEnd]={(char*) sjdbEnd.data(), sjdbN*sizeof(uint)};
+    sections[bSjDstart]={(char*) sjDstart.data(), sjdbN*sizeof(uint)};
+    sections[bSjAstart]={(char*) sjAstart.data(), sjdbN*sizeof(uint)};
+    sections[bSjdbMotif]={(char*) sjdbMotif.data(), sjdbN};
+    sections[bSjdbShiftLeft]={(char*) sjdbShiftLeft.data(), sjdbN};
+    sections[bSjdbShiftRight]={(char*) sjdbShiftRight.data(), sjdbN};
+    sections[bSjdbStrand]={(char*) sjdbStrand.data(), sjdbN};
+    sections[bSAi]={SAi.charArray, SAi.lengthByte};
+    sections[bSA]={SA.charArray, SA.lengthByte};
+    sections[bG1]={G1, nGenome+2*(G-G1)};
+
+    BundleHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, BUNDLE_magic, sizeof(header.magic));
+    header.version=BUNDLE_version;
+    header.headerBytes=sizeof(header);
+    header.nGenome=nGenome;
+    header.nSAbyte=nSAbyte;
+    header.nSAi=nSAi;
+    header.nChrReal=nChrReal;
+    header.sjdbN=sjdbN;
+    header.genomePadding=G-G1;
+    header.GstrandBit=GstrandBit;
+    header.gSAindexNbases=pGe.gSAindexNbases;
+    header.gChrBinNbits=pGe.gChrBinNbits;
+    header.gSAsparseD=pGe.gSAsparseD;
+    header.sjdbOverhang=pGe.sjdbOverhang;
+    header.SAbits=SA.wordLength;
+    uint64 fileBytes=sizeof(header);
+    for (uint ii=0; ii<BUNDLE_sectionN; ii++) {
+        header.sectionStart[ii]=(fileBytes+BUNDLE_align-1)/BUNDLE_align*BUNDLE_align;
+        header.sectionBytes[ii]=sections[ii].second;
+        fileBytes=header.sectionStart[ii]+header.sectionBytes[ii];
+    };
+
+    string tmpFile=bundleFile+".tmp";
+    ofstream bundleOut(tmpFile.c_str(), ios::binary | ios::trunc);
+    bundleOut.write((char*) &header, sizeof(header));
+    for (uint ii=0; ii<BUNDLE_sectionN && !bundleOut.fail(); ii++) {
+        bundleOut.seekp(header.sectionStart[ii]);
+        fstreamWriteChunks(bundleOut, sections[ii].first, sections[ii].second);
+    };
+    bundleOut.close();
+    if (bundleOut.fail() || rename(tmpFile.c_str(), bundleFile.c_str())!=0) {
+        int errnoWrite=errno;
+        remove(tmpFile.c_str());
+        ostringstream errOut;
+        errOut << "*OUTPUT FILE* error: could not write the genome bundle " << bundleFile << ": " << strerror(errnoWrite) << "\n";
+        errOut << "SOLUTION: check that the path exists, you have write permission for it, and there is enough space on the disk\n";
+        P.inOut->logMain << errOut.str() <<flush;
+        return errOut.str();
+    };
+    P.inOut->logMain << "Wrote genome bundle " << bundleFile << ": " << fileBytes << " bytes\n" <<flush;
+    return "";
+};
+
+void Genome::bundleLoad()
+{//map a bundle written by bundleWrite, and point the genome arrays into it. Parameters that need the genome directory stop the load with loadError
+    time_t rawtime;
+    ostringstream errOut;
+    if (pGe.gLoad!="NoSharedMemory" && pGe.gLoad!="Mmap") {
+        errOut << "EXITING because of fatal PARAMETERS error: a genome bundle is always mapped, it cannot be used with --genomeLoad " << pGe.gLoad << "\n";
+        errOut << "SOLUTION: use --genomeLoad NoSharedMemory or Mmap, or point --genomeDir to the genome directory\n" <<flush;
+        exitWithError(errOut.str(),std::cerr, P.inOut->logMain, EXIT_CODE_PARAMETER, P);
+    };
+    if (pGe.gFastaFiles.at(0)!="-" || P.sjdbInsert.yes) {
+        errOut << "EXITING because of fatal PARAMETERS error: sequences and junctions cannot be inserted into a genome bundle at the mapping stage\n";
+        errOut << "SOLUTION: point --genomeDir to the genome directory, or write a new bundle after inserting them\n" <<flush;
+        exitWithError(errOut.str(),std::cerr, P.inOut->logMain, EXIT_CODE_PARAMETER, P);
+    };
+    ostringstream unusable; //the bundle is mapped as written, without the files or the processing these need
+    if (pGe.gChecksums!="None")
+        unusable << " --genomeChecksums " << pGe.gChecksums;
+    if (pGe.gSAlcp!="None")
+        unusable << " --genomeSAlcp " << pGe.gSAlcp;
+    if (pGe.gSAhashNbases>0)
+        unusable << " --genomeSAhashNbases " << pGe.gSAhashNbases;
+    if (pGe.gNUMA!="None")
+        unusable << " --genomeNUMA " << pGe.gNUMA;
+    if (!unusable.str().empty()) {
+        errOut << "FATAL PARAMETERS error:" << unusable.str() << " cannot be used with a genome bundle: " << pGe.gDir << "\n";
+        errOut << "SOLUTION: point --genomeDir to the genome directory, or do not use these parameters with a bundle\n";
+        loadError=errOut.str();
+        P.inOut->logMain << loadError <<flush;
+        return;
+    };
+
+    int fd=open(pGe.gDir.c_str(), O_RDONLY);
+    struct stat fileStat;
+    BundleHeader header;
+    if (fd<0 || fstat(fd,&fileStat)!=0 || pread(fd, &header, sizeof(header), 0)!=sizeof(header) \
+        || memcmp(header.magic, BUNDLE_magic, sizeof(header.magic))!=0) {
+        errOut << "EXITING because of FATAL ERROR: could not read the genome bundle, or it is not a bundle: " << pGe.gDir << "\n";
+        errOut << "SOLUTION: check that --genomeDir is a genome directory, or a bundle written by orbit\n" <<flush;
+        exitWithError(errOut.str(),std::cerr, P.inOut->logMain, EXIT_CODE_GENOME_FILES, P);
+    };
+    if (header.version!=BUNDLE_version || header.headerBytes!=sizeof(header) \
+        || header.sectionStart[bG1]+header.sectionBytes[bG1]>(uint64) fileStat.st_size) {
+        errOut << "EXITING because of FATAL ERROR: genome bundle version " << header.version << " is incompatible with version " << BUNDLE_version << ", or the bundle is truncated: " << pGe.gDir << "\n";
+        errOut << "SOLUTION: write the bundle again from the genome directory\n" <<flush;
+        exitWithError(errOut.str(),std::cerr, P.inOut->logMain, EXIT_CODE_GENOME_FILES, P);
+    };
+
+    int mapFlags=MAP_PRIVATE;
+    #ifdef MAP_POPULATE
+    if (pGe.gMmapAdvice=="Populate") mapFlags|=MAP_POPULATE;
+    #endif
+    char *bundleStart=(char*) mmap(NULL, fileStat.st_size, PROT_READ, mapFlags, fd, 0);
+    if (bundleStart==MAP_FAILED) {
+        errOut <<"EXITING: fatal error trying to map the genome bundle " << pGe.gDir << ": " << strerror(errno) <<"\n";
+        errOut <<"Possible cause: not enough virtual memory allowed with ulimit. SOLUTION: run ulimit -v " <<  fileStat.st_size+2000000000<<endl <<flush;
+        exitWithError(errOut.str(),std::cerr, P.inOut->logMain, EXIT_CODE_MEMORY_ALLOCATION, P);
+    };
+    close(fd);
+    mmapRegions.push_back({bundleStart, (uint) fileStat.st_size});
+    if (pGe.gMmapAdvice=="WillNeed") {
+        madvise(bundleStart, fileStat.st_size, MADV_WILLNEED);
+    } else if (pGe.gMmapAdvice=="Random") {
+        madvise(bundleStart, fileStat.st_size, MADV_RANDOM);
+    };
+
+    auto section=[&](BundleSection is) {return bundleStart+header.sectionStart[is];};
+    auto sectionUint=[&](BundleSection is) {return (uint*) section(is);};
+    auto sectionN=[&](BundleSection is) {return header.sectionBytes[is]/sizeof(uint);};
+
+    //genome parameters, as loaded from the genome directory
+    nGenome=header.nGenome;
+    nSAbyte=header.nSAbyte;
+    nSAi=header.nSAi;
+    GstrandBit=header.GstrandBit;
+    pGe.gSAindexNbases=header.gSAindexNbases;
+    pGe.gChrBinNbits=header.gChrBinNbits;
+    genomeChrBinNbases=1LLU<<pGe.gChrBinNbits;
+    pGe.gSAsparseD=header.gSAsparseD;
+    string SAencodingBundle = header.SAbits==40 ? "Byte40" : "Packed";
+    if (P.parArray.at(pGe.gSAencoding_par)->inputLevel>0 && SAbits()!=header.SAbits) {
+        errOut << "EXITING because of fatal PARAMETERS error: --genomeSAencoding " << pGe.gSAencoding << " is not the encoding of the genome bundle: " << SAencodingBundle << "\n";
+        errOut << "SOLUTION: write the bundle from a genome loaded with --genomeSAencoding " << pGe.gSAencoding << "\n" <<flush;
+        exitWithError(errOut.str(),std::cerr, P.inOut->logMain, EXIT_CODE_PARAMETER, P);
+    };
+    pGe.gSAencoding=SAencodingBundle;
+    if (P.parArray.at(pGe.sjdbOverhang_par)->inputLevel==0) {
+        pGe.sjdbOverhang=header.sjdbOverhang;
+    } else if (header.sjdbN>0 && pGe.sjdbOverhang!=header.sjdbOverhang) {
+        errOut << "EXITING because of fatal PARAMETERS error: present --sjdbOverhang="<<pGe.sjdbOverhang << " is not equal to the value at the genome generation step ="<< header.sjdbOverhang << "\n";
+        errOut << "SOLUTION: \n" <<flush;
+        exitWithError(errOut.str(),std::cerr, P.inOut->logMain, EXIT_CODE_GENOME_FILES, P);
+    };
+    sjdbOverhang = pGe.sjdbOverhang;
+    sjdbLength = pGe.sjdbOverhang==0 ? 0 : pGe.sjdbOverhang*2+1;
+
+    //chromosomes
+    nChrReal=header.nChrReal;
+    for (const char *name=section(bChrName); name<section(bChrName)+header.sectionBytes[bChrName]; name+=strlen(name)+1)
+        chrName.push_back(name);
+    chrStart.assign(sectionUint(bChrStart), sectionUint(bChrStart)+sectionN(bChrStart));
+    chrLength.assign(sectionUint(bChrLength), sectionUint(bChrLength)+sectionN(bChrLength));
+    chrBin.assign(sectionUint(bChrBin), sectionUint(bChrBin)+sectionN(bChrBin));
+    for (uint ii=0; ii<nChrReal; ii++)
+        chrNameIndex[chrName[ii]]=ii;
+    genomeInsertL=0;
+    genomeInsertChrIndFirst=nChrReal;
+
+    //splice junctions database
+    sjdbN=header.sjdbN;
+    sjChrStart=nChrReal;
+    sjGstart= sjdbN==0 ? chrStart[nChrReal]+1 : chrStart[sjChrStart];
+    sjdbStart.assign(sectionUint(bSjdbStart), sectionUint(bSjdbStart)+sjdbN);
+    sjdbEnd.assign(sectionUint(bSjdbEnd), sectionUint(bSjdbEnd)+sjdbN);
+    sjDstart.assign(sectionUint(bSjDstart), sectionUint(bSjDstart)+sjdbN);
+    sjAstart.assign(sectionUint(bSjAstart), sectionUint(bSjAstart)+sjdbN);
+    sjdbMotif.assign(section(bSjdbMotif), section(bSjdbMotif)+sjdbN);
+    sjdbShiftLeft.assign(section(bSjdbShiftLeft), section(bSjdbShiftLeft)+sjdbN);
+    sjdbShiftRight.assign(section(bSjdbShiftRight), section(bSjdbShiftRight)+sjdbN);
+    sjdbStrand.assign(section(bSjdbStrand), section(bSjdbStrand)+sjdbN);
+
+    //genome and suffix arrays are used in place
+    genomeSAindexStart.assign(sectionUint(bSAindexStart), sectionUint(bSAindexStart)+sectionN(bSAindexStart));
+    packedArraysDefine();
+    G1=section(bG1);
+    G=G1+header.genomePadding;
+    SA.pointArray(section(bSA));
+    SAi.pointArray(section(bSAi));
+
+    if (pGe.gHugePages!="None")
+        P.inOut->logMain << "WARNING: --genomeHugePages " << pGe.gHugePages << " is not used with a genome bundle, it is mapped with normal pages\n" <<flush;
+
+    time ( &rawtime );
+    P.inOut->logMain << "Mapped genome bundle " << pGe.gDir << ": nGenome=" << nGenome << ", nSAbyte=" << nSAbyte << ", " << nChrReal << " chromosomes, " \
+                     << sjdbN << " junctions; " << asctime (localtime ( &rawtime )) <<flush;
+
+    winBinDefine();
+};
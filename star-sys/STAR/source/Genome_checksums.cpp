@@ -0,0 +1,194 @@
+/*
+ * Integrity checksums of the genome index files, --genomeChecksums
+ *
+ * GENOME_checksumsFile in the genome directory lists, for each of Genome, SA and SAindex, the file size
+ * and the xxHash64 of each GENOME_checksumBlockBytes block. They are written from the files on disk, and
+ * verified on the loaded arrays, before they are modified, with one thread per block. Neither a write nor a
+ * verification failure is fatal: checksumsWrite returns its error, genomeLoad records it in loadError, for the
+ * caller to report
+ */
+#include "Genome.h"
+#include "ErrorWarning.h"
+#include "XXH64.h"
+
+#include <atomic>
+#include <functional>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define GENOME_checksumsFile "checksums.txt"
+#define GENOME_checksumsFiles {"Genome", "SA", "SAindex"}
+
+typedef vector<pair<const char*,uint>> ChecksumPieces; //the consecutive pieces of memory that hold a file
+
+static vector<uint64> checksumBlocks(uint fileBytes, std::function<void(uint,uint,XXH64&)> hashRange)
+{//hash of each block of [0,fileBytes), hashRange(start,bytes,hash) adds a range to the hash of its block
+    vector<uint64> hashes((fileBytes+GENOME_checksumBlockBytes-1)/GENOME_checksumBlockBytes);
+    std::atomic<uint> nextBlock(0);
+    auto hashBlocks = [&]() {
+        for (uint ib=nextBlock++; ib<hashes.size(); ib=nextBlock++) {
+            XXH64 hash;
+            uint b1=ib*GENOME_checksumBlockBytes;
+            hashRange(b1, min(b1+GENOME_checksumBlockBytes,fileBytes)-b1, hash);
+            hashes[ib]=hash.digest();
+        };
+    };
+
+    vector<std::thread> threads;
+    for (uint it=1; it<min((uint) GENOME_loadThreadN, (uint) hashes.size()); it++)
+        threads.emplace_back(hashBlocks);
+    hashBlocks();
+    for (auto &t : threads)
+        t.join();
+    return hashes;
+};
+
+string Genome::checksumsWrite()
+{//checksums of the index files on disk. The file is written under a temporary name and renamed. Returns the error or an empty string
+    string checksumsFile=pGe.gDir+"/" GENOME_checksumsFile;
+    string tmpFile=checksumsFile+".tmp";
+    ofstream checksumsOut(tmpFile.c_str(), ios::trunc);
+    checksumsOut << "xxHash64\t" << GENOME_checksumBlockBytes << "\n";
+
+    for (string name : GENOME_checksumsFiles) {
+        string fileName=pGe.gDir+"/"+name;
+        int fd=open(fileName.c_str(), O_RDONLY);
+        struct stat fileStat;
+        if (fd<0 || fstat(fd,&fileStat)!=0) {
+            ostringstream errOut;
+            errOut << "FATAL ERROR: could not open genome file " << fileName << " to compute its checksums: " << strerror(errno) << "\n";
+            errOut << "SOLUTION: check that the path to genome files, specified in --genomeDir is correct and the files are present, and have user read permissions\n";
+            if (fd>=0)
+                close(fd);
+            checksumsOut.close();
+            remove(tmpFile.c_str());
+            P.inOut->logMain << errOut.str() <<flush;
+            return errOut.str();
+        };
+
+        std::atomic<bool> readFailed(false);
+        vector<uint64> hashes=checksumBlocks(fileStat.st_size, [&](uint start, uint bytes, XXH64 &hash) {
+            vector<char> buffer(min(bytes, (uint) 1<<20)); //the block is read in pieces, to keep GENOME_loadThreadN buffers small
+            for (uint b1=start; b1<start+bytes; b1+=buffer.size()) {
+                uint n=min((uint) buffer.size(), start+bytes-b1);
+                if (pread(fd, buffer.data(), n, b1)!=(ssize_t) n) {
+                    readFailed=true;
+                    return;
+                };
+                hash.update(buffer.data(), n);
+            };
+        });
+        close(fd);
+        if (readFailed) {
+            ostringstream errOut;
+            errOut << "FATAL ERROR: could not read genome file " << fileName << " to compute its checksums\n";
+            errOut << "SOLUTION: check that the file is not being modified, and that the disk is readable\n";
+            checksumsOut.close();
+            remove(tmpFile.c_str());
+            P.inOut->logMain << errOut.str() <<flush;
+            return errOut.str();
+        };
+
+        checksumsOut << name << "\t" << fileStat.st_size;
+        for (auto h : hashes)
+            checksumsOut << "\t" << hex << h << dec;
+        checksumsOut << "\n";
+    };
+
+    checksumsOut.close();
+    if (checksumsOut.fail() || rename(tmpFile.c_str(), checksumsFile.c_str())!=0) {
+        int errnoWrite=errno;
+        remove(tmpFile.c_str());
+        ostringstream errOut;
+        errOut << "*OUTPUT FILE* error: could not write the genome checksums " << checksumsFile << ": " << strerror(errnoWrite) << "\n";
+        errOut << "SOLUTION: check that you have write permission for the genome directory, and there is enough space on the disk\n";
+        P.inOut->logMain << errOut.str() <<flush;
+        return errOut.str();
+    };
+    P.inOut->logMain << "Wrote genome checksums " << checksumsFile << "\n" <<flush;
+    return "";
+};
+
+string Genome::checksumsVerify()
+{//verify the loaded Genome, SA and SAindex against the checksums of their files, returns the error or an empty string
+    if (pGe.gChecksums=="None")
+        return "";
+
+    time_t rawtime;
+    time ( &rawtime );
+    P.inOut->logMain << "Verifying the genome checksums: " << asctime (localtime ( &rawtime )) <<flush;
+
+    string checksumsFile=pGe.gDir+"/" GENOME_checksumsFile;
+    ifstream checksumsIn(checksumsFile.c_str());
+    string hashName;
+    uint blockBytes=0;
+    checksumsIn >> hashName >> blockBytes;
+    if (checksumsIn.fail() || hashName!="xxHash64" || blockBytes!=GENOME_checksumBlockBytes) {
+        ostringstream errOut;
+        errOut << "FATAL ERROR: could not read the genome checksums " << checksumsFile << ", needed by --genomeChecksums " << pGe.gChecksums << "\n";
+        errOut << "SOLUTION: write the checksums of the genome files once they are known to be correct, or use --genomeChecksums None\n";
+        return errOut.str();
+    };
+
+    map<string,ChecksumPieces> filePieces;
+    filePieces["Genome"]={{G, nGenome}};
+    filePieces["SA"]={{SA.charArray, nSAbyte}};
+    filePieces["SAindex"]={{(const char*) &pGe.gSAindexNbases, sizeof(pGe.gSAindexNbases)},
+                          {(const char*) genomeSAindexStart.data(), sizeof(genomeSAindexStart[0])*genomeSAindexStart.size()},
+                          {SAi.charArray, SAi.lengthByte}};
+
+    for (string name : GENOME_checksumsFiles) {
+        string fileName;
+        uint fileBytes=0;
+        checksumsIn >> fileName >> fileBytes;
+        string hashLine;
+        getline(checksumsIn, hashLine);
+        istringstream hashStream(hashLine);
+        vector<uint64> hashesFile;
+        uint64 h;
+        while (hashStream >> hex >> h)
+            hashesFile.push_back(h);
+
+        ChecksumPieces &pieces=filePieces[name];
+        uint piecesBytes=0;
+        for (auto &piece : pieces)
+            piecesBytes+=piece.second;
+
+        struct stat fileStat;
+        if (fileName!=name || hashesFile.size()!=(fileBytes+GENOME_checksumBlockBytes-1)/GENOME_checksumBlockBytes
+                || stat((pGe.gDir+"/"+name).c_str(), &fileStat)!=0 || (uint) fileStat.st_size!=fileBytes || piecesBytes!=fileBytes) {
+            ostringstream errOut;
+            errOut << "FATAL ERROR: the size of genome file " << pGe.gDir << "/" << name << " does not match its checksums in " << checksumsFile << "\n";
+            errOut << "SOLUTION: the genome files are truncated or were replaced, re-generate the genome or copy it again\n";
+            return errOut.str();
+        };
+
+        vector<uint64> hashes=checksumBlocks(fileBytes, [&](uint start, uint bytes, XXH64 &hash) {
+            uint p1=0;
+            for (auto &piece : pieces) {//the parts of the pieces in [start,start+bytes)
+                uint p2=p1+piece.second;
+                if (p2>start && p1<start+bytes) {
+                    uint b1=max(p1,start), b2=min(p2,start+bytes);
+                    hash.update(piece.first+b1-p1, b2-b1);
+                };
+                p1=p2;
+            };
+        });
+
+        for (uint ib=0; ib<hashes.size(); ib++) {
+            if (hashes[ib]!=hashesFile[ib]) {
+                ostringstream errOut;
+                errOut << "FATAL ERROR: genome file " << pGe.gDir << "/" << name << " is corrupted: the checksum of bytes "
+                       << ib*GENOME_checksumBlockBytes << " to " << min((ib+1)*GENOME_checksumBlockBytes,fileBytes) << " does not match " << checksumsFile << "\n";
+                errOut << "SOLUTION: re-generate the genome or copy it again\n";
+                return errOut.str();
+            };
+        };
+    };
+
+    time ( &rawtime );
+    P.inOut->logMain << "Verified the genome checksums: " << asctime (localtime ( &rawtime )) <<flush;
+    return "";
+};
@@ -260,11 +260,11 @@ void Genome::genomeGenerate() {
     P.inOut->logMain << "GstrandBit=" << int(GstrandBit) <<"\n";
 
     GstrandMask = ~(1LLU<<GstrandBit);
-    SA.defineBits(GstrandBit+1,nSA);
+    SA.defineBits(SAbits(),nSA);
     if (P.sjdbInsert.yes)     {//reserve space for junction insertion
-        SApass1.defineBits(GstrandBit+1,nSA+2*P.limitSjdbInsertNsj*sjdbLength);//TODO: this allocation is wasteful, get a better estimate of the number of junctions
+        SApass1.defineBits(SAbits(),nSA+2*P.limitSjdbInsertNsj*sjdbLength);//TODO: this allocation is wasteful, get a better estimate of the number of junctions
     } else {//same as SA
-        SApass1.defineBits(GstrandBit+1,nSA);
+        SApass1.defineBits(SAbits(),nSA);
     };
 
     P.inOut->logMain  << "Number of SA indices: "<< nSA << "\n"<<flush;
@@ -512,6 +512,8 @@ void Genome::genomeGenerate() {
 
     SApass1.deallocateArray();
 
+    checksumsWrite();
+
     time(&rawTime);
     timeString=asctime(localtime ( &rawTime ));
     timeString.erase(timeString.end()-1,timeString.end());
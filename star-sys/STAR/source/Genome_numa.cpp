@@ -0,0 +1,177 @@
+/*
+ * NUMA placement of the genome arrays, --genomeNUMA
+ *
+ * Interleave: the pages of G, SA and SAi are spread over all nodes with memory, so that every thread
+ * sees the same average latency. Replicate: the genome is loaded on the first node and copied to each
+ * other node, and each aligner uses the copy on the node it is created on
+ */
+#include "Genome.h"
+#include "ErrorWarning.h"
+
+#include <sched.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/mempolicy.h>
+
+#define NUMA_nodeMaskLongs 16 //up to 1024 nodes
+
+static vector<int> numaNodesWithMemory()
+{//nodes listed in sysfs as e.g. 0-1,3; empty without NUMA support
+    vector<int> nodes;
+    ifstream nodeList("/sys/devices/system/node/has_memory");
+    string range;
+    while (getline(nodeList, range, ',')) {
+        int n1=-1, n2=-1;
+        int nRead=sscanf(range.c_str(), "%d-%d", &n1, &n2);
+        if (nRead<1 || n1<0)
+            continue;
+        if (nRead==1)
+            n2=n1;
+        for (int n=n1; n<=n2 && n<NUMA_nodeMaskLongs*64; n++)
+            nodes.push_back(n);
+    };
+    return nodes;
+};
+
+int Genome::numaNodeCurrent()
+{
+    unsigned cpu=0, node=0;
+    if (syscall(SYS_getcpu, &cpu, &node, NULL)!=0)
+        return -1;
+    return (int) node;
+};
+
+bool Genome::numaBindThread(int node)
+{
+    ifstream cpuList("/sys/devices/system/node/node"+to_string(node)+"/cpulist");
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    string range;
+    while (getline(cpuList, range, ',')) {
+        int c1=-1, c2=-1;
+        int nRead=sscanf(range.c_str(), "%d-%d", &c1, &c2);
+        if (nRead<1 || c1<0)
+            continue;
+        if (nRead==1)
+            c2=c1;
+        for (int c=c1; c<=c2 && c<CPU_SETSIZE; c++)
+            CPU_SET(c, &cpus);
+    };
+    return CPU_COUNT(&cpus)>0 && sched_setaffinity(0, sizeof(cpus), &cpus)==0;
+};
+
+int Genome::numaNode() const
+{
+    return pGe.gNUMA=="Replicate" && !numaNodes.empty() ? numaNodes[0] : -1;
+};
+
+const Genome& Genome::numaGenome(int node) const
+{
+    for (uint ii=1; ii<numaNodes.size() && ii<=numaReplicas.size(); ii++) {
+        if (numaNodes[ii]==node)
+            return *numaReplicas[ii-1];
+    };
+    return *this;
+};
+
+void Genome::numaBind(char *start, uint bytes, int node, bool movePages)
+{//set the memory policy of the whole pages of [start,start+bytes): interleave over numaNodes if node<0, otherwise prefer node
+    uint pageBytes=sysconf(_SC_PAGESIZE);
+    uint a1=((uint) start+pageBytes-1)/pageBytes*pageBytes;
+    uint a2=((uint) start+bytes)/pageBytes*pageBytes;
+    if (a2<=a1)
+        return;
+
+    unsigned long nodeMask[NUMA_nodeMaskLongs];
+    memset(nodeMask, 0, sizeof(nodeMask));
+    for (auto n : numaNodes) {
+        if (node<0 || n==node)
+            nodeMask[n/64] |= 1LU << (n%64);
+    };
+    if (syscall(SYS_mbind, a1, a2-a1, node<0 ? MPOL_INTERLEAVE : MPOL_PREFERRED, nodeMask, sizeof(nodeMask)*8+1, movePages ? MPOL_MF_MOVE : 0)!=0)
+        P.inOut->logMain << "WARNING: could not set the NUMA policy of " << a2-a1 << " bytes of the genome: " << strerror(errno) << "\n" <<flush;
+};
+
+char* Genome::numaAlloc(uint bytes, int node)
+{//private array with its pages allocated on node when they are first touched
+    char *a;
+    if (pGe.gHugePages!="None") {
+        a=hugePagesAlloc(bytes);
+    } else {
+        a=(char*) mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (a==MAP_FAILED) {
+            ostringstream errOut;
+            errOut <<"EXITING: fatal error trying to allocate " << bytes << " bytes for the genome replica on NUMA node " << node << ": " << strerror(errno) <<"\n";
+            errOut <<"SOLUTION: check that every NUMA node has enough free RAM for a copy of the genome, or use --genomeNUMA Interleave\n" <<flush;
+            exitWithError(errOut.str(),std::cerr, P.inOut->logMain, EXIT_CODE_MEMORY_ALLOCATION, P);
+        };
+        mmapRegions.push_back({a, bytes});
+    };
+    numaBind(a, bytes, node, false);
+    return a;
+};
+
+void Genome::numaPlace(uint L)
+{//choose the nodes and set the policy of the genome arrays before they are loaded
+    if (pGe.gNUMA=="None")
+        return;
+
+    vector<int> nodes=numaNodesWithMemory();
+    if (nodes.size()<2) {
+        P.inOut->logMain << "--genomeNUMA " << pGe.gNUMA << " is not used: " << nodes.size() << " NUMA node(s) with memory\n" <<flush;
+        return;
+    };
+    numaNodes=nodes;
+    if (pGe.gNUMA=="Replicate")
+        numaNodes.resize(1); //the replicas add their nodes
+
+    if (!sharedMemory || sharedMemory->IsAllocator()) {//attached shared memory was placed by the job that loaded it
+        int node= pGe.gNUMA=="Interleave" ? -1 : numaNodes[0];
+        numaBind(G1, nGenome+L+L, node, false);
+        numaBind(SA.charArray, SA.lengthByte, node, false);
+        numaBind(SAi.charArray, SAi.lengthByte, node, false);
+    };
+};
+
+Genome::Genome(const Genome &genomeMain, int numaNode) : Genome(genomeMain)
+{
+    sharedMemory.reset();
+    numaReplicas.clear();
+    mmapRegions.clear();
+    SAinsert=PackedArray();
+    SApass1=PackedArray();
+    SApass2=PackedArray();
+    numaNodes={numaNode};
+
+    uint L=genomeMain.G-genomeMain.G1;
+    G1=numaAlloc(nGenome+L+L, numaNode);
+    memcpy(G1, genomeMain.G1, nGenome+L+L);
+    G=G1+L;
+    SA.pointArray(numaAlloc(SA.lengthByte, numaNode));
+    memcpy(SA.charArray, genomeMain.SA.charArray, SA.lengthByte);
+    SAi.pointArray(numaAlloc(SAi.lengthByte, numaNode));
+    memcpy(SAi.charArray, genomeMain.SAi.charArray, SAi.lengthByte);
+    if (!SAlcp.empty())
+        numaBind((char*) SAlcp.data(), SAlcp.size(), numaNode, true);
+    if (!SAhash.empty())
+        numaBind((char*) SAhash.data(), SAhash.size()*sizeof(SAhashEntry), numaNode, true);
+
+};
+
+void Genome::numaReplicate()
+{//copy the loaded genome to the other nodes with memory
+    if (pGe.gNUMA!="Replicate" || numaNodes.empty())
+        return;
+
+    for (auto node : numaNodesWithMemory()) {
+        if (node!=numaNodes[0])
+            numaReplicas.push_back(shared_ptr<const Genome>(new Genome(*this, node)));
+    };
+    for (auto &replica : numaReplicas)
+        numaNodes.push_back(replica->numaNodes[0]);
+
+    time_t rawtime;
+    time ( &rawtime );
+    P.inOut->logMain << "Replicated the genome on " << numaNodes.size() << " NUMA nodes: " << asctime (localtime ( &rawtime )) <<flush;
+};
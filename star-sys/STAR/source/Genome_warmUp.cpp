@@ -0,0 +1,61 @@
+/*
+ * Warm-up of a loaded genome before the first reads are mapped
+ *
+ * Every page of SAi, and optionally of G and SA, is read once, so that the page faults of a mapped,
+ * attached or lazily allocated genome are taken here rather than by the first reads
+ */
+#include "Genome.h"
+
+#include <chrono>
+#include <thread>
+#include <unistd.h>
+#include <sys/mman.h>
+
+static void warmUpRange(const char *start, uint bytes, uint threadN)
+{//read one byte of every page of [start,start+bytes), threadN threads at a time
+    if (bytes==0)
+        return;
+
+    uint pageBytes=sysconf(_SC_PAGESIZE);
+    uint a1=(uint) start/pageBytes*pageBytes;
+    madvise((void*) a1, (uint) start+bytes-a1, MADV_WILLNEED); //read-ahead for mapped files, ignored for anonymous memory
+
+    uint pageN=((uint) start+bytes-a1+pageBytes-1)/pageBytes;
+    threadN=max((uint) 1, min(threadN, pageN));
+    auto touchPages = [&](uint it) {
+        for (uint ip=pageN*it/threadN; ip<pageN*(it+1)/threadN; ip++)
+            (void) *(const volatile char*) max((uint) start, a1+ip*pageBytes);
+    };
+
+    vector<std::thread> threads;
+    for (uint it=1; it<threadN; it++)
+        threads.emplace_back(touchPages, it);
+    touchPages(0);
+    for (auto &t : threads)
+        t.join();
+};
+
+vector<double> Genome::warmUp(uint level, uint threadN) const
+{
+    vector<pair<const char*,uint>> phases[3]; //SAi; G; SA
+    phases[0].push_back({SAi.charArray, SAi.lengthByte});
+    if (level>=1) {
+        phases[1].push_back({G1, nGenome+2*(G-G1)});
+    };
+    if (level>=2)
+        phases[2].push_back({SA.charArray, SA.lengthByte});
+
+    vector<double> seconds;
+    for (auto &phase : phases) {
+        if (phase.empty()) {
+            seconds.push_back(0);
+            continue;
+        };
+        auto t1=std::chrono::steady_clock::now();
+        for (auto &range : phase)
+            warmUpRange(range.first, range.second, threadN);
+        seconds.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now()-t1).count());
+    };
+
+    return seconds;
+};
@@ -57,6 +57,9 @@ typedef uint8_t uint8;
 #define uint128 __uint128_t
 
 #define GENOME_spacingChar 5
+#define GENOME_loadThreadN 8 //threads reading the genome files
+#define GENOME_loadChunkBytes 67108864 //genome files are read in chunks of this size, so that large files are also read in parallel
+#define GENOME_checksumBlockBytes 67108864 //genome files are checksummed in blocks of this size, see --genomeChecksums
 
 #define uintWinBin unsigned short
 #define uintWinBinMax numeric_limits<uint16>::max()
@@ -74,6 +77,9 @@ typedef uint8_t uint8;
 
 
 //SAM attributes
+#define OUT_FORMAT_SAM 0
+#define OUT_FORMAT_BAM 1
+
 #define ATTR_NH 1
 #define ATTR_HI 2
 #define ATTR_AS 3
@@ -159,6 +165,18 @@ typedef uint8_t uint8;
 #define MARK_FRAG_SPACER_BASE 11
 #define MAX_N_CHIMERAS 5
 #define MAX_N_MULTMAP 100000 //max number of multiple mappers
+#define DEF_seedPerReadNinit 64 //pieces allocated per read at start, grown up to seedPerReadNmax as reads need them
+#define DEF_alignWindowsPerReadNinit 32 //windows allocated per read at start, grown up to alignWindowsPerReadNmax
+#define SEED_prefetchStageReads 4 //reads between the stages of SeedPrefetch, which has SEED_prefetchStagesN*SEED_prefetchStageReads reads in flight
+#define SEED_prefetchStagesN 3
+#define SEED_prefetchSeedsMax 16 //seeds prefetched per read
+
+#define SA_lcpMax 255 //SA common prefix lengths are stored in one byte, longer ones as SA_lcpMax, see --genomeSAlcp
+#define SA_lcpScanMax 256 //largest SA range scanned for the smallest common prefix length, larger ranges compare the read to the genome
+
+#define SA_hashNbits 24 //SAhash entries store the number of suffixes of a k-mer in this many bits, k-mers with more suffixes are not stored
+#define SA_hashMult 0x9E3779B97F4A7C15LLU //multiplicative hash of the k-mer codes into the SAhash slots
+#define DEF_alignTranscriptsPerReadWindowsInit 2 //transcripts allocated per read at start, in units of alignTranscriptsPerWindowNmax
 #define MAX_SJ_REPEAT_SEARCH 255 //max length of a repeat to search around a SJ
 #define MAX_QS_VALUE 60
 #define MAX_OUTPUT_FLAG 10
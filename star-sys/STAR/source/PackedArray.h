@@ -10,6 +10,7 @@ class PackedArray {
     public:
         uint wordLength, length, lengthByte;
         uint operator [] (uint ii) const;
+        template <uint wordBits> uint wordAt(uint ii) const; //word ii for a compile-time word length, 0: use wordLength
         char* charArray;
 
     PackedArray();
@@ -33,14 +34,22 @@ uint index(const PackedArray pa, uint ii)
 
 }*/
 
-inline uint PackedArray::operator [] (uint ii) const {
-   uint b=ii*wordLength;
-   uint B=b/8;
-   uint S=b%8;
+template <uint wordBits>
+inline uint PackedArray::wordAt(uint ii) const {
+   const uint wL = wordBits==0 ? wordLength : wordBits;
+   const uint wCL = wordBits==0 ? wordCompLength : sizeof(uint)*8LLU-wordBits;
+   uint b=ii*wL;
+   uint B= wordBits>0 && wordBits%8==0 ? ii*(wL/8) : b/8;
+   uint S=b%8; //always 0 for byte-aligned words, e.g. 40 bits
 
    uint a1 = *((uint*) (charArray+B));
-   a1 = ((a1>>S)<<wordCompLength)>>wordCompLength;
+   a1 = ((a1>>S)<<wCL)>>wCL;
    return a1;
 };
 
+inline uint PackedArray::operator [] (uint ii) const {
+   //byte-aligned 40-bit words (--genomeSAencoding Byte40) are decoded with one load and one mask
+   return wordLength==40 ? wordAt<40>(ii) : wordAt<0>(ii);
+};
+
 #endif
@@ -36,12 +36,21 @@ Parameters::Parameters() {//initalize parameters info
     //genome
     parArray.push_back(new ParameterInfoScalar <string> (-1, -1, "genomeDir", &pGe.gDir));
     parArray.push_back(new ParameterInfoScalar <string> (-1, -1, "genomeLoad", &pGe.gLoad));
+    parArray.push_back(new ParameterInfoScalar <string> (-1, -1, "genomeMmapAdvice", &pGe.gMmapAdvice));
+    parArray.push_back(new ParameterInfoScalar <string> (-1, -1, "genomeHugePages", &pGe.gHugePages));
+    parArray.push_back(new ParameterInfoScalar <string> (-1, -1, "genomeNUMA", &pGe.gNUMA));
+    parArray.push_back(new ParameterInfoScalar <string> (-1, -1, "genomeChecksums", &pGe.gChecksums));
+    parArray.push_back(new ParameterInfoScalar <string> (-1, -1, "genomeSAlcp", &pGe.gSAlcp));
     parArray.push_back(new ParameterInfoVector <string> (-1, -1, "genomeFastaFiles", &pGe.gFastaFiles));
     parArray.push_back(new ParameterInfoVector <string> (-1, -1, "genomeChainFiles", &pGe.gChainFiles));
     parArray.push_back(new ParameterInfoScalar <uint> (-1, -1, "genomeSAindexNbases", &pGe.gSAindexNbases));
+    parArray.push_back(new ParameterInfoScalar <uint> (-1, -1, "genomeSAhashNbases", &pGe.gSAhashNbases));
+    parArray.push_back(new ParameterInfoScalar <uint> (-1, -1, "genomeSAhashRangeMin", &pGe.gSAhashRangeMin));
     parArray.push_back(new ParameterInfoScalar <uint> (-1, -1, "genomeChrBinNbits", &pGe.gChrBinNbits));
     parArray.push_back(new ParameterInfoScalar <uint> (-1, -1, "genomeSAsparseD", &pGe.gSAsparseD));
     parArray.push_back(new ParameterInfoScalar <uint> (-1, -1, "genomeSuffixLengthMax", &pGe.gSuffixLengthMax));
+    parArray.push_back(new ParameterInfoScalar <string> (-1, -1, "genomeSAencoding", &pGe.gSAencoding));
+    pGe.gSAencoding_par=parArray.size()-1;
     parArray.push_back(new ParameterInfoVector <uint> (-1, -1, "genomeFileSizes", &pGe.gFileSizes));
     parArray.push_back(new ParameterInfoScalar <string> (-1, -1, "genomeConsensusFile", &pGe.gConsensusFile));
 
@@ -1226,10 +1235,54 @@ void Parameters::inputParameters (int argInN, const char* const argIn[]) {//inpu
 //     genomeNumToNT={'A','C','G','T','N'};
     strcpy(genomeNumToNT,"ACGTN");
 
-    if (pGe.gLoad!="LoadAndKeep" && pGe.gLoad!="LoadAndRemove" && pGe.gLoad!="Remove" && pGe.gLoad!="LoadAndExit" && pGe.gLoad!="NoSharedMemory") {// find shared memory fragment
+    if (pGe.gLoad!="LoadAndKeep" && pGe.gLoad!="LoadAndRemove" && pGe.gLoad!="Remove" && pGe.gLoad!="LoadAndExit" && pGe.gLoad!="NoSharedMemory" && pGe.gLoad!="Mmap") {// find shared memory fragment
         ostringstream errOut;
         errOut << "EXITING because of FATAL INPUT ERROR: --genomeLoad=" << pGe.gLoad << "\n" <<flush;
-        errOut << "SOLUTION: use one of the allowed values of --genomeLoad : NoSharedMemory,LoadAndKeep,LoadAndRemove,LoadAndExit,Remove.\n" <<flush;
+        errOut << "SOLUTION: use one of the allowed values of --genomeLoad : NoSharedMemory,LoadAndKeep,LoadAndRemove,LoadAndExit,Remove,Mmap.\n" <<flush;
+        exitWithError(errOut.str(),std::cerr, inOut->logMain, EXIT_CODE_PARAMETER, *this);
+    };
+
+    if (pGe.gMmapAdvice!="None" && pGe.gMmapAdvice!="Populate" && pGe.gMmapAdvice!="WillNeed" && pGe.gMmapAdvice!="Random") {
+        ostringstream errOut;
+        errOut << "EXITING because of FATAL INPUT ERROR: --genomeMmapAdvice=" << pGe.gMmapAdvice << "\n" <<flush;
+        errOut << "SOLUTION: use one of the allowed values of --genomeMmapAdvice : None,Populate,WillNeed,Random.\n" <<flush;
+        exitWithError(errOut.str(),std::cerr, inOut->logMain, EXIT_CODE_PARAMETER, *this);
+    };
+
+    if (pGe.gHugePages!="None" && pGe.gHugePages!="Transparent" && pGe.gHugePages!="Hugetlb") {
+        ostringstream errOut;
+        errOut << "EXITING because of FATAL INPUT ERROR: --genomeHugePages=" << pGe.gHugePages << "\n" <<flush;
+        errOut << "SOLUTION: use one of the allowed values of --genomeHugePages : None,Transparent,Hugetlb.\n" <<flush;
+        exitWithError(errOut.str(),std::cerr, inOut->logMain, EXIT_CODE_PARAMETER, *this);
+    };
+
+    if (pGe.gNUMA!="None" && pGe.gNUMA!="Interleave" && pGe.gNUMA!="Replicate") {
+        ostringstream errOut;
+        errOut << "EXITING because of FATAL INPUT ERROR: --genomeNUMA=" << pGe.gNUMA << "\n" <<flush;
+        errOut << "SOLUTION: use one of the allowed values of --genomeNUMA : None,Interleave,Replicate.\n" <<flush;
+        exitWithError(errOut.str(),std::cerr, inOut->logMain, EXIT_CODE_PARAMETER, *this);
+    };
+
+    if (pGe.gChecksums!="None" && pGe.gChecksums!="Verify") {
+        ostringstream errOut;
+        errOut << "EXITING because of FATAL INPUT ERROR: --genomeChecksums=" << pGe.gChecksums << "\n" <<flush;
+        errOut << "SOLUTION: use one of the allowed values of --genomeChecksums : None,Verify.\n" <<flush;
+        exitWithError(errOut.str(),std::cerr, inOut->logMain, EXIT_CODE_PARAMETER, *this);
+    };
+
+    if (pGe.gSAlcp!="None" && pGe.gSAlcp!="Use") {
+        ostringstream errOut;
+        errOut << "EXITING because of FATAL INPUT ERROR: --genomeSAlcp=" << pGe.gSAlcp << "\n" <<flush;
+        errOut << "SOLUTION: use one of the allowed values of --genomeSAlcp : None,Use.\n" <<flush;
+        exitWithError(errOut.str(),std::cerr, inOut->logMain, EXIT_CODE_PARAMETER, *this);
+    };
+
+    //--genomeSAhashNbases is checked by genomeSAhashCheck() once the --genomeSAindexNbases of the genome is known
+
+    if (pGe.gSAencoding!="Packed" && pGe.gSAencoding!="Byte40") {
+        ostringstream errOut;
+        errOut << "EXITING because of FATAL INPUT ERROR: --genomeSAencoding=" << pGe.gSAencoding << "\n" <<flush;
+        errOut << "SOLUTION: use one of the allowed values of --genomeSAencoding : Packed,Byte40.\n" <<flush;
         exitWithError(errOut.str(),std::cerr, inOut->logMain, EXIT_CODE_PARAMETER, *this);
     };
 
@@ -1391,6 +1444,23 @@ void Parameters::inputParameters (int argInN, const char* const argIn[]) {//inpu
 
 
 
+/////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void Parameters::genomeSAhashCheck() {//the hashed k-mers extend the SAindex prefixes of the genome
+    if (pGe.gSAhashNbases>31) {
+        ostringstream errOut;
+        errOut << "EXITING because of FATAL INPUT ERROR: --genomeSAhashNbases=" << pGe.gSAhashNbases << " is larger than 31\n" <<flush;
+        errOut << "SOLUTION: use --genomeSAhashNbases between --genomeSAindexNbases+1 and 31, or 0 for no k-mer hash.\n" <<flush;
+        exitWithError(errOut.str(),std::cerr, inOut->logMain, EXIT_CODE_PARAMETER, *this);
+    };
+
+    if (pGe.gSAhashNbases>0 && pGe.gSAhashNbases<=pGe.gSAindexNbases) {
+        ostringstream errOut;
+        errOut << "EXITING because of FATAL INPUT ERROR: --genomeSAhashNbases=" << pGe.gSAhashNbases << " is not longer than --genomeSAindexNbases=" << pGe.gSAindexNbases << " of the genome\n" <<flush;
+        errOut << "SOLUTION: use --genomeSAhashNbases between " << pGe.gSAindexNbases+1 << " and 31, or 0 for no k-mer hash.\n" <<flush;
+        exitWithError(errOut.str(),std::cerr, inOut->logMain, EXIT_CODE_PARAMETER, *this);
+    };
+};
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 void Parameters::scanAllLines (istream &streamIn, int inputLevel,  int inputLevelRequested) {//scan
 //     istringstream stringInStream (stringIn);
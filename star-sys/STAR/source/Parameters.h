@@ -333,6 +333,7 @@ class Parameters {
     int scanOneLine (string &lineIn, int inputLevel, int inputLevelRequested);
     void scanAllLines (istream &streamIn, int inputLevel, int inputLevelRequested);
     void inputParameters (int argInN, const char* const argIn[]); //input parameters: default, from files, from command line
+    void genomeSAhashCheck(); //check --genomeSAhashNbases against the --genomeSAindexNbases of the genome
     void openReadsFiles();
     void closeReadsFiles();
     void readSAMheader(const string readFilesCommandString, const vector<string> readFilesNames);
@@ -5,14 +5,23 @@ class ParametersGenome {//"constant" genome parameters - user input
     public:
         string gDir;
         string gLoad;
+        string gMmapAdvice;
+        string gHugePages;
+        string gNUMA;
+        string gChecksums;
+        string gSAlcp;
         vector <string> gFastaFiles;
         vector <string> gChainFiles;
         string gConsensusFile;
 
         uint gSAindexNbases;//length of the SA pre-index strings
+        uint gSAhashNbases;//length of the k-mers hashed to their SA ranges, 0 for none
+        uint gSAhashRangeMin;//SAindex ranges hashed by gSAhashNbases k-mers have at least this many suffixes
         uint gChrBinNbits;
         uint gSAsparseD;//SA sparsity
         uint gSuffixLengthMax;//maximum length of the suffixes, has to be longer than read length
+        string gSAencoding;//Packed or Byte40 suffix array entries
+        int gSAencoding_par;
         vector <uint> gFileSizes;//size of the genome files
 
         vector <string> sjdbFileChrStartEnd;
@@ -9,6 +9,7 @@ ReadAlign::ReadAlign (const Parameters& Pin, const Genome &genomeIn, Transcripto
     iRead = 0;
     readFilesIndex = 0;
     readNmates=P.readNmates;
+    outFormat=OUT_FORMAT_SAM;
     winBin[0] = make_unique<uintWinBin[]>(P.winBinN);
     winBin[1] = make_unique<uintWinBin[]>(P.winBinN);
     memset(winBin[0].get(),255,sizeof(winBin[0][0])*P.winBinN);
@@ -22,16 +23,16 @@ ReadAlign::ReadAlign (const Parameters& Pin, const Genome &genomeIn, Transcripto
     };
     //split
     splitR[0].resize(P.maxNsplit); splitR[1].resize(P.maxNsplit); splitR[2].resize(P.maxNsplit);
-    //alignments
-    PC=make_unique<uiPC[]>(P.seedPerReadNmax);
-    WC=make_unique<uiWC[]>(P.alignWindowsPerReadNmax);
-    nWA=make_unique<uint[]>(P.alignWindowsPerReadNmax);
-    nWAP=make_unique<uint[]>(P.alignWindowsPerReadNmax);
-    WALrec=make_unique<uint[]>(P.alignWindowsPerReadNmax);
-    WlastAnchor=make_unique<uint[]>(P.alignWindowsPerReadNmax);
+    //alignments: allocated small, grown as reads need more
+    nPalloc=0; nWalloc=0; nTrAlloc=0;
+    swWinCov=NULL;
+    growPieces(min(P.seedPerReadNmax, (uint) DEF_seedPerReadNinit));
+    growWindows(min(P.alignWindowsPerReadNmax, (uint) DEF_alignWindowsPerReadNinit));
+    growTranscripts(min(P.alignTranscriptsPerReadNmax, DEF_alignTranscriptsPerReadWindowsInit*(P.alignTranscriptsPerWindowNmax+1)), 0);
+    scratchPeak = {};
+    SAhashSearchN=0;
 
 #ifdef COMPILE_FOR_LONG_READS
-    swWinCov = new uint[P.alignWindowsPerReadNmax];
     scoreSeedToSeed = new intScore [P.seedPerWindowNmax*(P.seedPerWindowNmax+1)/2];
     scoreSeedBest = new intScore [P.seedPerWindowNmax];
     scoreSeedBestInd = new uint [P.seedPerWindowNmax];
@@ -39,16 +40,7 @@ ReadAlign::ReadAlign (const Parameters& Pin, const Genome &genomeIn, Transcripto
     seedChain = new uint [P.seedPerWindowNmax];
 #endif
 
-    WA=make_unique<unique_ptr<uiWA[]>[]>(P.alignWindowsPerReadNmax);
-    for (uint ii=0;ii<P.alignWindowsPerReadNmax;ii++)
-        WA[ii]=make_unique<uiWA[]>(P.seedPerWindowNmax);
     WAincl = make_unique<bool[]>(P.seedPerWindowNmax);
-    trAll = make_unique<Transcript**[]>(P.alignWindowsPerReadNmax+1);
-    nWinTr = make_unique<uint[]>(P.alignWindowsPerReadNmax);
-    trArray = make_unique<Transcript[]>(P.alignTranscriptsPerReadNmax);
-    trArrayPointer = make_unique<Transcript*[]>(P.alignTranscriptsPerReadNmax);
-    for (uint ii=0;ii<P.alignTranscriptsPerReadNmax;ii++)
-        trArrayPointer[ii]= &(trArray[ii]);
     trInit = make_unique<Transcript>();
     //read
     readData = make_unique<std::array<std::array<char, DEF_readSeqLengthMax+1>, 9>>();
@@ -62,6 +54,7 @@ ReadAlign::ReadAlign (const Parameters& Pin, const Genome &genomeIn, Transcripto
         readNameMates[ii]=readNameMatesData[ii].data();
     };
     readNameExtra.resize(P.readNmates);
+    readNameExtraSAMtags=false;
     readName = readNameMates[0];
     Read1[0]=std::get<4>(*readData).data(); Read1[1]=std::get<5>(*readData).data(); Read1[2]=std::get<6>(*readData).data();
     //modified QSs for scoring
@@ -92,3 +85,74 @@ void ReadAlign::resetN () {//reset resets the counters to 0 for a new read
 
 };
 
+template <typename T>
+static void growArray(std::unique_ptr<T[]> &a, uint nOld, uint nNew) {//reallocate a to nNew elements, keeping the first nOld
+    auto aNew=make_unique<T[]>(nNew);
+    if constexpr (std::is_trivially_copyable<T>::value) {
+        if (nOld>0) memcpy(aNew.get(), a.get(), sizeof(T)*nOld);
+    } else {
+        for (uint ii=0; ii<nOld; ii++) aNew[ii]=std::move(a[ii]);
+    };
+    a=std::move(aNew);
+};
+
+void ReadAlign::growPieces(uint nPneed) {//make room for nPneed pieces, preserving the stored ones
+    if (nPneed<=nPalloc) return;
+    uint nNew=min(max(nPneed, 2*nPalloc), P.seedPerReadNmax);
+    growArray(PC, nPalloc, nNew);
+    nPalloc=nNew;
+};
+
+void ReadAlign::growWindows(uint nWneed) {//make room for nWneed windows, preserving the recorded ones
+    if (nWneed<=nWalloc) return;
+    uint nNew=min(max(nWneed, 2*nWalloc), P.alignWindowsPerReadNmax);
+    growArray(WC, nWalloc, nNew);
+    growArray(nWA, nWalloc, nNew);
+    growArray(nWAP, nWalloc, nNew);
+    growArray(WALrec, nWalloc, nNew);
+    growArray(WlastAnchor, nWalloc, nNew);
+    growArray(nWinTr, nWalloc, nNew);
+    growArray(trAll, nWalloc==0 ? 0 : nWalloc+1, nNew+1);
+    growArray(WA, nWalloc, nNew); //moves the rows of the existing windows
+    for (uint ii=nWalloc; ii<nNew; ii++)
+        WA[ii]=make_unique<uiWA[]>(P.seedPerWindowNmax);
+#ifdef COMPILE_FOR_LONG_READS
+    uint *swWinCovNew = new uint[nNew];
+    if (swWinCov!=NULL) {
+        memcpy(swWinCovNew, swWinCov, sizeof(swWinCov[0])*nWalloc);
+        delete[] swWinCov;
+    };
+    swWinCov=swWinCovNew;
+#endif
+    nWalloc=nNew;
+};
+
+void ReadAlign::growTranscripts(uint nTrNeed, uint nWinRecorded) {//make room for nTrNeed transcripts
+    //new transcripts are added as a separate block, so that trBest and trArrayPointer entries stay valid
+    //trAll of the nWinRecorded windows point into trArrayPointer and are moved with it
+    if (nTrNeed<=nTrAlloc) return;
+    uint nNew=min(max(nTrNeed, 2*nTrAlloc), P.alignTranscriptsPerReadNmax);
+    trArray.push_back(make_unique<Transcript[]>(nNew-nTrAlloc));
+    Transcript **trArrayPointerOld=trArrayPointer.get();
+    growArray(trArrayPointer, nTrAlloc, nNew); //keeps the order stitchWindowAligns left the pointers in
+    for (uint ii=nTrAlloc; ii<nNew; ii++)
+        trArrayPointer[ii]=&(trArray.back()[ii-nTrAlloc]);
+    for (uint iW=0; iW<nWinRecorded; iW++)
+        trAll[iW]=trArrayPointer.get()+(trAll[iW]-trArrayPointerOld);
+    trMult=make_unique<Transcript*[]>(nNew); //only filled after stitching, by multMapSelect
+    nTrAlloc=nNew;
+};
+
+ReadAlign::ScratchUsage ReadAlign::scratchUsage() const {
+    ScratchUsage usage;
+    usage.bytes = sizeof(uiPC)*nPalloc
+                + (sizeof(uiWC)+5*sizeof(uint)+sizeof(Transcript**)+sizeof(uiWA)*P.seedPerWindowNmax)*nWalloc
+                + (sizeof(Transcript)+2*sizeof(Transcript*))*nTrAlloc
+                + sizeof(*readData);
+    usage.peakSeeds = scratchPeak.nP;
+    usage.peakWindows = scratchPeak.nW;
+    usage.peakTranscripts = scratchPeak.nTr;
+    usage.peakMultimappers = scratchPeak.nTrMult;
+    return usage;
+};
+
@@ -20,6 +20,7 @@ class ReadAlign {
         ReadAlign& operator=(ReadAlign const&) = delete;
         
         int oneRead();
+        int oneReadRaw(const char* const seqs[], const uint seqLens[], const char* const quals[], const uint qualLens[], const char* tags, uint tagsLen); //bypasses readFastq parsing, tags are output with each record. Returns -1 for an empty read, a read or pair longer than DEF_readSeqLengthMax, or a quality string of another length
 
         //vars
         const Genome &mapGen; //mapped-to-genome structure
@@ -37,6 +38,10 @@ class ReadAlign {
         uint outBAMbytes; //number of bytes output to SAM/BAM with oneRead
         char *outBAMarray;//pointer to the (last+1) position of the SAM/BAM output array
 
+        int outFormat; //OUT_FORMAT_SAM: alignments are stored in outSAMtext, OUT_FORMAT_BAM: in outBAMrecords
+        string outSAMtext; //SAM text of the last read, for OUT_FORMAT_SAM
+        string outBAMrecords; //BAM records of the last read, for OUT_FORMAT_BAM
+
         uint outFilterMismatchNmaxTotal;
         uint Lread, readLength[MAX_N_MATES], readLengthOriginal[MAX_N_MATES], readLengthPair, readLengthPairOriginal;
         intScore maxScoreMate[MAX_N_MATES];
@@ -59,6 +64,12 @@ class ReadAlign {
         int mapOneRead();
         const char* outputAlignments();
         void resetN();
+        struct ScratchUsage {
+            uint bytes; //allocated
+            uint peakSeeds, peakWindows, peakTranscripts, peakMultimappers; //max number used by one read
+        };
+        ScratchUsage scratchUsage() const; //allocated size and peak per-read use of the scratch arrays
+        uint SAhashSearchN; //seed searches started from the SA range of a --genomeSAhashNbases k-mer
     private:
         const Parameters& P; //pointer to the parameters, will be initialized on construction
 
@@ -84,7 +95,8 @@ class ReadAlign {
         std::unique_ptr<char*[]> outBAMoneAlign;
         std::unique_ptr<uint[]> outBAMoneAlignNbytes;
 
-        ostringstream samStreamCIGAR, samStreamSJmotif, samStreamSJintron;
+        ostringstream samStreamCIGAR;
+        string samSJmotif, samSJintron, samMD; //jM jI MD of the SAM record being written
         vector <string> matesCIGAR;
 
         intScore *scoreSeedToSeed, *scoreSeedBest;
@@ -95,7 +107,7 @@ class ReadAlign {
 //         StatsAll *statsRA;
 
         //transcript
-        std::unique_ptr<Transcript[]> trArray; //linear array of transcripts to store all of them from all windows
+        std::vector<std::unique_ptr<Transcript[]>> trArray; //blocks of transcripts from all windows, added by growTranscripts so that transcripts never move
         std::unique_ptr<Transcript*[]> trArrayPointer; //linear array of transcripts to store all of them from all windows
 
         //read
@@ -106,6 +118,7 @@ class ReadAlign {
         int readFileType; //file type: 1=fasta; 2=fastq
 
         vector<string>readNameExtra;
+        bool readNameExtraSAMtags; //readNameExtra holds SAM attributes to output: set for tags given to oneReadRaw, SAM input is checked with P.readFilesTypeN
 
         char dummyChar[4096];
         //char** Read0;
@@ -119,6 +132,12 @@ class ReadAlign {
         std::array<std::vector<uint>, 3> splitR;
         uint Nsplit;
 
+        //SAindex prefix codes of Read1[0], computed once per read by seedCodesCalc
+        std::array<std::vector<uint>, 2> seedCode; //gSAindexNbases-long prefix code at each read base, forward and reverse-complement. N bases are coded as 0
+        std::array<std::vector<uint8>, 2> seedCodeL; //N-mask of seedCode: number of its leading bases that are not N
+        void seedCodesCalc();
+        uint seedKmer(uint pieceStart, bool dirR, uint kB); //code of the SAhash k-mer at pieceStart
+
 //         uint fragLength[MAX_N_FRAG], fragStart[MAX_N_FRAG]; //fragment Lengths and Starts in read space
 
         //binned alignments
@@ -148,6 +167,15 @@ class ReadAlign {
         std::unique_ptr<Transcript **[]> trAll; //all transcripts for all windows
         std::unique_ptr<uint[]> nWinTr; //number of recorded transcripts per window
 
+        //scratch arrays are allocated small and grown geometrically as reads need more
+        uint nPalloc, nWalloc, nTrAlloc; //allocated pieces (PC), windows (WC, WA, nWA...), transcripts (trArray, trMult)
+        struct {
+            uint nP, nW, nTr, nTrMult;
+        } scratchPeak; //max number of pieces, windows, transcripts, multimappers used by one read
+        void growPieces(uint nPneed);
+        void growWindows(uint nWneed);
+        void growTranscripts(uint nTrNeed, uint nWinRecorded);
+
         //old chimeric detection
         uint chimN, chimRepeat, chimStr;
         int chimMotif;
@@ -158,7 +186,7 @@ class ReadAlign {
 
         Transcript *alignC, *extendC, *polyAtailC; //alignment rules/conditions
 
-        Transcript* trMult[MAX_N_MULTMAP];//multimapping transcripts
+        std::unique_ptr<Transcript*[]> trMult;//multimapping transcripts, nTrAlloc of them
         std::unique_ptr<Transcript[]> alignTrAll;//alignments to transcriptome
 
         struct {
@@ -171,12 +199,14 @@ class ReadAlign {
         //void resetN();//resets the counters to 0
         //void multMapSelect();
         //int mapOneRead();
+        int mapLoadedRead(int readFileTypeIn); //map the read loaded by oneRead or oneReadRaw
         uint maxMappableLength2strands(uint pieceStart, uint pieceLength, uint iDir, uint iSA1, uint iSA2, uint& maxL, uint iFrag);
         void storeAligns (uint iDir, uint Shift, uint Nrep, uint L, uint indStartEnd[2], uint iFrag);
 
         bool outputTranscript(Transcript *trOut, uint nTrOut, ofstream *outBED);
-        uint outputTranscriptSAM(Transcript const &trOut, uint nTrOut, uint iTrOut, uint mateChr, uint mateStart, char mateStrand, int unmapType, bool *mateMapped, ostream *outStream);
-        int alignBAM(Transcript const &trOut, uint nTrOut, uint iTrOut, uint trChrStart, uint mateChr, uint mateStart, char mateStrand, int unmapType, bool *mateMapped, vector<int> outSAMattrOrder, char** outBAMarray, uint* outBAMarrayN);
+        uint outputOneAlign(Transcript const &trOut, uint nTrOut, uint iTrOut, int unmapType, bool *mateMapped);
+        uint outputTranscriptSAM(Transcript const &trOut, uint nTrOut, uint iTrOut, uint mateChr, uint mateStart, char mateStrand, int unmapType, bool *mateMapped, string &outText);
+        int alignBAM(Transcript const &trOut, uint nTrOut, uint iTrOut, uint trChrStart, uint mateChr, uint mateStart, char mateStrand, int unmapType, bool *mateMapped, const vector<int> &outSAMattrOrder, char** outBAMarray, uint* outBAMarrayN);
         void samAttrNM_MD (Transcript const &trOut, uint iEx1, uint iEx2, uint &tagNM, string &tagMD);
 
         string outputTranscriptCIGARp(Transcript const &trOut);
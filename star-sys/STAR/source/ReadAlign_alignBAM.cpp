@@ -172,7 +172,7 @@ int bamAttrArrayWriteInt(intType xIn, const char* tagName, char* attrArray, cons
 
 
 
-int ReadAlign::alignBAM(Transcript const &trOut, uint nTrOut, uint iTrOut, uint trChrStart, uint mateChr, uint mateStart, char mateStrand, int alignType, bool *mateMapped, vector<int> outSAMattrOrder, char** outBAMarray, uint* outBAMarrayN) {
+int ReadAlign::alignBAM(Transcript const &trOut, uint nTrOut, uint iTrOut, uint trChrStart, uint mateChr, uint mateStart, char mateStrand, int alignType, bool *mateMapped, const vector<int> &outSAMattrOrder, char** outBAMarray, uint* outBAMarrayN) {
     //return: number of lines (mates)
 
     //alignType>=0: unmapped reads
@@ -195,7 +195,7 @@ int ReadAlign::alignBAM(Transcript const &trOut, uint nTrOut, uint iTrOut, uint
     uint16 samFLAG=0;
 
 
-    bool flagPaired = P.readNmates==2;
+    bool flagPaired = readNmates==2;
 
     uint nMates=1;
     if (alignType<0) {//mapped reads: SAM
@@ -224,7 +224,7 @@ int ReadAlign::alignBAM(Transcript const &trOut, uint nTrOut, uint iTrOut, uint
         calcCIGAR(trOut, nMates, iExMate, leftMate);
     };
 
-    for (uint imate=0;imate < (alignType<0 ? nMates:P.readNmates);imate++) {
+    for (uint imate=0;imate < (alignType<0 ? nMates:readNmates);imate++) {
 
         uint iEx1=0;
         uint iEx2=0;
@@ -240,7 +240,7 @@ int ReadAlign::alignBAM(Transcript const &trOut, uint nTrOut, uint iTrOut, uint
         if (alignType>=0) {//this mate is unmapped
             if (mateMapped!=NULL && mateMapped[imate]) continue; //this mate was mapped, do not record it as unmapped
             samFLAG=0x4;
-            if (P.readNmates==2) {//paired read
+            if (readNmates==2) {//paired read
                 samFLAG|=0x1 + (imate==0 ? 0x40 : 0x80);
                 if (mateMapped[1-imate]) {//mate mapped
                     if (trOut.Str!=(1-imate))
@@ -286,8 +286,12 @@ int ReadAlign::alignBAM(Transcript const &trOut, uint nTrOut, uint iTrOut, uint
                 samFLAG=0x0001;
                 if (iExMate==trOut.nExons-1) {//single mate
                     if (mateChr>mapGen.nChrReal) samFLAG|=0x0008; //not mapped as pair
-                } else {//properly paired
-                    samFLAG|=0x0002; //mapped as pair
+                } else {//paired align
+                    if (P.alignEndsProtrude.concordantPair || \
+                        ( (trOut.exons[0][EX_G] <= trOut.exons[iExMate+1][EX_G]+trOut.exons[0][EX_R]) && \
+                           (trOut.exons[iExMate][EX_G]+trOut.exons[iExMate][EX_L] <= trOut.exons[trOut.nExons-1][EX_G]+Lread-trOut.exons[trOut.nExons-1][EX_R]) )  ) {//properly paired
+                        samFLAG|=0x0002; //mapped as pair
+                    };
                 };
             } else {//single end
                 samFLAG=0;
@@ -473,19 +477,6 @@ int ReadAlign::alignBAM(Transcript const &trOut, uint nTrOut, uint iTrOut, uint
                         };
                         break;
 
-                    case ATTR_CR:
-                            attrN+=bamAttrArrayWrite(soloRead->readBar->cbSeq,"CR",attrOutArray+attrN);
-                        break;
-                    case ATTR_CY:
-                            attrN+=bamAttrArrayWrite(soloRead->readBar->cbQual,"CY",attrOutArray+attrN);
-                        break;
-                    case ATTR_UR:
-                            attrN+=bamAttrArrayWrite(soloRead->readBar->umiSeq,"UR",attrOutArray+attrN);
-                        break;
-                    case ATTR_UY:
-                            attrN+=bamAttrArrayWrite(soloRead->readBar->umiQual,"UY",attrOutArray+attrN);
-                        break;
-
                     default:
                         ostringstream errOut;
                         errOut <<"EXITING because of FATAL BUG: unknown/unimplemented SAM/BAM atrribute (tag): "<<outSAMattrOrder[ii] <<"\n";
@@ -495,7 +486,7 @@ int ReadAlign::alignBAM(Transcript const &trOut, uint nTrOut, uint iTrOut, uint
             };
         };
 
-        if (P.readFilesTypeN==10) {
+        if (P.readFilesTypeN==10 || readNameExtraSAMtags) {
 //             if (readNameExtra[Mate].size()<1)
 //                 cout << iReadAll <<" " <<readName <<endl;
             attrN+=bamAttrArrayWriteSAMtags(readNameExtra[Mate],attrOutArray+attrN);
@@ -548,11 +539,15 @@ int ReadAlign::alignBAM(Transcript const &trOut, uint nTrOut, uint iTrOut, uint
         };
 
         //3: bin mq nl bin<<16|MAPQ<<8|l read name; bin is computed by the > reg2bin() function in Section 4.3; l read name is the length> of read name below (= length(QNAME) + 1).> uint32 t
+        //read name is padded with extra 0-chars to keep CIGAR 4-byte aligned in memory, unless the padded length does not fit in a byte
+        uint lQname=strlen(readName); //note:read length includes 0-char
+        if (lQname+(4-lQname%4)%4 < 256)
+            lQname+=(4-lQname%4)%4;
         if (alignType<0) {
             pBAM[3]=( ( reg2bin(trOut.exons[iEx1][EX_G] - trChrStart,trOut.exons[iEx2][EX_G] + trOut.exons[iEx2][EX_L] - trChrStart) << 16 ) \
-                   |( MAPQ<<8 ) | ( strlen(readName) ) ); //note:read length includes 0-char
+                   |( MAPQ<<8 ) | lQname );
         } else {
-            pBAM[3]=( reg2bin(-1,0) << 16 |  strlen(readName) );//4680=reg2bin(-1,0)
+            pBAM[3]=( reg2bin(-1,0) << 16 | lQname );//4680=reg2bin(-1,0)
         };
 
         //4: FLAG<<16|n cigar op; n cigar op is the number of operations in CIGAR.
@@ -595,8 +590,9 @@ int ReadAlign::alignBAM(Transcript const &trOut, uint nTrOut, uint iTrOut, uint
         recSize+=9*sizeof(int32); //core record size
 
         //Read name1, NULL terminated (QNAME plus a tailing `\0')
-        strcpy(outBAMarray[imate]+recSize,readName+1);
-        recSize+=strlen(readName);
+        memset(outBAMarray[imate]+recSize,0,lQname);
+        memcpy(outBAMarray[imate]+recSize,readName+1,strlen(readName)-1);
+        recSize+=lQname;
 
         //CIGAR: op len<<4|op. `MIDNSHP=X'!`012345678'
         memcpy(outBAMarray[imate]+recSize,packedCIGAR, nCIGAR*sizeof(int32));
@@ -1,7 +1,8 @@
 #include "ReadAlign.h"
+#include "SAMtext.h"
 
 void ReadAlign::calcCIGAR(Transcript const &trOut, uint nMates, uint iExMate, uint leftMate) {
-    matesCIGAR.clear();
+    matesCIGAR.resize(nMates);
     for (uint imate=0;imate<nMates;imate++) {
 
         uint iEx1 = (imate==0 ? 0 : iExMate+1);
@@ -9,7 +10,8 @@ void ReadAlign::calcCIGAR(Transcript const &trOut, uint nMates, uint iExMate, ui
         uint Mate=trOut.exons[iEx1][EX_iFrag];
         uint Str= trOut.Str;
 
-        samStreamCIGAR.str(std::string());
+        matesCIGAR[imate].clear();
+        SAMtext samCIGAR(matesCIGAR[imate]);
 
         uint trimL;
         if (Str==0 && Mate==0) {
@@ -24,7 +26,7 @@ void ReadAlign::calcCIGAR(Transcript const &trOut, uint nMates, uint iExMate, ui
 
         uint trimL1 = trimL + trOut.exons[iEx1][EX_R] - (trOut.exons[iEx1][EX_R]<readLength[leftMate] ? 0 : readLength[leftMate]+1);
         if (trimL1>0) {
-            samStreamCIGAR << trimL1 << "S"; //initial trimming
+            samCIGAR << trimL1 << 'S'; //initial trimming
         };
 
         for (uint ii=iEx1;ii<=iEx2;ii++) {
@@ -33,26 +35,22 @@ void ReadAlign::calcCIGAR(Transcript const &trOut, uint nMates, uint iExMate, ui
                 uint gapR=trOut.exons[ii][EX_R]-trOut.exons[ii-1][EX_R]-trOut.exons[ii-1][EX_L];
                 //it's possible to have a D or N and I at the same time
                 if (gapR>0){
-                    samStreamCIGAR << gapR;
-                    samStreamCIGAR << "I";
+                    samCIGAR << gapR << 'I';
                 };
                 if (trOut.canonSJ[ii-1]>=0 || trOut.sjAnnot[ii-1]==1) {//junction: N
-                    samStreamCIGAR << gapG;
-                    samStreamCIGAR << "N";
+                    samCIGAR << gapG << 'N';
                 } else if (gapG>0) {//deletion: N
-                    samStreamCIGAR << gapG;
-                    samStreamCIGAR << "D";
+                    samCIGAR << gapG << 'D';
                 };
             };
-            samStreamCIGAR << trOut.exons[ii][EX_L] << "M";
+            samCIGAR << trOut.exons[ii][EX_L] << 'M';
         };
 
         uint trimR1=(trOut.exons[iEx1][EX_R]<readLength[leftMate] ? \
             readLengthOriginal[leftMate] : readLength[leftMate]+1+readLengthOriginal[Mate]) \
             - trOut.exons[iEx2][EX_R]-trOut.exons[iEx2][EX_L] - trimL;
         if ( trimR1 > 0 ) {
-            samStreamCIGAR << trimR1 << "S"; //final trimming
+            samCIGAR << trimR1 << 'S'; //final trimming
         };
-        matesCIGAR.push_back(samStreamCIGAR.str());
     };
 };
\ No newline at end of file
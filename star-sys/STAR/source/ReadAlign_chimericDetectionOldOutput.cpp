@@ -114,6 +114,7 @@ void ReadAlign::chimericDetectionOldOutput() {
     };
 
     if (P.pCh.out.samOld) {
+        string chimSAMtext;
         for (uint iTr=0;iTr<chimN;iTr++)
         {//write all chimeric pieces to Chimeric.out.sam/junction
             if (P.readNmates==2) {//PE: need mate info
@@ -131,12 +132,13 @@ void ReadAlign::chimericDetectionOldOutput() {
                 uint mateStart=trChim[1-iTr].exons[iex][EX_G];
                 char mateStrand=(char) (trChim[1-iTr].Str!=trChim[1-iTr].exons[iex][EX_iFrag]);
 
-                outputTranscriptSAM(trChim[iTr], chimN, iTr, mateChr, mateStart, mateStrand, -1, NULL, &chunkOutChimSAM);
+                outputTranscriptSAM(trChim[iTr], chimN, iTr, mateChr, mateStart, mateStrand, -1, NULL, chimSAMtext);
             } else
             {
-                outputTranscriptSAM(trChim[iTr], chimN, iTr, -1, -1, -1, -1, NULL, &chunkOutChimSAM);
+                outputTranscriptSAM(trChim[iTr], chimN, iTr, -1, -1, -1, -1, NULL, chimSAMtext);
             };
         };
+        chunkOutChimSAM << chimSAMtext;
     };
 
     if (P.pCh.out.junctions) {
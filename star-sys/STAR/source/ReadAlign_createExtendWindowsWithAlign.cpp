@@ -59,6 +59,7 @@ int ReadAlign::createExtendWindowsWithAlign(uint a1, uint aStr) {
 
 
         if (!flagMergeLeft && !flagMergeRight) {//no merging, a new window was added
+            growWindows(nW+1);
             wB[aBin]=iWin=nW; //add new window ID for now, may change it later
             WC[iWin][WC_Chr]=mapGen.chrBin[aBin >> P.winBinChrNbits];
             WC[iWin][WC_Str]=aStr;
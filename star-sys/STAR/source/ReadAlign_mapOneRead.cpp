@@ -25,6 +25,9 @@ int ReadAlign::mapOneRead() {
     //printf("read %s; qual %s\n", Read1[0], Qual1[0]);
     //printf("Nsplit %llu\n", Nsplit);
 
+    if (Nsplit>0)
+        seedCodesCalc(); //SAindex prefixes for all seed starts
+
     resetN(); //reset aligns counters to 0
 
     //reset/initialize a transcript
@@ -94,6 +97,8 @@ int ReadAlign::mapOneRead() {
         };
     };
 
+    scratchPeak.nP=max(scratchPeak.nP, nP);
+
     #ifdef OFF_AFTER_SEEDING
         #warning OFF_AFTER_SEEDING
         return 0;
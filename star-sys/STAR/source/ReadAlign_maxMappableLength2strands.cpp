@@ -30,15 +30,16 @@ uint ReadAlign::maxMappableLength2strands(uint pieceStartIn, uint pieceLengthIn,
         //calculate full index
         uint Lmax=min(P.pGe.gSAindexNbases,pieceLength);
         uint ind1=0;
-        if (dirR) {//forward search
-            pieceStart=pieceStartIn+iDist;
-            for (uint ii=0;ii<Lmax;ii++) {//calculate index TODO: make the index calculation once for the whole read and store it
+        pieceStart = dirR ? pieceStartIn+iDist : pieceStartIn-iDist;
+        if (Lmax<=seedCodeL[iDir][pieceStart]) {//precomputed for the whole read
+            ind1 = seedCode[iDir][pieceStart] >> (2*(P.pGe.gSAindexNbases-Lmax));
+        } else if (dirR) {//forward search
+            for (uint ii=0;ii<Lmax;ii++) {//calculate index
                 ind1 <<=2LLU;
                 ind1 += ((uint) Read1[0][pieceStart+ii]);
             };
         } else {//reverse search
-            pieceStart=pieceStartIn-iDist;
-            for (uint ii=0;ii<Lmax;ii++) {//calculate index TODO: make the index calculation once for the whole read and store it
+            for (uint ii=0;ii<Lmax;ii++) {//calculate index
                 ind1 <<=2LLU;
                 ind1 += ( 3-((uint) Read1[0][pieceStart-ii]) );
             };
@@ -101,7 +102,15 @@ uint ReadAlign::maxMappableLength2strands(uint pieceStartIn, uint pieceLengthIn,
             } else {
                 maxL=0;
             };        
-            Nrep = maxMappableLength(mapGen, Read1.data(), pieceStart, pieceLength, iSA1 & mapGen.SAiMarkNmask, iSA2, dirR, maxL, indStartEnd);
+            uint kB=P.pGe.gSAhashNbases, iSAk1, iSAk2;
+            if (!mapGen.SAhash.empty() && Lind==P.pGe.gSAindexNbases && pieceLength>=kB && iSA2+1>=(iSA1 & mapGen.SAiMarkNmask)+P.pGe.gSAhashRangeMin
+                && mapGen.SAhashFind(seedKmer(pieceStart, dirR, kB), iSAk1, iSAk2)) {//the first kB bases narrow the range
+                maxL = kB;
+                SAhashSearchN++;
+                Nrep = maxMappableLength(mapGen, Read1.data(), pieceStart, pieceLength, iSAk1, iSAk2, dirR, maxL, indStartEnd);
+            } else {
+                Nrep = maxMappableLength(mapGen, Read1.data(), pieceStart, pieceLength, iSA1 & mapGen.SAiMarkNmask, iSA2, dirR, maxL, indStartEnd);
+            };
         };
     #endif
 
@@ -121,3 +130,52 @@ uint ReadAlign::maxMappableLength2strands(uint pieceStartIn, uint pieceLengthIn,
     };
     return Nrep;
 };
+
+void ReadAlign::seedCodesCalc() {
+    //rolling gSAindexNbases-long prefix codes of Read1[0] for the seed starts of maxMappableLength2strands:
+    //forward codes read the bases to the right of each start, reverse codes the complements of the bases to the left
+    uint nB=P.pGe.gSAindexNbases;
+    uint shiftB=2*(nB-1);
+    for (uint iDir=0; iDir<2; iDir++) {
+        if (seedCode[iDir].size()<Lread) {
+            seedCode[iDir].resize(Lread);
+            seedCodeL[iDir].resize(Lread);
+        };
+    };
+
+    uint codeF=0, codeR=0;
+    uint8 LF=0, LR=0;
+    for (uint ii=0; ii<Lread; ii++) {
+        uint bF=(uint) Read1[0][Lread-1-ii], bR=(uint) Read1[0][ii];
+        if (bF<4) {
+            codeF = (codeF>>2) | (bF<<shiftB);
+            LF = min(nB, (uint) LF+1);
+        } else {
+            codeF >>= 2;
+            LF = 0;
+        };
+        if (bR<4) {
+            codeR = (codeR>>2) | ((3-bR)<<shiftB);
+            LR = min(nB, (uint) LR+1);
+        } else {
+            codeR >>= 2;
+            LR = 0;
+        };
+        seedCode[0][Lread-1-ii]=codeF;
+        seedCodeL[0][Lread-1-ii]=LF;
+        seedCode[1][ii]=codeR;
+        seedCodeL[1][ii]=LR;
+    };
+};
+
+uint ReadAlign::seedKmer(uint pieceStart, bool dirR, uint kB) {
+    //2-bit code of the kB bases of Read1[0] from pieceStart, as the SAhash k-mers: to the right, or complementary to the left. -1 if one is N
+    uint kmer=0;
+    for (uint ii=0; ii<kB; ii++) {
+        uint b = (uint) Read1[0][dirR ? pieceStart+ii : pieceStart-ii];
+        if (b>3)
+            return (uint)-1;
+        kmer = (kmer<<2) | (dirR ? b : 3-b);
+    };
+    return kmer;
+};
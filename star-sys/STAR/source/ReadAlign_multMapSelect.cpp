@@ -45,6 +45,8 @@ void ReadAlign::multMapSelect() {//select multiple mappers from all transcripts
         };
     };
 
+    scratchPeak.nTrMult=max(scratchPeak.nTrMult, nTr);
+
     if (nTr > P.outFilterMultimapNmax || nTr==0)
     {//too multi OR no alignments, no need for further processing, since it will be considered unmapped
         return;
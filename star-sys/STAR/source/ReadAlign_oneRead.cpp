@@ -9,6 +9,7 @@ int ReadAlign::oneRead() {//process one read: load, map, write
     int readStatus[2];
 
     readStatus[0] = 0;
+    readNameExtraSAMtags=false;
 
     std::istringstream is(readFastq[0]);
     readStatus[0]=readLoad(is, P, 0, readLength[0], readLengthOriginal[0], readNameMates[0], Read0[0], Read1[0], Qual0[0], Qual1[0], clip3pNtotal[0], clip5pNtotal[0], clip3pAdapterN[0], iReadAll, readFilesIndex, readFilter, readNameExtra[0]);
@@ -24,8 +25,33 @@ int ReadAlign::oneRead() {//process one read: load, map, write
         } else if (readStatus[0]==-1) {//finished with the stream
             return -1;
         };
+    } else if (readStatus[0]==-1) {//finished with the stream
+        return -1;
+    };
+
+    return mapLoadedRead(readStatus[0]);
+};
+
+int ReadAlign::oneReadRaw(const char* const seqs[], const uint seqLens[], const char* const quals[], const uint qualLens[], const char* tags, uint tagsLen) {//process one read given as raw sequence/quality strings: load, map
+    readNameExtraSAMtags=true; //tags are the same for both mates
+    readNameExtra[0].assign(tags, tagsLen);
+    int readStatus=readLoadRaw(seqs[0], seqLens[0], quals[0], qualLens[0], P, 0, readLength[0], readLengthOriginal[0], Read0[0], Read1[0], Qual0[0], Qual1[0], clip3pNtotal[0], clip5pNtotal[0], clip3pAdapterN[0]);
+    if (readStatus<0)
+        return readStatus;
+    if (readNmates==2) {//load the 2nd mate after the 1st one
+        if (readLength[0]+1+seqLens[1]>DEF_readSeqLengthMax)
+            return -1; //the pair does not fit in Read1
+        readNameExtra[1].assign(tags, tagsLen);
+        readStatus=readLoadRaw(seqs[1], seqLens[1], quals[1], qualLens[1], P, 1, readLength[1], readLengthOriginal[1], Read0[1], Read1[0]+readLength[0]+1, Qual0[1], Qual1[0]+readLength[0]+1, clip3pNtotal[1], clip5pNtotal[1], clip3pAdapterN[1]);
+        if (readStatus<0)
+            return readStatus;
+    };
+    return mapLoadedRead(readStatus);
+};
 
-        //combine two reads together
+int ReadAlign::mapLoadedRead(int readFileTypeIn) {//map the read loaded into Read0/Qual0/Read1/Qual1
+    readFilter='N'; //readLoad and readLoadRaw do not get the Illumina filter flag, which would mark the read with 0x200
+    if (readNmates==2) {//combine two reads together
         Lread=readLength[0]+readLength[1]+1;
         readLengthPairOriginal=readLengthOriginal[0]+readLengthOriginal[1]+1;
         if (Lread>DEF_readSeqLengthMax) {
@@ -45,11 +71,6 @@ int ReadAlign::oneRead() {//process one read: load, map, write
         };
 
     } else {//1 mate
-
-        if (readStatus[0]==-1) {//finished with the stream
-            return -1;
-        };
-
         Lread=readLength[0];
         readLengthPairOriginal=readLengthOriginal[0];
         readLength[1]=0;
@@ -58,7 +79,7 @@ int ReadAlign::oneRead() {//process one read: load, map, write
 
     //printf("complementing\n");
 
-    readFileType=readStatus[0];
+    readFileType=readFileTypeIn;
 
     complementSeqNumbers(Read1[0],Read1[1],Lread); //returns complement of Reads[ii]
     //printf("big strong numbers\n");
@@ -2,8 +2,25 @@
 #include "GlobalVariables.h"
 #include "ErrorWarning.h"
 
+uint ReadAlign::outputOneAlign(Transcript const &trOut, uint nTrOut, uint iTrOut, int unmapType, bool *mateMapped) {
+    if (outFormat==OUT_FORMAT_BAM) {
+        uint trChrStart=(unmapType<0 ? mapGen.chrStart[trOut.Chr] : 0);
+        alignBAM(trOut, nTrOut, iTrOut, trChrStart, (uint) -1, (uint) -1, 0, unmapType, mateMapped, P.outSAMattrOrder, outBAMoneAlign.get(), outBAMoneAlignNbytes.get());
+        outBAMrecords.append(outBAMoneAlign[0], outBAMoneAlignNbytes[0]);
+        outBAMrecords.append(outBAMoneAlign[1], outBAMoneAlignNbytes[1]);
+        return outBAMoneAlignNbytes[0]+outBAMoneAlignNbytes[1];
+    };
+    return outputTranscriptSAM(trOut, nTrOut, iTrOut, (uint) -1, (uint) -1, 0, unmapType, mateMapped, outSAMtext);
+};
+
 const char* ReadAlign::outputAlignments() {
+    //returns the SAM text of the alignments, owned by outSAMtext and valid until the next read, or NULL for OUT_FORMAT_BAM which stores them in outBAMrecords
     outBAMbytes=0;
+    if (outFormat==OUT_FORMAT_SAM) {
+        outSAMtext.clear();
+    } else if (outFormat==OUT_FORMAT_BAM) {
+        outBAMrecords.clear();
+    };
 
     bool mateMapped[2]={false,false};
 
@@ -11,8 +28,6 @@ const char* ReadAlign::outputAlignments() {
     vector<uint32> readTranscripts={};
     vector<int32> readGeneExon={};
 
-    std::stringstream stream;
-
     outFilterPassed=true;//only false if the alignment is held for outFilterBySJoutStage
     if (unmapType==-1) {//output transcripts
         if (P.outFilterBySJoutStage==1) {//filtering by SJout
@@ -101,10 +116,10 @@ const char* ReadAlign::outputAlignments() {
 
                 if (P.outSAMbool && outSAMfilterYes) {//SAM output
                     //printf("samout\n");
-                    outBAMbytes+=outputTranscriptSAM(*(trMult[iTr]), nTr, iTr, (uint) -1, (uint) -1, 0, -1, NULL, &stream);
+                    outBAMbytes+=outputOneAlign(*(trMult[iTr]), nTr, iTr, -1, NULL);
                     if (P.outSAMunmapped.keepPairs && readNmates>1 && ( !mateMapped1[0] || !mateMapped1[1] ) ) {//keep pairs && paired reads && one of the mates not mapped in this transcript
                         //printf("samout no null\n");
-                        outBAMbytes+= outputTranscriptSAM(*(trMult[iTr]), 0, 0, (uint) -1, (uint) -1, 0, 4, mateMapped1, &stream);
+                        outBAMbytes+= outputOneAlign(*(trMult[iTr]), 0, 0, 4, mateMapped1);
                     };
                 };
             };
@@ -119,7 +134,7 @@ const char* ReadAlign::outputAlignments() {
 
             if (unmapType==4 && P.outSAMunmapped.yes) {//output unmapped end for single-end alignments
                 if (P.outSAMbool && !P.outSAMunmapped.keepPairs && outSAMfilterYes) {
-                    outBAMbytes+= outputTranscriptSAM(*trBest, 0, 0, (uint) -1, (uint) -1, 0, unmapType, mateMapped, &stream);
+                    outBAMbytes+= outputOneAlign(*trBest, 0, 0, unmapType, mateMapped);
                 };
             };
 
@@ -136,7 +151,7 @@ const char* ReadAlign::outputAlignments() {
 
             //transcripts
             if ( P.quant.trSAM.yes ) {//NOTE: the transcripts are changed by this function (soft-clipping extended), cannot be reused
-                quantTranscriptome(chunkTr, nTrOut, trMult,  alignTrAll.get(), readTranscripts, readGene);
+                quantTranscriptome(chunkTr, nTrOut, trMult.get(),  alignTrAll.get(), readTranscripts, readGene);
             };
 
         };
@@ -146,19 +161,16 @@ const char* ReadAlign::outputAlignments() {
 
     if ( P.outSAMunmapped.within && unmapType>=0 && unmapType<4 ) {//output unmapped within && unmapped read && both mates unmapped
         if (P.outSAMbool) {//output SAM
-            outBAMbytes+= outputTranscriptSAM(*trBest, 0, 0, (uint) -1, (uint) -1, 0, unmapType, mateMapped, &stream);
+            outBAMbytes+= outputOneAlign(*trBest, 0, 0, unmapType, mateMapped);
             //printf("how about here?\n");
         };
     };
 
-    std::stringbuf * pbuf = stream.rdbuf();
-    std::streamsize size = pbuf->pubseekoff(0,stream.end);
-    pbuf->pubseekoff(0,stream.beg);  
-    char *contents = (char*)malloc(size+1);
-    pbuf->sgetn (contents,size);
-    contents[size] = '\0';
+    if (outFormat!=OUT_FORMAT_SAM) {
+        return NULL;
+    };
 
-    return contents;
+    return outSAMtext.c_str();
 };
 
 
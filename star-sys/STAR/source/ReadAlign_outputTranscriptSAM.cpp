@@ -1,12 +1,14 @@
 #include "ReadAlign.h"
 #include "SequenceFuns.h"
 #include "ErrorWarning.h"
+#include "SAMtext.h"
 
-uint ReadAlign::outputTranscriptSAM(Transcript const &trOut, uint nTrOut, uint iTrOut, uint mateChr, uint mateStart, char mateStrand, int unmapType, bool *mateMapped, ostream *outStream) {
+uint ReadAlign::outputTranscriptSAM(Transcript const &trOut, uint nTrOut, uint iTrOut, uint mateChr, uint mateStart, char mateStrand, int unmapType, bool *mateMapped, string &outText) {
 
     if (P.outSAMmode=="None") return 0; //no SAM output
 
-    uint outStreamPos0=(uint)outStream->tellp();
+    SAMtext outSAM(outText);
+    uint outTextPos0=outText.size();
 
     if (unmapType>=0)
     {//unmapped reads: SAM
@@ -37,29 +39,33 @@ uint ReadAlign::outputTranscriptSAM(Transcript const &trOut, uint nTrOut, uint i
                 {//mapped mate is not primary, keep unmapped mate for each pair, hence need to mark some as not primary
                     samFLAG|=0x100;
                 };
-                *outStream << readName+1 <<"\t"<< samFLAG \
-                        <<"\t"<< '*' <<"\t"<< '0' <<"\t"<< '0' <<"\t"<< '*';
+                outSAM << readName+1 <<'\t'<< samFLAG <<"\t*\t0\t0\t*";
                 if (mateMapped[1-imate]) {//mate is mapped
-                    *outStream <<"\t"<< mapGen.chrName[trOut.Chr] <<"\t"<< trOut.exons[0][EX_G] + 1 - mapGen.chrStart[trOut.Chr];
+                    outSAM <<'\t'<< mapGen.chrName[trOut.Chr] <<'\t'<< trOut.exons[0][EX_G] + 1 - mapGen.chrStart[trOut.Chr];
                 } else {
-                    *outStream <<"\t"<< '*' <<"\t"<< '0';
+                    outSAM <<"\t*\t0";
                 };
-                *outStream <<"\t"<< '0' <<"\t"<< Read0[imate] <<"\t"<< (readFileType==2 ? Qual0[imate]:"*") \
-                        <<"\tNH:i:0" <<"\tHI:i:0" <<"\tAS:i:"<<trOut.maxScore <<"\tnM:i:"<<trOut.nMM<<"\tuT:A:" <<unmapType;
-                if (!P.outSAMattrRG.empty()) *outStream<< "\tRG:Z:" <<P.outSAMattrRG.at(readFilesIndex);
-                if (P.readFilesTypeN==10 && !readNameExtra[imate].empty()) {//SAM files as input - output extra attributes
-                    *outStream << "\t" <<readNameExtra[imate];
+                outSAM <<"\t0\t";
+                outSAM.append(Read0[imate], readLengthOriginal[imate]) <<'\t';
+                if (readFileType==2) {
+                    outSAM.append(Qual0[imate], readLengthOriginal[imate]);
+                } else {
+                    outSAM <<'*';
+                };
+                outSAM <<"\tNH:i:0\tHI:i:0\tAS:i:"<<trOut.maxScore <<"\tnM:i:"<<trOut.nMM<<"\tuT:A:" <<unmapType;
+                if (!P.outSAMattrRG.empty()) outSAM<< "\tRG:Z:" <<P.outSAMattrRG.at(readFilesIndex);
+                if ((P.readFilesTypeN==10 || readNameExtraSAMtags) && !readNameExtra[imate].empty()) {//SAM files as input, or tags from the caller - output extra attributes
+                    outSAM << '\t' <<readNameExtra[imate];
                 };
-                *outStream <<"\n";
+                outSAM <<'\n';
 
             };
         };
-        return (uint)outStream->tellp()-outStreamPos0;
-    };//if (unmapType>=0 && outStream != NULL) //unmapped reads: SAM
+        return outText.size()-outTextPos0;
+    };//if (unmapType>=0) //unmapped reads: SAM
 
 
     bool flagPaired = readNmates==2;
-    string CIGAR;
 
     //for SAM output need to split mates
     uint iExMate; //last exon of the first mate
@@ -129,12 +135,6 @@ uint ReadAlign::outputTranscriptSAM(Transcript const &trOut, uint nTrOut, uint i
         //not primary align?
         if (!trOut.primaryFlag) samFLAG|=0x100;
 
-        //empty streams
-        samStreamCIGAR.str(std::string());
-        samStreamSJmotif.str(std::string());
-        samStreamSJintron.str(std::string());
-//         samStreamSJannot.str(std::string());
-
         uint trimL;
         if (Str==0 && Mate==0) {
             trimL=clip5pNtotal[Mate];
@@ -146,9 +146,26 @@ uint ReadAlign::outputTranscriptSAM(Transcript const &trOut, uint nTrOut, uint i
             trimL=clip5pNtotal[Mate];
         };
 
+        int MAPQ=P.outSAMmapqUnique;
+        if (nTrOut>=5) {
+            MAPQ=0;
+        } else if (nTrOut>=3) {
+            MAPQ=1;
+        } else if (nTrOut==2) {
+            MAPQ=3;
+        };
+
+        outSAM << readName+1 <<'\t'<< ((samFLAG & P.outSAMflagAND) | P.outSAMflagOR) <<'\t'<< mapGen.chrName[trOut.Chr] <<'\t'<< trOut.exons[iEx1][EX_G] + 1 - mapGen.chrStart[trOut.Chr]
+                <<'\t'<< MAPQ <<'\t';
+
+        //CIGAR, written in place, while recording junctions for jM jI
+        samSJmotif.clear();
+        samSJintron.clear();
+        SAMtext outSJmotif(samSJmotif), outSJintron(samSJintron);
+
         uint trimL1 = trimL + trOut.exons[iEx1][EX_R] - (trOut.exons[iEx1][EX_R]<readLength[leftMate] ? 0 : readLength[leftMate]+1);
         if (trimL1>0) {
-            samStreamCIGAR << trimL1 << "S"; //initial trimming
+            outSAM << trimL1 << 'S'; //initial trimming
         };
 
         for (uint ii=iEx1;ii<=iEx2;ii++) {
@@ -157,95 +174,67 @@ uint ReadAlign::outputTranscriptSAM(Transcript const &trOut, uint nTrOut, uint i
                 uint gapR=trOut.exons[ii][EX_R]-trOut.exons[ii-1][EX_R]-trOut.exons[ii-1][EX_L];
                 //it's possible to have a D or N and I at the same time
                 if (gapR>0){
-                    samStreamCIGAR << gapR;
-                    samStreamCIGAR << "I";
+                    outSAM << gapR << 'I';
                 };
                 if (trOut.canonSJ[ii-1]>=0 || trOut.sjAnnot[ii-1]==1) {//junction: N
-                    samStreamCIGAR << gapG;
-                    samStreamCIGAR << "N";
-                    samStreamSJmotif <<','<< trOut.canonSJ[ii-1] + (trOut.sjAnnot[ii-1]==0 ? 0 : SJ_SAM_AnnotatedMotifShift); //record junction type
-//                     samStreamSJannot <<','<< (int) trOut.sjAnnot[ii-1]; //record annotation type
-                    samStreamSJintron <<','<< trOut.exons[ii-1][EX_G] + trOut.exons[ii-1][EX_L] + 1 - mapGen.chrStart[trOut.Chr] <<','\
+                    outSAM << gapG << 'N';
+                    outSJmotif <<','<< trOut.canonSJ[ii-1] + (trOut.sjAnnot[ii-1]==0 ? 0 : SJ_SAM_AnnotatedMotifShift); //record junction type
+                    outSJintron <<','<< trOut.exons[ii-1][EX_G] + trOut.exons[ii-1][EX_L] + 1 - mapGen.chrStart[trOut.Chr] <<','\
                                    << trOut.exons[ii][EX_G] - mapGen.chrStart[trOut.Chr]; //record intron loci
                 } else if (gapG>0) {//deletion: N
-                    samStreamCIGAR << gapG;
-                    samStreamCIGAR << "D";
+                    outSAM << gapG << 'D';
                 };
             };
-            samStreamCIGAR << trOut.exons[ii][EX_L] << "M";
+            outSAM << trOut.exons[ii][EX_L] << 'M';
         };
 
-        string SJmotif = samStreamSJmotif.str();
-        string SJintron = samStreamSJintron.str();
-//         string SJannot = samStreamSJannot.str();
-
-        if (SJmotif.length()==0) {//no junctions recorded, mark with -1
-            SJmotif=",-1";
-            SJintron=",-1";
-//             SJannot=",-1";
+        if (samSJmotif.empty()) {//no junctions recorded, mark with -1
+            outSJmotif << ",-1";
+            outSJintron << ",-1";
         };
 
-        //printf("weird trimming time  %llu %llu %llu %llu %llu %llu\n", trOut.exons[iEx1][EX_R], readLength[leftMate], readLengthOriginal[Mate], trOut.exons[iEx2][EX_R], trOut.exons[iEx2][EX_L], trimL);
         uint trimR1=(trOut.exons[iEx1][EX_R]<readLength[leftMate] ? \
             readLengthOriginal[leftMate] : readLength[leftMate]+1+readLengthOriginal[Mate]) \
             - trOut.exons[iEx2][EX_R]-trOut.exons[iEx2][EX_L] - trimL;
         if ( trimR1 > 0 ) {
-            samStreamCIGAR << trimR1 << "S"; //final trimming
+            outSAM << trimR1 << 'S'; //final trimming
         };
-        CIGAR=samStreamCIGAR.str();
-
-
-        char seqMate[DEF_readSeqLengthMax+1], qualMate[DEF_readSeqLengthMax+1];
-        char *seqOut=NULL, *qualOut=NULL;
-
-        if ( Mate==Str )  {//seq strand is correct
-            seqOut=Read0[Mate];
-            qualOut=Qual0[Mate];
-        } else {
-            revComplementNucleotides(Read0[Mate], seqMate, readLengthOriginal[Mate]);
-            seqMate[readLengthOriginal[Mate]]=0;
-            for (uint ii=0;ii<readLengthOriginal[Mate]; ii++) qualMate[ii]=Qual0[Mate][readLengthOriginal[Mate]-1-ii];
-            qualMate[readLengthOriginal[Mate]]=0;
-            seqOut=&seqMate[0];
-            qualOut=&qualMate[0];
-        };
-
-//         return;
-
-        int MAPQ=P.outSAMmapqUnique;
-        if (nTrOut>=5) {
-            MAPQ=0;
-        } else if (nTrOut>=3) {
-            MAPQ=1;
-        } else if (nTrOut==2) {
-            MAPQ=3;
-        };
-
-        *outStream << readName+1 <<"\t"<< ((samFLAG & P.outSAMflagAND) | P.outSAMflagOR) <<"\t"<< mapGen.chrName[trOut.Chr] <<"\t"<< trOut.exons[iEx1][EX_G] + 1 - mapGen.chrStart[trOut.Chr]
-                <<"\t"<< MAPQ <<"\t"<< CIGAR;
 
         if (nMates>1) {
-            *outStream <<"\t"<< "=" <<"\t"<< trOut.exons[(imate==0 ? iExMate+1 : 0)][EX_G]+  1 - mapGen.chrStart[trOut.Chr]
-                     <<"\t"<< (imate==0? "":"-") << trOut.exons[trOut.nExons-1][EX_G]+trOut.exons[trOut.nExons-1][EX_L]-trOut.exons[0][EX_G];
+            outSAM <<"\t=\t"<< trOut.exons[(imate==0 ? iExMate+1 : 0)][EX_G]+  1 - mapGen.chrStart[trOut.Chr]
+                     <<'\t'<< (imate==0? "":"-") << trOut.exons[trOut.nExons-1][EX_G]+trOut.exons[trOut.nExons-1][EX_L]-trOut.exons[0][EX_G];
         } else if (mateChr<mapGen.nChrReal){//mateChr is given in the function parameters
-            *outStream <<"\t"<< mapGen.chrName[mateChr] <<"\t"<< mateStart+1-mapGen.chrStart[mateChr] <<"\t"<< 0;
+            outSAM <<'\t'<< mapGen.chrName[mateChr] <<'\t'<< mateStart+1-mapGen.chrStart[mateChr] <<"\t0";
         } else {
-            *outStream <<"\t"<< "*" <<"\t"<< 0 <<"\t"<< 0;
+            outSAM <<"\t*\t0\t0";
         };
 
+        //sequence and qualities, reverse-complemented into the output if the seq strand is not correct
+        uint Lmate=readLengthOriginal[Mate];
+        outSAM <<'\t';
+        if ( Mate==Str )  {//seq strand is correct
+            outSAM.append(Read0[Mate], Lmate);
+        } else {
+            revComplementNucleotides(Read0[Mate], outSAM.extend(Lmate), Lmate);
+        };
 
-        *outStream <<"\t"<< seqOut;
-
+        outSAM <<'\t';
         if (readFileType==2 && P.outSAMmode != "NoQS") {//fastq
-            *outStream <<"\t"<< qualOut ;
+            if ( Mate==Str ) {
+                outSAM.append(Qual0[Mate], Lmate);
+            } else {
+                char *qualOut=outSAM.extend(Lmate);
+                for (uint ii=0;ii<Lmate; ii++) qualOut[ii]=Qual0[Mate][Lmate-1-ii];
+            };
         } else {
-            *outStream <<"\t"<< "*";
+            outSAM <<'*';
         };
 
 //         vector<string> customAttr(outSAMattrN,"");
 
         uint tagNM=0;
-        string tagMD("");
+        samMD.clear();
+        SAMtext tagMD(samMD);
         if (P.outSAMattrPresent.NM || P.outSAMattrPresent.MD) {
             char* R=Read1[trOut.roStr==0 ? 0:2];
             uint matchN=0;
@@ -256,9 +245,9 @@ uint ReadAlign::outputTranscriptSAM(Transcript const &trOut, uint nTrOut, uint i
                     if ( r1!=g1 || r1==4 || g1==4) {
                         ++tagNM;
 //                         if (matchN>0 || (ii==0 && iex>0 && trOut.canonSJ[iex]==-1) ) {
-                        tagMD+=to_string(matchN);
+                        tagMD << matchN;
 //                         };
-                        tagMD+=P.genomeNumToNT[(uint8) g1];
+                        tagMD << P.genomeNumToNT[(uint8) g1];
                         matchN=0;
                     } else {
                         matchN++;
@@ -267,9 +256,9 @@ uint ReadAlign::outputTranscriptSAM(Transcript const &trOut, uint nTrOut, uint i
                 if (iex<iEx2) {
                     if (trOut.canonSJ[iex]==-1) {//deletion
                         tagNM+=trOut.exons[iex+1][EX_G]-(trOut.exons[iex][EX_G]+trOut.exons[iex][EX_L]);
-                        tagMD+=to_string(matchN) + "^";
+                        tagMD << matchN << '^';
                         for (uint ii=trOut.exons[iex][EX_G]+trOut.exons[iex][EX_L];ii<trOut.exons[iex+1][EX_G];ii++) {
-                            tagMD+=P.genomeNumToNT[(uint8) mapGen.G[ii]];
+                            tagMD << P.genomeNumToNT[(uint8) mapGen.G[ii]];
                         };
                         matchN=0;
                     } else if (trOut.canonSJ[iex]==-2) {//insertion
@@ -277,48 +266,48 @@ uint ReadAlign::outputTranscriptSAM(Transcript const &trOut, uint nTrOut, uint i
                     };
                 };
             };
-            tagMD+=to_string(matchN);
+            tagMD << matchN;
         };
 
         for (uint ii=0;ii<P.outSAMattrOrder.size();ii++) {
             switch (P.outSAMattrOrder[ii]) {
                 case ATTR_NH:
-                    *outStream <<"\tNH:i:" << nTrOut;
+                    outSAM <<"\tNH:i:" << nTrOut;
                     break;
                 case ATTR_HI:
-                    *outStream <<"\tHI:i:"<<iTrOut+P.outSAMattrIHstart;
+                    outSAM <<"\tHI:i:"<<iTrOut+P.outSAMattrIHstart;
                     break;
                 case ATTR_AS:
-                    *outStream<<"\tAS:i:"<<trOut.maxScore;
+                    outSAM<<"\tAS:i:"<<trOut.maxScore;
                     break;
                 case ATTR_nM:
-                    *outStream<<"\tnM:i:"<<trOut.nMM;
+                    outSAM<<"\tnM:i:"<<trOut.nMM;
                     break;
                 case ATTR_jM:
-                    *outStream<<"\tjM:B:c"<< SJmotif;
+                    outSAM<<"\tjM:B:c"<< samSJmotif;
                     break;
                 case ATTR_jI:
-                    *outStream<<"\tjI:B:i"<< SJintron;
+                    outSAM<<"\tjI:B:i"<< samSJintron;
                     break;
                 case ATTR_XS:
                     if (trOut.sjMotifStrand==1) {
-                        *outStream<<"\tXS:A:+";
+                        outSAM<<"\tXS:A:+";
                     } else if (trOut.sjMotifStrand==2) {
-                        *outStream<<"\tXS:A:-";
+                        outSAM<<"\tXS:A:-";
                     };
                     break;
                 case ATTR_NM:
-                    *outStream<< "\tNM:i:" <<tagNM;
+                    outSAM<< "\tNM:i:" <<tagNM;
                     break;
                 case ATTR_MD:
-                    *outStream<< "\tMD:Z:" <<tagMD;
+                    outSAM<< "\tMD:Z:" <<samMD;
                     break;
                 case ATTR_RG:
-                    *outStream<< "\tRG:Z:" <<P.outSAMattrRG.at(readFilesIndex);
+                    outSAM<< "\tRG:Z:" <<P.outSAMattrRG.at(readFilesIndex);
                     break;
                 case ATTR_MC:
                     if (nMates>1) {
-                        *outStream<< "\tMC:Z:" <<matesCIGAR[1-imate];
+                        outSAM<< "\tMC:Z:" <<matesCIGAR[1-imate];
                     };
                     break;
                 case ATTR_ch:
@@ -332,12 +321,12 @@ uint ReadAlign::outputTranscriptSAM(Transcript const &trOut, uint nTrOut, uint i
             };
         };
 
-        if (P.readFilesTypeN==10 && !readNameExtra[imate].empty()) {//SAM files as input - output extra attributes
-             *outStream << "\t" << readNameExtra.at(imate);
+        if ((P.readFilesTypeN==10 || readNameExtraSAMtags) && !readNameExtra[imate].empty()) {//SAM files as input, or tags from the caller - output extra attributes
+             outSAM << "\t" << readNameExtra.at(imate);
         };
 
-        *outStream << "\n"; //done with one SAM line
+        outSAM << "\n"; //done with one SAM line
     };//for (uint imate=0;imate<nMates;imate++)
 
-    return (uint)outStream->tellp()-outStreamPos0;
+    return outText.size()-outTextPos0;
 };
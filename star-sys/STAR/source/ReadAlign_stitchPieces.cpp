@@ -290,12 +290,13 @@ std::time(&timeStart);
         trA.roStr = revertStrand ? 1-trA.Str : trA.Str; //original strand of the read
         trA.maxScore=0;
         //printf("something something trAll %llu\n", trNtotal);
-        trAll[iW1]=trArrayPointer.get()+trNtotal;
         if (trNtotal+P.alignTranscriptsPerWindowNmax >= P.alignTranscriptsPerReadNmax) {
             P.inOut->logMain << "WARNING: not enough space allocated for transcript. Did not process all windows for read "<< readName+1 <<endl;
             P.inOut->logMain <<"   SOLUTION: increase alignTranscriptsPerReadNmax and re-run\n" << flush;
             break;
         };
+        growTranscripts(trNtotal+P.alignTranscriptsPerWindowNmax+1, iW1); //stitchWindowAligns uses one transcript past the recorded ones
+        trAll[iW1]=trArrayPointer.get()+trNtotal;
         //printf("trA %llu\n", trA.Chr);
         *(trAll[iW1][0])=trA;
         nWinTr[iW1]=0; //initialize number of transcripts per window
@@ -338,6 +339,8 @@ std::time(&timeStart);
     };
 
     nW=iW1;//only count windows that had alignments
+    scratchPeak.nW=max(scratchPeak.nW, nWall);
+    scratchPeak.nTr=max(scratchPeak.nTr, trNtotal);
 
 //     {//debug
 //         std::time(&timeFinish);
@@ -37,18 +37,18 @@ void ReadAlign::storeAligns (uint iDir, uint Shift, uint Nrep, uint L, uint indS
     };
 
     iP=iP+1; //this is the insertion place
-    for (int ii=nP-1;ii>=iP;ii--) {//move old entries to free space for the new one
-        for (int jj=0;jj<PC_SIZE;jj++) PC[ii+1][jj]=PC[ii][jj];
-    };
-
-    nP++; //now nP is the new number of elements
-//
-    if (nP > P.seedPerReadNmax) {
+    if (nP == P.seedPerReadNmax) {//check before the new entry is written past the last one
         ostringstream errOut;
         errOut <<"EXITING because of FATAL error: too many pieces pere read\n" ;
         errOut <<"SOLUTION: increase input parameter --seedPerReadNmax";
         exitWithError(errOut.str(),std::cerr, P.inOut->logMain, EXIT_CODE_RUNTIME, P);
     };
+    growPieces(nP+1);
+    for (int ii=nP-1;ii>=iP;ii--) {//move old entries to free space for the new one
+        for (int jj=0;jj<PC_SIZE;jj++) PC[ii+1][jj]=PC[ii][jj];
+    };
+
+    nP++; //now nP is the new number of elements
   #else
 //     int iP3;
 //     for (iP3=nP-1; iP3>=0; iP3--) {
@@ -112,6 +112,7 @@ void ReadAlign::storeAligns (uint iDir, uint Shift, uint Nrep, uint L, uint indS
             errOut <<"SOLUTION: increase input parameter --seedPerReadNmax";
             exitWithError(errOut.str(),std::cerr, P.inOut->logMain, EXIT_CODE_RUNTIME, P);
         };
+        growPieces(nP+1);
         for (int ii=nP-1;ii>=iP;ii--) {//move old entries to free space for the new one
             for (int jj=0;jj<PC_SIZE;jj++) PC[ii+1][jj]=PC[ii][jj];
         };
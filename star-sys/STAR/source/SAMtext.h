@@ -0,0 +1,44 @@
+#ifndef H_SAMtext
+#define H_SAMtext
+
+#include "IncludeDefine.h"
+#include <charconv>
+#include <type_traits>
+
+class SAMtext {//append-only SAM text writer into a string, formats integers with to_chars instead of ostream
+    public:
+        string &buf;
+
+        explicit SAMtext(string &bufIn) : buf(bufIn) {};
+
+        inline SAMtext& operator<<(char c) {
+            buf.push_back(c);
+            return *this;
+        };
+        inline SAMtext& operator<<(const char *s) {
+            buf.append(s);
+            return *this;
+        };
+        inline SAMtext& operator<<(const string &s) {
+            buf.append(s);
+            return *this;
+        };
+        template <typename T, typename std::enable_if<std::is_integral<T>::value && !std::is_same<T,char>::value, int>::type = 0>
+        inline SAMtext& operator<<(T x) {
+            char s[24];
+            buf.append(s, std::to_chars(s, s+sizeof(s), x).ptr-s);
+            return *this;
+        };
+
+        inline SAMtext& append(const char *s, uint n) {//copy n chars, e.g. sequences and qualities with known lengths
+            buf.append(s, n);
+            return *this;
+        };
+        inline char* extend(uint n) {//grow by n chars, returns the start of the new chars to be filled in by the caller
+            size_t n0=buf.size();
+            buf.resize(n0+n);
+            return &buf[n0];
+        };
+};
+
+#endif
@@ -0,0 +1,130 @@
+/*
+ * Software pipeline over the reads of align_reads_batch
+ *
+ * The seed search of a read is a chain of dependent cache misses: the SAi entry of the seed prefix gives the SA
+ * range, whose entries give the genome positions to compare the read to. Each pushed read goes through three
+ * stages, SEED_prefetchStageReads reads apart: the SAi entries of its first seeds are prefetched, then their SA range
+ * ends and medians, then the genome at these SA entries. The read is mapped SEED_prefetchStageReads reads after
+ * its last stage, when maxMappableLength2strands finds these addresses in the cache. Only the first seed of each
+ * seedSearchStartLmax start is known before mapping, the later ones depend on the mapped lengths
+ */
+#include "SeedPrefetch.h"
+
+SeedPrefetch::SeedPrefetch(const Parameters &Pin, const Genome &genomeIn) : P(Pin), mapGen(genomeIn)
+{
+    reads.resize(SEED_prefetchStageReads*SEED_prefetchStagesN);
+    clear();
+};
+
+void SeedPrefetch::clear()
+{
+    for (auto &rs : reads)
+        rs.nSeeds=0;
+    iPush=0;
+};
+
+void SeedPrefetch::push(uint nMates, const char* const seqs[], const size_t seqLens[])
+{
+    uint nR=reads.size();
+    stageG(reads[(iPush+nR-2*SEED_prefetchStageReads)%nR]);
+    stageSA(reads[(iPush+nR-SEED_prefetchStageReads)%nR]);
+    stageSAi(reads[iPush%nR], nMates, seqs, seqLens);
+    iPush++;
+};
+
+static inline void prefetchPacked(const PackedArray &pa, uint ii)
+{//the word ii of a PackedArray
+    __builtin_prefetch(pa.charArray+ii*pa.wordLength/8);
+};
+
+void SeedPrefetch::stageSAi(ReadSeeds &rs, uint nMates, const char* const seqs[], const size_t seqLens[])
+{//SAi entries of the gSAindexNbases prefixes at the seed starts of mapOneRead, taking each mate as one good piece
+    rs.nSeeds=0;
+    if (nMates==0)
+        return;
+    uint nB=P.pGe.gSAindexNbases;
+    uint Lread=nMates==2 ? seqLens[0]+seqLens[1]+1 : seqLens[0];
+    uint seedSearchStartLmax=min(P.seedSearchStartLmax, (uint) (P.seedSearchStartLmaxOverLread*(Lread-1)));
+
+    for (uint im=0; im<nMates; im++) {
+        uint Lpiece=seqLens[im];
+        if (Lpiece<nB)
+            continue;
+        auto base = [&](uint ii) {//mate 2 is reverse-complemented, as in Read1
+            char b=im==0 ? seqs[0][ii] : seqs[1][Lpiece-1-ii];
+            uint b1;
+            switch (b) {
+                case 'A': case 'a': b1=0; break;
+                case 'C': case 'c': b1=1; break;
+                case 'G': case 'g': b1=2; break;
+                case 'T': case 't': b1=3; break;
+                default: return (uint) 4;
+            };
+            return im==0 ? b1 : 3-b1;
+        };
+
+        uint Nstart = P.seedSearchStartLmax>0 && seedSearchStartLmax<Lpiece ? Lpiece/seedSearchStartLmax+1 : 1;
+        uint Lstart = Lpiece/Nstart;
+        for (uint istart=0; istart<Nstart; istart++) {
+            for (uint iDir=0; iDir<2; iDir++) {
+                uint start = iDir==0 ? istart*Lstart : Lpiece-1-istart*Lstart;
+                if (rs.nSeeds==SEED_prefetchSeedsMax || (iDir==0 ? start+nB>Lpiece : start+1<nB))
+                    continue;
+                uint ind1=0, ii=0;
+                for (; ii<nB; ii++) {
+                    uint b1 = iDir==0 ? base(start+ii) : base(start-ii);
+                    if (b1>3)
+                        break;
+                    ind1 = (ind1<<2) + (iDir==0 ? b1 : 3-b1);
+                };
+                if (ii<nB)
+                    continue; //the seed search will shorten the prefix
+                Seed &seed=rs.seeds[rs.nSeeds++];
+                seed.iSAi=mapGen.genomeSAindexStart[nB-1]+ind1;
+                prefetchPacked(mapGen.SAi, seed.iSAi);
+            };
+        };
+    };
+};
+
+void SeedPrefetch::stageSA(ReadSeeds &rs)
+{//SA range of each prefix, as in maxMappableLength2strands, and the first entries maxMappableLength compares to
+    uint nS=0;
+    for (uint is=0; is<rs.nSeeds; is++) {
+        Seed seed=rs.seeds[is];
+        uint iSA1=mapGen.SAi[seed.iSAi];
+        if ((iSA1 & mapGen.SAiMarkAbsentMaskC) != 0)
+            continue; //the prefix is absent, the seed search will shorten it
+        seed.iSA1=iSA1 & mapGen.SAiMarkNmask;
+        seed.iSA2=mapGen.nSA-1;
+        if (seed.iSAi+1 < mapGen.genomeSAindexStart[P.pGe.gSAindexNbases]) {
+            uint iSA2=mapGen.SAi[seed.iSAi+1];
+            if ((iSA2 & mapGen.SAiMarkAbsentMaskC) == 0)
+                seed.iSA2=(iSA2 & mapGen.SAiMarkNmask) - 1;
+        };
+        if (seed.iSA2<seed.iSA1)
+            continue;
+        prefetchPacked(mapGen.SA, seed.iSA1);
+        prefetchPacked(mapGen.SA, seed.iSA2);
+        prefetchPacked(mapGen.SA, (seed.iSA1+seed.iSA2)/2);
+        rs.seeds[nS++]=seed;
+    };
+    rs.nSeeds=nS;
+};
+
+void SeedPrefetch::stageG(ReadSeeds &rs)
+{//genome after the prefix at the SA entries of stageSA, on either strand, as in compareSeqToGenome
+    uint nB=P.pGe.gSAindexNbases;
+    for (uint is=0; is<rs.nSeeds; is++) {
+        const Seed &seed=rs.seeds[is];
+        for (uint iSA : {seed.iSA1, seed.iSA2, (seed.iSA1+seed.iSA2)/2}) {
+            uint SAstr=mapGen.SA[iSA];
+            if ((SAstr>>mapGen.GstrandBit) == 0) {
+                __builtin_prefetch(mapGen.G+SAstr+nB);
+            } else {
+                __builtin_prefetch(mapGen.G+mapGen.nGenome-1-(SAstr & mapGen.GstrandMask)-nB);
+            };
+        };
+    };
+    rs.nSeeds=0;
+};
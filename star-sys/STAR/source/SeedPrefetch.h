@@ -0,0 +1,37 @@
+#ifndef CODE_SeedPrefetch
+#define CODE_SeedPrefetch
+
+#include "IncludeDefine.h"
+#include "Parameters.h"
+#include "Genome.h"
+
+#include <array>
+#include <vector>
+
+class SeedPrefetch {//prefetches the SAi, SA and G addresses of the first seeds of reads that will be mapped later, one stage at a time
+    public:
+        SeedPrefetch(const Parameters &Pin, const Genome &genomeIn);
+        void push(uint nMates, const char* const seqs[], const size_t seqLens[]); //add the next read, nMates=0 for none, and advance the earlier reads one stage
+        void clear(); //drop all reads
+
+    private:
+        const Parameters &P;
+        const Genome &mapGen;
+
+        struct Seed {
+            uint iSAi; //SAi entry of the prefix
+            uint iSA1, iSA2; //SA range of the prefix, from SAi
+        };
+        struct ReadSeeds {
+            uint nSeeds;
+            std::array<Seed, SEED_prefetchSeedsMax> seeds;
+        };
+        std::vector<ReadSeeds> reads; //ring of the reads being prefetched, SEED_prefetchStageReads*SEED_prefetchStagesN of them
+        uint iPush; //number of reads pushed
+
+        void stageSAi(ReadSeeds &rs, uint nMates, const char* const seqs[], const size_t seqLens[]);
+        void stageSA(ReadSeeds &rs);
+        void stageG(ReadSeeds &rs);
+};
+
+#endif
@@ -6,6 +6,9 @@
 
 #include "IncludeDefine.h"
 
+#include <array>
+#include <vector>
+
 void complementSeqNumbers(char*, char*, uint);
 void convertNucleotidesToNumbers(const char* R0, char* R1, const uint Lread);
 uint convertNucleotidesToNumbersRemoveControls(const char* R0, char* R1, const uint Lread);
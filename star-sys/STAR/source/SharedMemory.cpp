@@ -10,6 +10,7 @@
 #include <fcntl.h>           /* For O_* constants */
 #include <semaphore.h>
 #include <errno.h>
+#include <unistd.h>
 
 #ifdef COMPILE_FOR_MAC
   //some Mac's idiosyncrasies: standard SHM libraries are very old and missing some definitions
@@ -72,15 +73,16 @@ void SharedMemory::Allocate(size_t shmSize)
         ThrowError(EALREADYALLOCATED);
 
     CreateAndInitSharedObject(shmSize);
+    bool created = !_exception.HasError();
 
-    if (_exception.HasError() && _exception.GetErrorCode() != EEXISTS)
+    if (!created && _exception.GetErrorCode() != EEXISTS)
         throw _exception;
 
     _exception.ClearError(); // someone else came in first so retry open
 
     OpenIfExists();
 
-    _isAllocator = true;
+    _isAllocator = created; // only the creator fills the segment, the others wait for it
 }
 
 string SharedMemory::GetPosixObjectKey()
@@ -168,8 +170,15 @@ void SharedMemory::MapSharedObjectToMemory()
 {
 #ifdef POSIX_SHARED_MEM
     size_t size=0;
-    struct stat buf = SharedMemory::GetSharedObjectInfo();
-    size = (size_t) buf.st_size;
+    for (int iwait=0; size==0 && iwait<1000; iwait++)
+    {// the creator sizes the object right after creating it
+        if (iwait>0)
+            usleep(1000);
+        struct stat buf = SharedMemory::GetSharedObjectInfo();
+        size = (size_t) buf.st_size;
+    }
+    if (size==0)
+        ThrowError(EMAPFAILED, EAGAIN);
     _mapped = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_NORESERVE, _shmID, (off_t) 0);
 
     if (_mapped==((void *) -1))
@@ -213,6 +222,12 @@ void SharedMemory::Close()
         _mapped = NULL;
     }
     #endif
+
+    if (_counterMem != 0)
+    {// detach from the use counter, or this process keeps counting as a user until it exits
+        shmdt(_counterMem);
+        _counterMem = 0;
+    }
 }
 
 void SharedMemory::Unlink()
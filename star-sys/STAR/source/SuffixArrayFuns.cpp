@@ -1,106 +1,117 @@
 #include "SuffixArrayFuns.h"
 #include "PackedArray.h"
 
+#if defined(__SSE2__)
+    #include <immintrin.h>
+#endif
+
 inline uint medianUint2(uint a, uint b)
 {
     // returns (a+b)/2
     return a/2 + b/2 + (a%2 + b%2)/2;
 };
 
+#if defined(__SSE2__)
+static inline __m128i reverseBytes(__m128i v)
+{
+#if defined(__SSSE3__)
+    return _mm_shuffle_epi8(v, _mm_setr_epi8(15,14,13,12,11,10,9,8,7,6,5,4,3,2,1,0));
+#else
+    v=_mm_shuffle_epi32(v, _MM_SHUFFLE(0,1,2,3)); //reverse the 32-bit words
+    v=_mm_shufflelo_epi16(v, _MM_SHUFFLE(2,3,0,1)); //then the 16-bit words in them
+    v=_mm_shufflehi_epi16(v, _MM_SHUFFLE(2,3,0,1));
+    return _mm_or_si128(_mm_slli_epi16(v,8), _mm_srli_epi16(v,8)); //then the bytes
+#endif
+};
+#endif
+
+#if defined(__AVX2__)
+static inline __m256i reverseBytes(__m256i v)
+{
+    const __m256i rev=_mm256_setr_epi8(15,14,13,12,11,10,9,8,7,6,5,4,3,2,1,0,15,14,13,12,11,10,9,8,7,6,5,4,3,2,1,0);
+    v=_mm256_shuffle_epi8(v, rev); //reverse the bytes in each 128-bit lane
+    return _mm256_permute2x128_si256(v, v, 1); //then swap the lanes
+};
+#endif
+
+template <bool sRev, bool gRev>
+static inline uint firstDifference(const char* s, const char* g, uint n)
+{//first ii<n with s[ii]!=g[ii], or n. sRev, gRev: s, g go to lower addresses, s[-ii] and g[-ii]
+    uint ii=0;
+#if defined(__AVX2__)
+    for (; ii+32<=n; ii+=32) {
+        __m256i vs=_mm256_loadu_si256((const __m256i*) (sRev ? s-ii-31 : s+ii));
+        __m256i vg=_mm256_loadu_si256((const __m256i*) (gRev ? g-ii-31 : g+ii));
+        if (sRev!=gRev) {//bring the reversed one into the order of the other one
+            if (sRev)
+                vs=reverseBytes(vs);
+            else
+                vg=reverseBytes(vg);
+        };
+        uint32 diff=~(uint32) _mm256_movemask_epi8(_mm256_cmpeq_epi8(vs,vg));
+        if (diff!=0) //both reversed: the 1st difference is at the highest address
+            return ii + (sRev && gRev ? __builtin_clz(diff) : __builtin_ctz(diff));
+    };
+#endif
+#if defined(__SSE2__)
+    for (; ii+16<=n; ii+=16) {
+        __m128i vs=_mm_loadu_si128((const __m128i*) (sRev ? s-ii-15 : s+ii));
+        __m128i vg=_mm_loadu_si128((const __m128i*) (gRev ? g-ii-15 : g+ii));
+        if (sRev!=gRev) {
+            if (sRev)
+                vs=reverseBytes(vs);
+            else
+                vg=reverseBytes(vg);
+        };
+        uint32 diff=~(uint32) _mm_movemask_epi8(_mm_cmpeq_epi8(vs,vg)) & 0xFFFF;
+        if (diff!=0)
+            return ii + (sRev && gRev ? __builtin_clz(diff)-16 : __builtin_ctz(diff));
+    };
+#endif
+    for (; ii<n; ii++) {
+        if (s[sRev ? -(int64) ii : (int64) ii]!=g[gRev ? -(int64) ii : (int64) ii])
+            return ii;
+    };
+    return n;
+};
+
 uint compareSeqToGenome(const Genome &mapGen, char** s2, uint S, uint N, uint L, uint iSA, bool dirR, bool& compRes)
 {
     /* compare s to g, find the maximum identity length
      * s2[0] read sequence; s2[1] complementary sequence
      * S position to start search from in s2[0],s2[1]
      * dirR forward or reverse direction search on read sequence
+     * the reverse strand of the genome is compared backwards to the complementary sequence, and g>3 (N, spacer) is smaller than any s
      */
 
-    int64 ii;
-
     uint SAstr=mapGen.SA[iSA];
     bool dirG = (SAstr>>mapGen.GstrandBit) == 0; //forward or reverse strand of the genome
     SAstr &= mapGen.GstrandMask;
 
-    char *g=mapGen.G;
+    const char *s = s2[dirR==dirG ? 0 : 1] + (dirR ? S+L : S-L);
+    const char *g = mapGen.G + (dirG ? SAstr+L : mapGen.nGenome-1-SAstr-L);
 
-    if (dirR && dirG) {//forward on read, forward on genome
-        char* s  = s2[0] + S + L;
-        g += SAstr + L;
-        for (ii=0;(uint) ii < N-L; ii++)
-        {
-            if (s[ii]!=g[ii])
-            {
-                if (s[ii]>g[ii])
-                {
-                    compRes=true;
-                    return ii+L;
-                } else
-                {
-                    compRes=false;
-                    return ii+L;
-                };
-            };
-        };
-//         if (s[ii]>g[ii]) {compRes=true;} else {compRes=false;};
+    uint ii;
+    if (dirR)
+        ii = dirG ? firstDifference<false,false>(s,g,N-L) : firstDifference<false,true>(s,g,N-L);
+    else
+        ii = dirG ? firstDifference<true,false>(s,g,N-L) : firstDifference<true,true>(s,g,N-L);
+
+    if (ii==N-L)
         return N; //exact match
-    } else if (dirR && !dirG) {
-        char* s  = s2[1] + S + L;
-        g += mapGen.nGenome-1-SAstr - L;
-        for (ii=0; (uint) ii < N-L; ii++)
-        {
-            if (s[ii]!=g[-ii])
-            {
-                if (s[ii]>g[-ii] || g[-ii]>3)
-                {
-                    compRes=false;
-                    return ii+L;
-                } else
-                {
-                    compRes=true;
-                    return ii+L;
-                };
-            };
-        };
-        return N;
-    } else if (!dirR && dirG) {
-        char* s  = s2[1] + S - L;
-        g += SAstr + L;
-        for (ii=0; (uint) ii < N-L; ii++)
-        {
-            if (s[-ii]!=g[ii])
-            {
-                if (s[-ii]>g[ii]) {
-                    compRes=true;
-                    return ii+L;
 
-                } else
-                {
-                    compRes=false;
-                    return ii+L;
-                };
-            };
-        };
-        return N;
-    } else {//if (!dirR && !dirG)
-        char* s  = s2[0] + S - L;
-        g += mapGen.nGenome-1-SAstr - L;
-        for (ii=0; (uint) ii < N-L; ii++)
-        {
-            if (s[-ii]!=g[-ii])
-            {
-                if (s[-ii]>g[-ii] || g[-ii]>3)
-                {
-                    compRes=false;
-                    return ii+L;
-                } else
-                {
-                    compRes=true;
-                    return ii+L;
-                };
-            };
-        };
-        return N;
-    };
+    char sC = s[dirR ? (int64) ii : -(int64) ii];
+    char gC = g[dirG ? (int64) ii : -(int64) ii];
+    compRes = dirG ? sC>gC : !(sC>gC || gC>3);
+    return ii+L;
+};
+
+static inline uint lcpRange(const Genome &mapGen, uint i1, uint i2)
+{//common prefix length of SA[i1] and SA[i2], i1<i2, from SAlcp; SA_lcpMax means SA_lcpMax or longer
+    uint q=SA_lcpMax;
+    for (uint ii=i1+1; ii<=i2 && q>0; ii++)
+        q=min(q, (uint) mapGen.SAlcp[ii]);
+    return q;
 };
 
 uint findMultRange(const Genome &mapGen, uint i3, uint L3, uint i1, uint L1, uint i1a, uint L1a, uint i1b, uint L1b, char** s, bool dirR, uint S)
@@ -119,7 +130,14 @@ uint findMultRange(const Genome &mapGen, uint i3, uint L3, uint i1, uint L1, uin
     while ( (i1b+1<i1a)|(i1b>i1a+1) ) { //L1a is the target length, i1a...i1b is the initial range, i1c,L1c is the value in the middle
         uint i1c=medianUint2(i1a,i1b);
         //uint L1c=identityLength(&g[mapGen.SA[i3]+L1b],&g[mapGen.SA[i1c]+L1b],L3-L1b)+L1b;
-        uint L1c=compareSeqToGenome(mapGen,s,S,L3,L1b,i1c,dirR,compRes);
+        uint L1c;
+        bool lcpScan = !mapGen.SAlcp.empty() && max(i1c,i3)-min(i1c,i3)<=SA_lcpScanMax;
+        uint q = lcpScan ? lcpRange(mapGen, min(i1c,i3), max(i1c,i3)) : 0;
+        if (lcpScan && (q<SA_lcpMax || L3<=SA_lcpMax)) {//i1c matches the read as far as it matches i3
+            L1c=min(q,L3);
+        } else {
+            L1c=compareSeqToGenome(mapGen,s,S,L3,L1b,i1c,dirR,compRes);
+        };
         if (L1c==L3) {
             i1a=i1c;
         }
@@ -135,14 +153,16 @@ uint maxMappableLength(const Genome &mapGen, char** s, uint S, uint N, uint i1,
     /* find minimum mappable length of sequence s to the genome g with suffix array SA; length(s)=N; [i1 i2] is initial suffix array search bounds.
      * returns number of mappings (1=unique);range indStartEnd; min mapped length = L
      * binary search in SA space
+     * with mapGen.SAlcp, the identity length at i3 follows from the common prefix of i3 with i1 or i2 unless they are equal
      */
 
     bool compRes;
+    bool compRes1=false, compRes2=false; //compRes of i1, i2
 
     uint L1,L2,i3,L3,L1a,L1b,L2a,L2b,i1a,i1b,i2a,i2b;
 
-    L1=compareSeqToGenome(mapGen,s,S,N,L,i1,dirR,compRes);
-    L2=compareSeqToGenome(mapGen,s,S,N,L,i2,dirR,compRes);
+    L1=compareSeqToGenome(mapGen,s,S,N,L,i1,dirR,compRes1);
+    L2=compareSeqToGenome(mapGen,s,S,N,L,i2,dirR,compRes2);
 
 //     L1=identityLength(&s[L],&g[mapGen.SA[i1]]);
 //     L2=identityLength(&s[L],&g[mapGen.SA[i2]]);
@@ -164,7 +184,20 @@ uint maxMappableLength(const Genome &mapGen, char** s, uint S, uint N, uint i1,
     i3=i1;L3=L1; //in case i1+1>=i2 an not iteration of the loope below is ever made
     while (i1+1<i2) {//main binary search loop
         i3=medianUint2(i1,i2);
-        L3=compareSeqToGenome(mapGen,s,S,N,L,i3,dirR,compRes);
+        if (!mapGen.SAlcp.empty() && i2-i1<=2*SA_lcpScanMax) {
+            bool side1 = L1>=L2; //infer from the side with the longer identity length
+            uint Ls = side1 ? L1 : L2;
+            uint q = side1 ? lcpRange(mapGen,i1,i3) : lcpRange(mapGen,i3,i2);
+            if (q>Ls) {//i3 shares the bases after Ls with the read's side
+                L3=Ls; compRes = side1 ? compRes1 : compRes2;
+            } else if (q<Ls && q<SA_lcpMax) {//i3 departs from the read's side after q bases, towards the other side
+                L3=q; compRes = !side1;
+            } else {
+                L3=compareSeqToGenome(mapGen,s,S,N,max(L,q),i3,dirR,compRes);
+            };
+        } else {
+            L3=compareSeqToGenome(mapGen,s,S,N,L,i3,dirR,compRes);
+        };
 
         if (L3==N) break; //found exact match, exit the binary search
 
@@ -174,13 +207,13 @@ uint maxMappableLength(const Genome &mapGen, char** s, uint S, uint N, uint i1,
                // L1b, i1b - captures history of last time the max score shifted.
                // L1a, i1a - tracks current shift.
             };
-            i1=i3;L1=L3;
+            i1=i3;L1=L3;compRes1=true;
         }
         else {
             if (L3>L2) { //move 2 to 3
                L2b=L2a; L2a=L2; i2b=i2a; i2a=i2;
             };
-            i2=i3;L2=L3;
+            i2=i3;L2=L3;compRes2=false;
         };
         L= min(L1,L2);
 
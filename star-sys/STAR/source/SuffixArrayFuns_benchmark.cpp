@@ -0,0 +1,178 @@
+/*
+ * Benchmark of compareSeqToGenome against a byte-by-byte comparison
+ *
+ * Not part of the library: build.rs compiles this file only with the compare-benchmark feature of star-sys,
+ * for benches/compare_seq_to_genome.rs
+ */
+#include "SuffixArrayFuns.h"
+#include "Parameters.h"
+#include "Genome.h"
+
+#include <chrono>
+#include <random>
+
+static uint compareSeqToGenomeScalar(const Genome &mapGen, char** s2, uint S, uint N, uint L, uint iSA, bool dirR, bool& compRes)
+{
+    /* byte-by-byte compareSeqToGenome, for compareSeqToGenomeBenchmark
+     * compare s to g, find the maximum identity length
+     * s2[0] read sequence; s2[1] complementary sequence
+     * S position to start search from in s2[0],s2[1]
+     * dirR forward or reverse direction search on read sequence
+     */
+
+    int64 ii;
+
+    uint SAstr=mapGen.SA[iSA];
+    bool dirG = (SAstr>>mapGen.GstrandBit) == 0; //forward or reverse strand of the genome
+    SAstr &= mapGen.GstrandMask;
+
+    char *g=mapGen.G;
+
+    if (dirR && dirG) {//forward on read, forward on genome
+        char* s  = s2[0] + S + L;
+        g += SAstr + L;
+        for (ii=0;(uint) ii < N-L; ii++)
+        {
+            if (s[ii]!=g[ii])
+            {
+                if (s[ii]>g[ii])
+                {
+                    compRes=true;
+                    return ii+L;
+                } else
+                {
+                    compRes=false;
+                    return ii+L;
+                };
+            };
+        };
+//         if (s[ii]>g[ii]) {compRes=true;} else {compRes=false;};
+        return N; //exact match
+    } else if (dirR && !dirG) {
+        char* s  = s2[1] + S + L;
+        g += mapGen.nGenome-1-SAstr - L;
+        for (ii=0; (uint) ii < N-L; ii++)
+        {
+            if (s[ii]!=g[-ii])
+            {
+                if (s[ii]>g[-ii] || g[-ii]>3)
+                {
+                    compRes=false;
+                    return ii+L;
+                } else
+                {
+                    compRes=true;
+                    return ii+L;
+                };
+            };
+        };
+        return N;
+    } else if (!dirR && dirG) {
+        char* s  = s2[1] + S - L;
+        g += SAstr + L;
+        for (ii=0; (uint) ii < N-L; ii++)
+        {
+            if (s[-ii]!=g[ii])
+            {
+                if (s[-ii]>g[ii]) {
+                    compRes=true;
+                    return ii+L;
+
+                } else
+                {
+                    compRes=false;
+                    return ii+L;
+                };
+            };
+        };
+        return N;
+    } else {//if (!dirR && !dirG)
+        char* s  = s2[0] + S - L;
+        g += mapGen.nGenome-1-SAstr - L;
+        for (ii=0; (uint) ii < N-L; ii++)
+        {
+            if (s[-ii]!=g[-ii])
+            {
+                if (s[-ii]>g[-ii] || g[-ii]>3)
+                {
+                    compRes=false;
+                    return ii+L;
+                } else
+                {
+                    compRes=true;
+                    return ii+L;
+                };
+            };
+        };
+        return N;
+    };
+};
+
+static uint compareSeqToGenomeBenchmark(const Genome &mapGen, uint nCompare, uint N, double seconds[2])
+{//compares nCompare reads of length N, cut from the genome at random suffixes with random mismatches, to their suffixes,
+ //with compareSeqToGenome and compareSeqToGenomeScalar; seconds of each. Returns the number of comparisons with different results
+    std::mt19937_64 rng(1);
+    vector<char> reads(nCompare*2*N); //s2[0] and s2[1] of each read
+    vector<uint> iSAs(nCompare);
+    vector<uint8> dirRs(nCompare);
+    for (uint ic=0; ic<nCompare; ic++) {
+        iSAs[ic]=rng()%mapGen.nSA;
+        dirRs[ic]=rng()%2;
+        uint SAstr=mapGen.SA[iSAs[ic]];
+        bool dirG = (SAstr>>mapGen.GstrandBit) == 0;
+        SAstr &= mapGen.GstrandMask;
+        char *r0=&reads[ic*2*N], *r1=r0+N;
+        for (uint ii=0; ii<N; ii++) {//the bytes compareSeqToGenome compares to the genome, and their complements
+            char b = dirG ? mapGen.G[SAstr+ii] : mapGen.G[mapGen.nGenome-1-SAstr-ii];
+            if (rng()%(N/2+1)==0)
+                b=rng()%4;
+            uint iR = dirRs[ic] ? ii : N-1-ii;
+            (dirRs[ic]==dirG ? r0 : r1)[iR]=b;
+            (dirRs[ic]==dirG ? r1 : r0)[iR]= b<4 ? 3-b : b;
+        };
+    };
+
+    vector<uint> L[2];
+    vector<uint8> compRes[2];
+    for (uint iK=0; iK<2; iK++) {//vector, then scalar
+        L[iK].resize(nCompare);
+        compRes[iK].resize(nCompare);
+        auto t1=std::chrono::steady_clock::now();
+        for (uint ic=0; ic<nCompare; ic++) {
+            char *s2[2]={&reads[ic*2*N], &reads[ic*2*N]+N};
+            bool cR=false;
+            L[iK][ic] = iK==0 ? compareSeqToGenome(mapGen, s2, dirRs[ic] ? 0 : N-1, N, 0, iSAs[ic], dirRs[ic], cR)
+                              : compareSeqToGenomeScalar(mapGen, s2, dirRs[ic] ? 0 : N-1, N, 0, iSAs[ic], dirRs[ic], cR);
+            compRes[iK][ic]=cR;
+        };
+        seconds[iK]=std::chrono::duration<double>(std::chrono::steady_clock::now()-t1).count();
+    };
+
+    uint nDiff=0;
+    for (uint ic=0; ic<nCompare; ic++) {
+        if (L[0][ic]!=L[1][ic] || (L[0][ic]<N && compRes[0][ic]!=compRes[1][ic]))
+            nDiff++;
+    };
+    return nDiff;
+};
+
+// compare_benchmark: load the genome given by the STAR arguments and compare n
+// reads of read_len bases, cut from it at random suffix array entries with
+// random mismatches, to these entries with compareSeqToGenome and the
+// byte-by-byte comparison, and get the seconds each took. Returns the number
+// of comparisons on which they disagree, which should be 0. read_len is at
+// most 150
+extern "C" size_t compare_benchmark(int argc, const char* const argv[], size_t n, size_t read_len,
+                                    double* vector_seconds, double* scalar_seconds) {
+    Parameters P;
+    P.inputParameters(argc, argv);
+    Genome mapGen(P);
+    mapGen.genomeLoad();
+    mapGen.Var = nullptr;
+
+    double seconds[2];
+    size_t n_diff = compareSeqToGenomeBenchmark(mapGen, n, std::min(read_len, (size_t) 150), seconds);
+    *vector_seconds = seconds[0];
+    *scalar_seconds = seconds[1];
+    return n_diff;
+}
@@ -0,0 +1,119 @@
+#include "XXH64.h"
+#include <cstring>
+
+#define XXH_prime1 11400714785074694791LLU
+#define XXH_prime2 14029467366897019727LLU
+#define XXH_prime3 1609587929392839161LLU
+#define XXH_prime4 9650029242287828579LLU
+#define XXH_prime5 2870177450012600261LLU
+
+static inline uint64 rotl64(uint64 x, int r)
+{
+    return (x<<r) | (x>>(64-r));
+};
+
+static inline uint64 read64(const char *p)
+{//little-endian, as the hash is defined
+    uint64 x;
+    memcpy(&x, p, sizeof(x));
+    return x;
+};
+
+static inline uint64 read32(const char *p)
+{
+    uint32 x;
+    memcpy(&x, p, sizeof(x));
+    return x;
+};
+
+static inline uint64 xxhRound(uint64 acc, uint64 input)
+{
+    acc+=input*XXH_prime2;
+    return rotl64(acc,31)*XXH_prime1;
+};
+
+static inline uint64 xxhMerge(uint64 h, uint64 acc)
+{
+    h^=xxhRound(0,acc);
+    return h*XXH_prime1+XXH_prime4;
+};
+
+XXH64::XXH64(uint64 seedIn)
+{
+    seed=seedIn;
+    totalBytes=0;
+    stripeBytes=0;
+    acc[0]=seed+XXH_prime1+XXH_prime2;
+    acc[1]=seed+XXH_prime2;
+    acc[2]=seed;
+    acc[3]=seed-XXH_prime1;
+};
+
+void XXH64::update(const char *data, uint64 bytes)
+{
+    totalBytes+=bytes;
+    if (stripeBytes+bytes<32) {
+        memcpy(stripe+stripeBytes, data, bytes);
+        stripeBytes+=bytes;
+        return;
+    };
+
+    if (stripeBytes>0) {//complete the stripe started by the previous piece
+        uint n=32-stripeBytes;
+        memcpy(stripe+stripeBytes, data, n);
+        for (uint ii=0; ii<4; ii++)
+            acc[ii]=xxhRound(acc[ii], read64(stripe+8*ii));
+        data+=n;
+        bytes-=n;
+        stripeBytes=0;
+    };
+
+    uint64 a0=acc[0], a1=acc[1], a2=acc[2], a3=acc[3];
+    for (; bytes>=32; data+=32, bytes-=32) {
+        a0=xxhRound(a0, read64(data));
+        a1=xxhRound(a1, read64(data+8));
+        a2=xxhRound(a2, read64(data+16));
+        a3=xxhRound(a3, read64(data+24));
+    };
+    acc[0]=a0; acc[1]=a1; acc[2]=a2; acc[3]=a3;
+
+    memcpy(stripe, data, bytes);
+    stripeBytes=bytes;
+};
+
+uint64 XXH64::digest() const
+{
+    uint64 h;
+    if (totalBytes>=32) {
+        h=rotl64(acc[0],1)+rotl64(acc[1],7)+rotl64(acc[2],12)+rotl64(acc[3],18);
+        for (uint ii=0; ii<4; ii++)
+            h=xxhMerge(h,acc[ii]);
+    } else {
+        h=seed+XXH_prime5;
+    };
+    h+=totalBytes;
+
+    const char *p=stripe;
+    uint n=stripeBytes;
+    for (; n>=8; p+=8, n-=8) {
+        h^=xxhRound(0, read64(p));
+        h=rotl64(h,27)*XXH_prime1+XXH_prime4;
+    };
+    if (n>=4) {
+        h^=read32(p)*XXH_prime1;
+        h=rotl64(h,23)*XXH_prime2+XXH_prime3;
+        p+=4;
+        n-=4;
+    };
+    for (; n>0; p++, n--) {
+        h^=((unsigned char) *p)*XXH_prime5;
+        h=rotl64(h,11)*XXH_prime1;
+    };
+
+    h^=h>>33;
+    h*=XXH_prime2;
+    h^=h>>29;
+    h*=XXH_prime3;
+    h^=h>>32;
+    return h;
+};
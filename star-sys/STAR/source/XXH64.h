@@ -0,0 +1,19 @@
+#ifndef CODE_XXH64
+#define CODE_XXH64
+
+#include "IncludeDefine.h"
+
+class XXH64 {//64-bit xxHash of a byte stream, which may be given in several pieces
+    public:
+        XXH64(uint64 seedIn=0);
+        void update(const char *data, uint64 bytes);
+        uint64 digest() const;
+
+    private:
+        uint64 seed, totalBytes;
+        uint64 acc[4]; //the four lanes of the 32-byte stripes
+        char stripe[32]; //the start of an incomplete stripe
+        uint stripeBytes;
+};
+
+#endif
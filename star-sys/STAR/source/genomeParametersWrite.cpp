@@ -15,6 +15,7 @@ void genomeParametersWrite(string fileName, Parameters& P, string errorOut, Geno
     genomePar << "genomeSAindexNbases\t" << mapGen.pGe.gSAindexNbases << "\n";
     genomePar << "genomeChrBinNbits\t" << mapGen.pGe.gChrBinNbits << "\n";
     genomePar << "genomeSAsparseD\t" << mapGen.pGe.gSAsparseD <<"\n";
+    genomePar << "genomeSAencoding\t" << mapGen.pGe.gSAencoding <<"\n";
     genomePar << "sjdbOverhang\t" << mapGen.sjdbOverhang <<"\n";
 
     genomePar << "sjdbFileChrStartEnd\t";
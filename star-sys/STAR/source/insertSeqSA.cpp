@@ -145,7 +145,7 @@ uint insertSeqSA(PackedArray & SA, PackedArray & SA1, PackedArray & SAi, char *
 
     /*testing
     PackedArray SAo;
-    SAo.defineBits(mapGen.GstrandBit+1,mapGen.nSA+nInd);
+    SAo.defineBits(mapGen.SAbits(),mapGen.nSA+nInd);
     SAo.allocateArray();
     ifstream oldSAin("./DirTrue/SA");
     oldSAin.read(SAo.charArray,SAo.lengthByte);
@@ -296,7 +296,7 @@ uint insertSeqSA(PackedArray & SA, PackedArray & SA1, PackedArray & SAi, char *
 //     */
 
     //change parameters, most parameters are already re-defined in sjdbPrepare.cpp
-    SA.defineBits(mapGen.GstrandBit+1,SA.length+nInd);//same as SA2
+    SA.defineBits(mapGen.SAbits(),SA.length+nInd);//same as SA2
     SA.pointArray(SA1.charArray);
     mapGen.nSA=SA.length;
     mapGen.nSAbyte=SA.lengthByte;
@@ -1,8 +1,15 @@
+#include <cctype>  // for isalpha, isalnum
+#include <charconv>  // for from_chars
+#include <cstdlib>  // for realloc, strtof
+#include <cstring>  // for strdup
 #include <memory>  // for make_unique
 
+#include "ErrorWarning.h"
 #include "Genome.h"
 #include "Parameters.h"
 #include "ReadAlign.h"
+#include "SeedPrefetch.h"
+#include "SuffixArrayFuns.h"
 
 #include "orbit.h"
 
@@ -13,6 +20,7 @@ struct StarRef {
     public:
         const unique_ptr<Parameters> p;
         const unique_ptr<Genome> g;
+        mutable std::string write_error; //of the last write_ref_ call, empty if it succeeded
         StarRef(int argInN, const char* const argIn[]);
 };
 
@@ -32,8 +40,8 @@ unique_ptr<Genome> load_genome(Parameters& p) {
     return gMut;
 }
 
-unique_ptr<ReadAlign> make_ra(const StarRef *ref) {
-    return make_unique<ReadAlign>(*(ref->p), *(ref->g), nullptr, 0);
+unique_ptr<ReadAlign> make_ra(const StarRef *ref, int numa_node) {
+    return make_unique<ReadAlign>(*(ref->p), ref->g->numaGenome(numa_node), nullptr, 0);
 }
 
 }  // namespace
@@ -56,15 +64,32 @@ struct Aligner final {
         // alignment queries
         unique_ptr<ReadAlign> ra;
 
-        explicit Aligner(const StarRef* r)
+        // NUMA node of the genome replica ra aligns to, -1 if not replicated
+        const int numa_node;
+
+        // Read name for SAM and BAM output, '@'-prefixed like ReadAlign::readName
+        std::string read_name;
+
+        // Prefetches the first seeds of the reads of align_reads_batch ahead
+        // of mapping them
+        SeedPrefetch prefetch;
+
+        // Uses the genome replica on node, if there is one
+        Aligner(const StarRef* r, int node)
             : ref(r),
-              ra(make_ra(ref))
+              ra(make_ra(ref, node)),
+              numa_node(ra->mapGen.numaNode()),
+              prefetch(*ref->p, ra->mapGen)
         { }
 
-        Aligner(int argInN, const char* const argIn[])
-            : owned_ref(make_unique<StarRef>(argInN, argIn)),
+        // Owns the reference, which has to have loaded without a
+        // ref_load_error
+        explicit Aligner(unique_ptr<StarRef> r)
+            : owned_ref(std::move(r)),
               ref(owned_ref.get()),
-              ra(make_ra(ref))
+              ra(make_ra(ref, Genome::numaNodeCurrent())),
+              numa_node(ra->mapGen.numaNode()),
+              prefetch(*ref->p, ra->mapGen)
         { }
 
         // This constructor is used to construct clones of an existing Aligner
@@ -72,7 +97,9 @@ struct Aligner final {
         // constructing its own genome object
         explicit Aligner(const Aligner* og)
             : ref(og->ref),
-              ra(make_ra(ref))
+              ra(make_ra(ref, og->numa_node)),
+              numa_node(ra->mapGen.numaNode()),
+              prefetch(*ref->p, ra->mapGen)
         { }
 };
 
@@ -86,8 +113,8 @@ const char* align_read(Aligner* a, const char* read1Fastq) {
     if(readStatus != 0) {
         return nullptr;
     }
-    const char* str = a->ra->outputAlignments();
-    return str;
+    a->ra->outputAlignments();
+    return strdup(a->ra->outSAMtext.c_str());
 }
 
 const char* align_read_pair(Aligner* a, const char* read1Fastq, const char* read2Fastq) {
@@ -101,8 +128,249 @@ const char* align_read_pair(Aligner* a, const char* read1Fastq, const char* read
     if(readStatus != 0) {
         return nullptr;
     }
-    const char* str = a->ra->outputAlignments();
-    return str;
+    a->ra->outputAlignments();
+    return strdup(a->ra->outSAMtext.c_str());
+}
+
+namespace {
+
+bool printable(const char* s, const char* end) {
+    return std::all_of(s, end, [](char c) { return c >= ' ' && c <= '~'; });
+}
+
+// Whether tags is a list of SAM attributes of type A, i, f or Z separated by
+// single tabs, which STAR can convert to BAM. Their BAM encoding takes at most one
+// byte more per attribute than the text, and leaves room for STAR's own
+// attributes if it fits in half of the attribute buffer
+bool valid_sam_tags(const char* tags, size_t tags_len) {
+    if (tags_len > BAM_ATTR_MaxSize/2) return false;
+    const char* end = tags+tags_len;
+    for (const char* f = tags; f < end; ) {
+        const char* fEnd = std::find(f, end, '\t');
+        const size_t n = fEnd-f;
+        if (n < 5 || !isalpha((unsigned char)f[0]) || !isalnum((unsigned char)f[1]) || f[2] != ':' || f[4] != ':') return false;
+        const char* v = f+5;
+        switch (f[3]) {
+            case 'A':
+                if (n != 6 || !printable(v, fEnd) || *v == ' ') return false;
+                break;
+            case 'i': {
+                int32_t x;
+                std::from_chars_result r = std::from_chars(v, fEnd, x);
+                if (v == fEnd || r.ec != std::errc() || r.ptr != fEnd) return false;
+                break;
+            }
+            case 'f': {
+                const std::string x(v, fEnd);
+                char* xEnd;
+                strtof(x.c_str(), &xEnd);
+                if (x.empty() || xEnd != x.c_str()+x.size()) return false;
+                break;
+            }
+            case 'Z':
+                if (!printable(v, fEnd)) return false;
+                break;
+            default:
+                return false;
+        }
+        if (fEnd == end) break;
+        f = fEnd+1;
+        if (f == end) return false;  // trailing tab
+    }
+    return true;
+}
+
+// Set the name of the read for SAM and BAM output. The BAM read name length
+// including the 0-char must fit in a byte
+void set_read_name(Aligner* a, const char* name, size_t nameLen) {
+    a->read_name.assign("@");
+    a->read_name.append(name, nameLen);
+    a->ra->readName = a->read_name.c_str();
+}
+
+// Load and map a single read or read pair given as raw sequence/quality
+// strings, to be output with the given name and SAM tags. Returns the
+// ReadAlign::oneReadRaw status, which is ORBIT_BAD_READ for invalid sequences,
+// or ORBIT_BAD_MATES, ORBIT_BAD_TAGS or ORBIT_BAD_NAME
+int map_raw_read(Aligner* a, const char* name, size_t name_len,
+                 const char* tags, size_t tags_len, size_t n_mates,
+                 const char* const seqs[], const size_t seq_lens[],
+                 const char* const quals[], const size_t qual_lens[]) {
+    if (n_mates != 1 && n_mates != 2) {
+        return ORBIT_BAD_MATES;
+    }
+    if (!valid_sam_tags(tags, tags_len)) {
+        return ORBIT_BAD_TAGS;
+    }
+    if (name_len > 254) {
+        return ORBIT_BAD_NAME;
+    }
+    uint seqLens[2], qualLens[2];
+    for (size_t m = 0; m < n_mates; m++) {
+        seqLens[m] = seq_lens[m];
+        qualLens[m] = qual_lens[m];
+    }
+    a->ra->iRead++;
+    a->ra->readNmates = n_mates;
+    set_read_name(a, name, name_len);
+    return a->ra->oneReadRaw(seqs, seqLens, quals, qualLens, tags_len == 0 ? "" : tags, tags_len);
+}
+
+// Map a read and point out at its BAM records
+int align_bam(Aligner* a, const char* name, size_t name_len,
+              const char* tags, size_t tags_len, size_t n_mates,
+              const char* const seqs[], const size_t seq_lens[],
+              const char* const quals[], const size_t qual_lens[],
+              const char** out, size_t* out_len) {
+    ReadAlign& ra = *a->ra;
+    ra.outBAMrecords.clear();
+    int readStatus = map_raw_read(a, name, name_len, tags, tags_len, n_mates, seqs, seq_lens, quals, qual_lens);
+    if (readStatus == 0) {
+        ra.outFormat = OUT_FORMAT_BAM;
+        ra.outputAlignments();
+        ra.outFormat = OUT_FORMAT_SAM;
+    }
+    *out = ra.outBAMrecords.data();
+    *out_len = ra.outBAMrecords.size();
+    return readStatus;
+}
+
+// Map a read and point out at its SAM text
+int align_sam(Aligner* a, const char* name, size_t name_len,
+              const char* tags, size_t tags_len, size_t n_mates,
+              const char* const seqs[], const size_t seq_lens[],
+              const char* const quals[], const size_t qual_lens[],
+              const char** out, size_t* out_len) {
+    ReadAlign& ra = *a->ra;
+    ra.outSAMtext.clear();
+    int readStatus = map_raw_read(a, name, name_len, tags, tags_len, n_mates, seqs, seq_lens, quals, qual_lens);
+    if (readStatus == 0) {
+        ra.outputAlignments();
+    }
+    *out = ra.outSAMtext.data();
+    *out_len = ra.outSAMtext.size();
+    return readStatus;
+}
+
+// Append len bytes to the arena at offset pos, growing it geometrically
+void arena_append(const Aligner* a, OrbitArena* out, size_t pos, const char* src, size_t len) {
+    if (pos+len > out->capacity) {
+        size_t capacity = out->capacity==0 ? 4096 : out->capacity;
+        while (capacity < pos+len) capacity *= 2;
+        char* data = static_cast<char*>(realloc(out->data, capacity));
+        if (data == nullptr) {
+            ostringstream errOut;
+            errOut << "EXITING because of FATAL ERROR: could not grow batch output arena to " << capacity << " bytes\n";
+            exitWithError(errOut.str(), std::cerr, a->ref->p->inOut->logMain, EXIT_CODE_MEMORY_ALLOCATION, *(a->ref->p));
+        }
+        out->data = data;
+        out->capacity = capacity;
+    }
+    memcpy(out->data+pos, src, len);
+}
+
+}  // namespace
+
+size_t align_reads_batch(Aligner* a, size_t n, size_t n_mates,
+                         const char* const names[], const size_t name_lens[],
+                         const char* const tags[], const size_t tag_lens[],
+                         const char* const seqs[], const size_t seq_lens[],
+                         const char* const quals[], const size_t qual_lens[],
+                         OrbitArena* out) {
+    if (n_mates != 1 && n_mates != 2) {
+        for (size_t i = 0; i < n; i++) {
+            out->offsets[i] = 0;
+            if (out->status != nullptr) {
+                out->status[i] = ORBIT_BAD_MATES;
+            }
+        }
+        out->offsets[n] = 0;
+        return 0;
+    }
+
+    // read i+depth enters the prefetch pipeline as read i is mapped, so that
+    // the seed search of read i finds its index entries in the cache
+    const size_t depth = SEED_prefetchStagesN*SEED_prefetchStageReads;
+    auto prefetch_read = [&](size_t i) {
+        if (i < n) {
+            a->prefetch.push(n_mates, seqs+i*n_mates, seq_lens+i*n_mates);
+        } else {
+            a->prefetch.push(0, nullptr, nullptr);
+        }
+    };
+    a->prefetch.clear();
+    for (size_t i = 0; i < depth; i++) {
+        prefetch_read(i);
+    }
+
+    size_t pos = 0;
+    for (size_t i = 0; i < n; i++) {
+        prefetch_read(i+depth);
+        out->offsets[i] = pos;
+        if (out->status != nullptr) {
+            out->status[i] = 0;
+        }
+        const size_t j = i*n_mates;
+        if (seq_lens[j] == 0 || (n_mates == 2 && seq_lens[j+1] == 0)) {
+            continue;  // STAR rejects empty reads
+        }
+        const char* t = tags == nullptr ? nullptr : tags[i];
+        const size_t t_len = tags == nullptr ? 0 : tag_lens[i];
+        const char* bam;
+        size_t bam_len;
+        int readStatus = align_bam(a, names[i], name_lens[i], t, t_len, n_mates, seqs+j, seq_lens+j, quals+j, qual_lens+j, &bam, &bam_len);
+        if (readStatus != 0) {
+            if (out->status != nullptr) {
+                out->status[i] = readStatus;
+            }
+            continue;
+        }
+        arena_append(a, out, pos, bam, bam_len);
+        pos += bam_len;
+    }
+    out->offsets[n] = pos;
+    return pos;
+}
+
+int align_read_sam(Aligner* a, const char* name, size_t name_len,
+                   const char* tags, size_t tags_len,
+                   const char* seq, size_t seq_len,
+                   const char* qual, size_t qual_len,
+                   const char** out, size_t* out_len) {
+    return align_sam(a, name, name_len, tags, tags_len, 1, &seq, &seq_len, &qual, &qual_len, out, out_len);
+}
+
+int align_read_pair_sam(Aligner* a, const char* name, size_t name_len,
+                        const char* tags, size_t tags_len,
+                        const char* seq1, size_t seq1_len,
+                        const char* qual1, size_t qual1_len,
+                        const char* seq2, size_t seq2_len,
+                        const char* qual2, size_t qual2_len,
+                        const char** out, size_t* out_len) {
+    const char* const seqs[2] = {seq1, seq2};
+    const size_t seq_lens[2] = {seq1_len, seq2_len};
+    const char* const quals[2] = {qual1, qual2};
+    const size_t qual_lens[2] = {qual1_len, qual2_len};
+    return align_sam(a, name, name_len, tags, tags_len, 2, seqs, seq_lens, quals, qual_lens, out, out_len);
+}
+
+int align_read_bam(Aligner* a, const char* name, size_t name_len,
+                   const char* tags, size_t tags_len,
+                   const char* seq, size_t seq_len, const char* qual, size_t qual_len,
+                   const char** out, size_t* out_len) {
+    return align_bam(a, name, name_len, tags, tags_len, 1, &seq, &seq_len, &qual, &qual_len, out, out_len);
+}
+
+int align_read_pair_bam(Aligner* a, const char* name, size_t name_len,
+                        const char* tags, size_t tags_len,
+                        const char* seq1, size_t seq1_len, const char* qual1, size_t qual1_len,
+                        const char* seq2, size_t seq2_len, const char* qual2, size_t qual2_len,
+                        const char** out, size_t* out_len) {
+    const char* const seqs[2] = {seq1, seq2};
+    const size_t seq_lens[2] = {seq1_len, seq2_len};
+    const char* const quals[2] = {qual1, qual2};
+    const size_t qual_lens[2] = {qual1_len, qual2_len};
+    return align_bam(a, name, name_len, tags, tags_len, 2, seqs, seq_lens, quals, qual_lens, out, out_len);
 }
 
 Aligner* init_aligner_clone(const Aligner* al) {
@@ -110,15 +378,94 @@ Aligner* init_aligner_clone(const Aligner* al) {
 }
 
 Aligner* init_aligner(int argc, const char* const argv[]) {
-    return new Aligner(argc, argv);
+    unique_ptr<StarRef> ref = make_unique<StarRef>(argc, argv);
+    if (!ref->g->loadError.empty()) {
+        std::cerr << ref->g->loadError << std::flush;
+        return nullptr;
+    }
+    return new Aligner(std::move(ref));
 }
 
 const StarRef* init_star_ref(int argc, const char* const argv[]) {
     return new StarRef(argc, argv);
 }
 
+const char* ref_load_error(const StarRef* sr) {
+    return sr->g->loadError.empty() ? nullptr : sr->g->loadError.c_str();
+}
+
 Aligner* init_aligner_from_ref(const StarRef* sr) {
-    return new Aligner(sr);
+    return new Aligner(sr, Genome::numaNodeCurrent());
+}
+
+Aligner* init_aligner_on_numa_node(const StarRef* sr, int node) {
+    return new Aligner(sr, node);
+}
+
+int aligner_numa_node(const Aligner* a) {
+    return a->numa_node;
+}
+
+int bind_thread_to_numa_node(int node) {
+    return Genome::numaBindThread(node) ? 0 : -1;
+}
+
+size_t ref_numa_nodes(const StarRef* sr, int* nodes, size_t max_nodes) {
+    const std::vector<int>& placed = sr->g->numaNodes;
+    std::copy_n(placed.begin(), std::min(max_nodes, placed.size()), nodes);
+    return placed.size();
+}
+
+void aligner_scratch_usage(const Aligner* a, OrbitScratchUsage* out) {
+    ReadAlign::ScratchUsage usage = a->ra->scratchUsage();
+    out->bytes = usage.bytes;
+    out->peak_seeds = usage.peakSeeds;
+    out->peak_windows = usage.peakWindows;
+    out->peak_transcripts = usage.peakTranscripts;
+    out->peak_multimappers = usage.peakMultimappers;
+}
+
+size_t aligner_sa_hash_searches(const Aligner* a) {
+    return a->ra->SAhashSearchN;
+}
+
+size_t ref_chr_count(const StarRef* sr) {
+    return sr->g->nChrReal;
+}
+
+const char* ref_chr_name(const StarRef* sr, size_t chr) {
+    return sr->g->chrName[chr].c_str();
+}
+
+uint64_t ref_chr_length(const StarRef* sr, size_t chr) {
+    return sr->g->chrLength[chr];
+}
+
+const char* write_ref_bundle(const StarRef* sr, const char* path) {
+    sr->write_error = sr->g->bundleWrite(path);
+    return sr->write_error.empty() ? nullptr : sr->write_error.c_str();
+}
+
+const char* write_ref_checksums(const StarRef* sr) {
+    sr->write_error = sr->g->checksumsWrite();
+    return sr->write_error.empty() ? nullptr : sr->write_error.c_str();
+}
+
+const char* write_ref_sa_lcp(const StarRef* sr) {
+    sr->write_error = sr->g->SAlcpWrite();
+    return sr->write_error.empty() ? nullptr : sr->write_error.c_str();
+}
+
+void ref_huge_pages(const StarRef* sr, size_t* huge, size_t* total) {
+    *huge = sr->g->hugePagesN;
+    *total = sr->g->hugePagesTotal;
+}
+
+void ref_warm_up(const StarRef* sr, int level, size_t n_threads, OrbitWarmUpTiming* out) {
+    std::vector<double> seconds = sr->g->warmUp(std::max(level, 0), n_threads);
+    out->sa_index_seconds = seconds[0];
+    out->genome_seconds = seconds[1];
+    out->sa_seconds = seconds[2];
 }
 
 void destroy_aligner(Aligner *a) {
@@ -4,6 +4,12 @@
  * and obtaining BAM records with their alignments to the index.
  */
 
+#ifndef ORBIT_H
+#define ORBIT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -16,12 +22,159 @@ extern "C" {
     // individual reads/read pairs through the functions below
     struct Aligner;
 
-    // align_read: align an individual read and get a string of BAM records
+    // align_read: align an individual read given as a FASTQ record and get
+    // its SAM records as a malloc'd string, to be released with free
     const char* align_read(struct Aligner*, const char*);
     
-    // align_read_pair: align a pair of reads and get a string of BAM records
+    // align_read_pair: align a pair of reads given as FASTQ records and get
+    // their SAM records as a malloc'd string, to be released with free
     const char* align_read_pair(struct Aligner*, const char*, const char*);
 
+    // ORBIT_BAD_READ: status of the align_* functions when a sequence is
+    // empty, or has a quality string of another length, or is longer than the
+    // DEF_readSeqLengthMax bases STAR accepts: 650 unless built for long
+    // reads, for both mates of a pair together
+#define ORBIT_BAD_READ (-1)
+
+    // ORBIT_BAD_TAGS: status of the align_* functions taking tags when these
+    // are not valid SAM attributes
+#define ORBIT_BAD_TAGS (-2)
+
+    // ORBIT_BAD_NAME: status of the align_* functions taking a read name when
+    // it is longer than the 254 bytes a BAM record can hold
+#define ORBIT_BAD_NAME (-3)
+
+    // ORBIT_BAD_MATES: status of the align_* functions taking a number of
+    // mates when it is not 1 (single read) or 2 (read pair)
+#define ORBIT_BAD_MATES (-4)
+
+    // align_read_sam: align a read given as raw sequence and quality strings
+    // and get its SAM records named name. tags, if tags_len is not 0, holds
+    // tab-separated SAM attributes of type A, i, f or Z, such as CB and UB,
+    // to be added to each record. The text is owned by the aligner and valid
+    // until its next alignment call. Returns 0 on success
+    int align_read_sam(struct Aligner*, const char* name, size_t name_len,
+                       const char* tags, size_t tags_len,
+                       const char* seq, size_t seq_len,
+                       const char* qual, size_t qual_len,
+                       const char** out, size_t* out_len);
+
+    // align_read_pair_sam: align a read pair given as raw sequence and
+    // quality strings and get its SAM records, as align_read_sam. Returns 0
+    // on success
+    int align_read_pair_sam(struct Aligner*, const char* name, size_t name_len,
+                            const char* tags, size_t tags_len,
+                            const char* seq1, size_t seq1_len,
+                            const char* qual1, size_t qual1_len,
+                            const char* seq2, size_t seq2_len,
+                            const char* qual2, size_t qual2_len,
+                            const char** out, size_t* out_len);
+
+    // OrbitArena: caller-owned output buffer for align_reads_batch. data must
+    // be NULL or a malloc'd block of capacity bytes; it is grown with realloc
+    // as needed and must be released by the caller with free. offsets must
+    // point to n+1 entries: the records of read i are stored in
+    // data[offsets[i]..offsets[i+1]]. status, if not NULL, points to n
+    // entries receiving the align_read_bam status of each read
+    struct OrbitArena {
+        char* data;
+        size_t capacity;
+        size_t* offsets;
+        int* status;
+    };
+
+    // align_reads_batch: align n single reads (n_mates=1) or n read pairs
+    // (n_mates=2) in one call and get their BAM records, laid out as for
+    // align_read_bam. names and name_lens hold n entries, as do tags and
+    // tag_lens unless tags is NULL. seqs, seq_lens, quals and qual_lens hold
+    // n*n_mates entries, with the two mates of a pair stored next to each
+    // other. Reads with an empty mate, invalid tags or an invalid name are
+    // not aligned and get no records. If n_mates is not 1 or 2, no read is
+    // aligned and each gets the ORBIT_BAD_MATES status.
+    // Returns the total number of bytes written to the arena
+    size_t align_reads_batch(struct Aligner*, size_t n, size_t n_mates,
+                             const char* const names[], const size_t name_lens[],
+                             const char* const tags[], const size_t tag_lens[],
+                             const char* const seqs[], const size_t seq_lens[],
+                             const char* const quals[], const size_t qual_lens[],
+                             struct OrbitArena* out);
+
+    // align_read_bam: align a read given as raw sequence and quality strings
+    // and get its alignments as BAM records named name. Each record is
+    // preceded by its uint32 block_size as in a BAM file, and its read name is
+    // NUL-padded to a multiple of 4 bytes so the record can be used in memory
+    // as-is. The records are owned by the aligner and valid until its next
+    // alignment call. Returns 0 on success. Tags are added to each record as
+    // for align_read_sam. A name is not padded if its padded length would not
+    // fit in the BAM length byte
+    int align_read_bam(struct Aligner*, const char* name, size_t name_len,
+                       const char* tags, size_t tags_len,
+                       const char* seq, size_t seq_len,
+                       const char* qual, size_t qual_len,
+                       const char** out, size_t* out_len);
+
+    // align_read_pair_bam: align a read pair given as raw sequence and
+    // quality strings and get its alignments as BAM records, laid out as for
+    // align_read_bam. Returns 0 on success
+    int align_read_pair_bam(struct Aligner*, const char* name, size_t name_len,
+                            const char* tags, size_t tags_len,
+                            const char* seq1, size_t seq1_len,
+                            const char* qual1, size_t qual1_len,
+                            const char* seq2, size_t seq2_len,
+                            const char* qual2, size_t qual2_len,
+                            const char** out, size_t* out_len);
+
+    // OrbitPool: worker threads, each owning an aligner, which align reads
+    // submitted with orbit_submit in the background
+    struct OrbitPool;
+
+    // OrbitRead: a single read (n_mates=1) or read pair (n_mates=2) to align
+    // in an OrbitPool, with tags as for align_read_bam. orbit_submit copies
+    // the strings
+    struct OrbitRead {
+        const char* name;
+        size_t name_len;
+        const char* tags;
+        size_t tags_len;
+        size_t n_mates;
+        const char* seq[2];
+        size_t seq_len[2];
+        const char* qual[2];
+        size_t qual_len[2];
+    };
+
+    // OrbitCompletion: the alignments of a submitted read as BAM records
+    // laid out as for align_read_bam, and the align_read_bam status. data
+    // is owned by the pool and valid until the next orbit_poll call
+    struct OrbitCompletion {
+        uint64_t tag;
+        int status;
+        const char* data;
+        size_t len;
+    };
+
+    // init_pool: start n_threads workers aligning against a reference, with
+    // up to capacity reads submitted and not yet polled. notify, if not NULL,
+    // is called with notify_ctx from a worker thread after each completion
+    struct OrbitPool* init_pool(const struct StarRef*, size_t n_threads, size_t capacity,
+                                void (*notify)(void*), void* notify_ctx);
+
+    // orbit_submit: queue a read for alignment, identified by tag in its
+    // completion. Never blocks and may be called from any thread. Returns 0
+    // if queued, 1 if capacity reads are already in flight, ORBIT_BAD_MATES
+    // if n_mates is not 1 or 2, or ORBIT_BAD_READ if a mate is empty, as
+    // STAR rejects empty reads. Nothing is copied unless the read is queued
+    int orbit_submit(struct OrbitPool*, const struct OrbitRead*, uint64_t tag);
+
+    // orbit_poll: collect up to max completed reads without blocking, in
+    // completion order. Must not be called from several threads at once.
+    // Returns the number of completions written to out
+    size_t orbit_poll(struct OrbitPool*, struct OrbitCompletion* out, size_t max);
+
+    // destroy_pool: stop the workers and free the pool. Reads not aligned yet
+    // are dropped
+    void destroy_pool(struct OrbitPool*);
+
     // init_aligner_clone: create an aligner from the same reference as an
     // existing aligner, sharing key structures with it and saving memory in
     // multi-threaded applications
@@ -29,16 +182,109 @@ extern "C" {
     struct Aligner* init_aligner_clone(const struct Aligner*);
 
     // init_aligner: initialize an aligner given the array of parameters which
-    // would be passed to STAR
+    // would be passed to STAR. Returns NULL, after printing the error to
+    // stderr, if the reference was not loaded, see ref_load_error
     struct Aligner* init_aligner(int, const char* const[]);
 
     // init_star_ref: build a star reference with a given set of arguments
     const struct StarRef* init_star_ref(int, const char* const[]);
 
+    // ref_load_error: the error which stopped init_star_ref from loading the
+    // reference, such as genome files failing checksum verification, or NULL
+    // if it was loaded. A reference that was not loaded may only be passed to
+    // destroy_ref
+    const char* ref_load_error(const struct StarRef*);
+
     // init_aligner_from_ref takes a StarRef struct with an already built
-    // genome and builds an aligner around it
+    // genome and builds an aligner around it. With --genomeNUMA Replicate
+    // the aligner uses the replica on the NUMA node of the calling thread
     struct Aligner* init_aligner_from_ref(const struct StarRef*);
 
+    // init_aligner_on_numa_node: as init_aligner_from_ref, using the genome
+    // replica on the given NUMA node, or the main genome if there is none
+    struct Aligner* init_aligner_on_numa_node(const struct StarRef*, int node);
+
+    // aligner_numa_node: the NUMA node of the genome replica an aligner uses,
+    // or -1 if the genome is not replicated
+    int aligner_numa_node(const struct Aligner*);
+
+    // ref_numa_nodes: the NUMA nodes the genome was placed on with
+    // --genomeNUMA, one per replica or the interleave set. Writes up to
+    // max_nodes of them to nodes and returns their number, 0 if the genome
+    // was not placed
+    size_t ref_numa_nodes(const struct StarRef*, int* nodes, size_t max_nodes);
+
+    // bind_thread_to_numa_node: restrict the calling thread to the CPUs of a
+    // NUMA node, so that an aligner created on it keeps using its local
+    // replica. Returns 0 on success
+    int bind_thread_to_numa_node(int node);
+
+    // OrbitScratchUsage: the per-read working memory of an aligner, which
+    // starts small and grows as reads need more. bytes is the size currently
+    // allocated; the peak_ fields are the most seeds, alignment windows,
+    // stitched transcripts and multimapping alignments any read has needed
+    struct OrbitScratchUsage {
+        size_t bytes;
+        size_t peak_seeds;
+        size_t peak_windows;
+        size_t peak_transcripts;
+        size_t peak_multimappers;
+    };
+
+    // aligner_scratch_usage: get the working memory usage of an aligner
+    void aligner_scratch_usage(const struct Aligner*, struct OrbitScratchUsage* out);
+
+    // aligner_sa_hash_searches: the number of seed searches of an aligner that
+    // started from the suffix array range of a --genomeSAhashNbases k-mer
+    size_t aligner_sa_hash_searches(const struct Aligner*);
+
+    // ref_chr_count, ref_chr_name, ref_chr_length: the chromosomes of the
+    // reference, in the order of BAM target ids. Names are 0-terminated and
+    // owned by the reference
+    size_t ref_chr_count(const struct StarRef*);
+    const char* ref_chr_name(const struct StarRef*, size_t chr);
+    uint64_t ref_chr_length(const struct StarRef*, size_t chr);
+
+    // write_ref_bundle: write the loaded reference into a single file, which
+    // is mapped without parsing when given as --genomeDir. The file is
+    // written under a temporary name and renamed when complete. Returns
+    // NULL, or the error if it could not be written, which is owned by the
+    // reference and valid until its next write_ref_ call
+    const char* write_ref_bundle(const struct StarRef*, const char* path);
+
+    // write_ref_checksums: write the checksums of the Genome, SA and SAindex
+    // files of the reference's --genomeDir, which --genomeChecksums Verify
+    // checks when the reference is loaded. Genomes generated by STAR have
+    // them already; this adds them to existing genome directories. Returns
+    // NULL or the error, as write_ref_bundle
+    const char* write_ref_checksums(const struct StarRef*);
+
+    // write_ref_sa_lcp: write the common prefix lengths of neighbouring
+    // suffix array entries into the reference's --genomeDir, which
+    // --genomeSAlcp Use loads instead of computing them when the reference
+    // is loaded. Returns NULL or the error, as write_ref_bundle
+    const char* write_ref_sa_lcp(const struct StarRef*);
+
+    // ref_huge_pages: how many of the 2 MB pages of the genome and suffix
+    // arrays are huge pages, out of total, as counted when the reference was
+    // loaded. Both are 0 unless --genomeHugePages was given
+    void ref_huge_pages(const struct StarRef*, size_t* huge, size_t* total);
+
+    // OrbitWarmUpTiming: the seconds ref_warm_up spent on each part of the
+    // index, 0 for the parts the level does not include
+    struct OrbitWarmUpTiming {
+        double sa_index_seconds;
+        double genome_seconds;
+        double sa_seconds;
+    };
+
+    // ref_warm_up: read every page of the suffix array index (level 0), and
+    // of the genome (level 1) and of the suffix array (level 2), with
+    // n_threads threads, so that the page faults of a mapped or attached
+    // reference are taken before the first reads rather than by them
+    void ref_warm_up(const struct StarRef*, int level, size_t n_threads,
+                     struct OrbitWarmUpTiming* out);
+
     // destroy_aligner: frees the memory occupied by an aligner
     void destroy_aligner(struct Aligner*);
 
@@ -49,3 +295,5 @@ extern "C" {
 }
 #endif
 
+#endif // ORBIT_H
+
@@ -0,0 +1,259 @@
+#include <atomic>
+#include <condition_variable>
+#include <memory>  // for unique_ptr
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>  // for swap
+#include <vector>
+
+#include "orbit.h"
+
+using std::unique_ptr;
+
+namespace {
+
+// Bounded lock-free multi-producer multi-consumer ring (D. Vyukov's
+// algorithm). Each cell carries a sequence number telling whether it is
+// free for the producer or filled for the consumer of a given position.
+// Cells hold reusable values: push and pop hand them to a callback, which
+// swaps data in and out so that string buffers keep their capacity
+template <typename T>
+class MpmcRing {
+    public:
+        explicit MpmcRing(size_t capacity) {
+            size_t size = 1;
+            while (size < capacity) size *= 2;
+            cells = unique_ptr<Cell[]>(new Cell[size]);
+            mask = size-1;
+            for (size_t i = 0; i < size; i++) {
+                cells[i].seq.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        template <typename F>
+        bool push(F&& fill) {
+            size_t pos = tail.load(std::memory_order_relaxed);
+            Cell* cell;
+            for (;;) {
+                cell = &cells[pos & mask];
+                size_t seq = cell->seq.load(std::memory_order_acquire);
+                intptr_t dif = (intptr_t)seq - (intptr_t)pos;
+                if (dif == 0) {
+                    if (tail.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed)) break;
+                } else if (dif < 0) {
+                    return false;  // full
+                } else {
+                    pos = tail.load(std::memory_order_relaxed);
+                }
+            }
+            fill(cell->data);
+            cell->seq.store(pos+1, std::memory_order_release);
+            return true;
+        }
+
+        template <typename F>
+        bool pop(F&& take) {
+            size_t pos = head.load(std::memory_order_relaxed);
+            Cell* cell;
+            for (;;) {
+                cell = &cells[pos & mask];
+                size_t seq = cell->seq.load(std::memory_order_acquire);
+                intptr_t dif = (intptr_t)seq - (intptr_t)(pos+1);
+                if (dif == 0) {
+                    if (head.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed)) break;
+                } else if (dif < 0) {
+                    return false;  // empty
+                } else {
+                    pos = head.load(std::memory_order_relaxed);
+                }
+            }
+            take(cell->data);
+            cell->seq.store(pos+mask+1, std::memory_order_release);
+            return true;
+        }
+
+    private:
+        struct Cell {
+            std::atomic<size_t> seq;
+            T data;
+        };
+        unique_ptr<Cell[]> cells;
+        size_t mask;
+        // producers and consumers update different cache lines
+        alignas(64) std::atomic<size_t> tail{0};
+        alignas(64) std::atomic<size_t> head{0};
+};
+
+// A submitted read, copied out of the caller's buffers
+struct PoolRead {
+    uint64_t tag;
+    size_t n_mates;
+    std::string name;
+    std::string tags;
+    std::string seq[2];
+    std::string qual[2];
+};
+
+// The BAM records of an aligned read
+struct PoolCompletion {
+    uint64_t tag;
+    int status;
+    std::string bam;
+};
+
+}  // namespace
+
+struct OrbitPool final {
+    OrbitPool(const StarRef* ref, size_t n_threads, size_t capacity_, void (*notify_)(void*), void* notify_ctx_)
+        : capacity(capacity_),
+          notify(notify_),
+          notify_ctx(notify_ctx_),
+          reads(capacity_),
+          completions(capacity_)
+    {
+        // with a replicated genome, workers are spread over the NUMA nodes
+        // and each one runs on the node of the replica it aligns to
+        std::vector<int> nodes(ref_numa_nodes(ref, nullptr, 0));
+        ref_numa_nodes(ref, nodes.data(), nodes.size());
+        for (size_t i = 0; i < n_threads; i++) {
+            Aligner* a = nodes.empty() ? init_aligner_from_ref(ref)
+                                       : init_aligner_on_numa_node(ref, nodes[i % nodes.size()]);
+            aligners.push_back(a);
+            const int node = aligner_numa_node(a);
+            workers.emplace_back([this, a, node] {
+                if (node >= 0) bind_thread_to_numa_node(node);
+                work(a);
+            });
+        }
+    }
+
+    ~OrbitPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop.store(true);
+        }
+        wake.notify_all();
+        for (std::thread& w : workers) w.join();
+        for (Aligner* a : aligners) destroy_aligner(a);
+    }
+
+    // Align submitted reads until the pool is stopped
+    void work(Aligner* a) {
+        PoolRead read;
+        while (!stop.load()) {
+            if (!reads.pop([&](PoolRead& r) { std::swap(read, r); })) {
+                std::unique_lock<std::mutex> lock(mutex);
+                sleepers++;
+                wake.wait(lock, [this] { return stop || queued.load() > 0; });
+                sleepers--;
+                continue;
+            }
+            queued--;
+
+            const char* out = nullptr;
+            size_t out_len = 0;
+            int status;
+            if (read.n_mates == 1) {
+                status = align_read_bam(a, read.name.data(), read.name.size(),
+                                        read.tags.data(), read.tags.size(),
+                                        read.seq[0].data(), read.seq[0].size(),
+                                        read.qual[0].data(), read.qual[0].size(),
+                                        &out, &out_len);
+            } else {
+                status = align_read_pair_bam(a, read.name.data(), read.name.size(),
+                                             read.tags.data(), read.tags.size(),
+                                             read.seq[0].data(), read.seq[0].size(),
+                                             read.qual[0].data(), read.qual[0].size(),
+                                             read.seq[1].data(), read.seq[1].size(),
+                                             read.qual[1].data(), read.qual[1].size(),
+                                             &out, &out_len);
+            }
+            // cannot be full: at most capacity reads are in flight
+            completions.push([&](PoolCompletion& c) {
+                c.tag = read.tag;
+                c.status = status;
+                c.bam.assign(out, out_len);
+            });
+            if (notify != nullptr) notify(notify_ctx);
+        }
+    }
+
+    const size_t capacity;
+    void (*const notify)(void*);
+    void* const notify_ctx;
+
+    MpmcRing<PoolRead> reads;
+    MpmcRing<PoolCompletion> completions;
+    std::atomic<size_t> in_flight{0};  // submitted and not yet polled
+    std::atomic<long> queued{0};  // submitted and not yet taken by a worker
+
+    // idle workers sleep until a read is queued
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::atomic<size_t> sleepers{0};
+    std::atomic<bool> stop{false};
+
+    // completions returned by the last orbit_poll
+    std::vector<PoolCompletion> polled;
+
+    std::vector<Aligner*> aligners;
+    std::vector<std::thread> workers;
+};
+
+OrbitPool* init_pool(const StarRef* ref, size_t n_threads, size_t capacity,
+                     void (*notify)(void*), void* notify_ctx) {
+    return new OrbitPool(ref, n_threads, capacity, notify, notify_ctx);
+}
+
+int orbit_submit(OrbitPool* pool, const OrbitRead* read, uint64_t tag) {
+    if (read->n_mates != 1 && read->n_mates != 2) return ORBIT_BAD_MATES;
+    for (size_t m = 0; m < read->n_mates; m++) {
+        if (read->seq_len[m] == 0) return ORBIT_BAD_READ;
+    }
+    if (pool->in_flight.fetch_add(1) >= pool->capacity) {
+        pool->in_flight--;
+        return 1;
+    }
+    bool pushed = pool->reads.push([&](PoolRead& r) {
+        r.tag = tag;
+        r.n_mates = read->n_mates;
+        r.name.assign(read->name, read->name_len);
+        r.tags.assign(read->tags_len == 0 ? "" : read->tags, read->tags_len);
+        for (size_t m = 0; m < read->n_mates; m++) {
+            r.seq[m].assign(read->seq[m], read->seq_len[m]);
+            r.qual[m].assign(read->qual[m], read->qual_len[m]);
+        }
+    });
+    if (!pushed) {
+        pool->in_flight--;
+        return 1;
+    }
+    pool->queued++;
+    // a worker checks queued after registering as a sleeper, so either it
+    // sees this read or it is counted here and gets notified
+    if (pool->sleepers.load() > 0) {
+        { std::lock_guard<std::mutex> lock(pool->mutex); }
+        pool->wake.notify_one();
+    }
+    return 0;
+}
+
+size_t orbit_poll(OrbitPool* pool, OrbitCompletion* out, size_t max) {
+    if (pool->polled.size() < max) pool->polled.resize(max);
+    size_t n = 0;
+    while (n < max && pool->completions.pop([&](PoolCompletion& c) { std::swap(pool->polled[n], c); })) {
+        const PoolCompletion& c = pool->polled[n];
+        out[n].tag = c.tag;
+        out[n].status = c.status;
+        out[n].data = c.bam.data();
+        out[n].len = c.bam.size();
+        n++;
+    }
+    pool->in_flight -= n;
+    return n;
+}
+
+void destroy_pool(OrbitPool* pool) {
+    delete pool;
+}
@@ -81,30 +81,6 @@ int readLoad(istream& readInStream, const Parameters& P, uint iMate, uint& Lread
 //     };
 //     LreadOriginal=Lread;
     LreadOriginal=Lread;
-    if ( Lread>(P.clip5pNbases[iMate]+P.clip3pNbases[iMate]) ) {
-        Lread=Lread-(P.clip5pNbases[iMate]+P.clip3pNbases[iMate]);
-    } else {
-        Lread=0;
-    };
-    convertNucleotidesToNumbersRemoveControls(Seq+P.clip5pNbases[iMate],SeqNum,Lread);
-
-    //clip the adapter
-    if (P.clip3pAdapterSeq.at(iMate).length()>0) {
-        clip3pAdapterN = Lread-localSearch(SeqNum,Lread,P.clip3pAdapterSeqNum[iMate],P.clip3pAdapterSeq.at(iMate).length(),P.clip3pAdapterMMp[iMate]);
-        Lread = Lread>clip3pAdapterN ? Lread-clip3pAdapterN : 0;
-    } else {
-        clip3pAdapterN = 0;
-    };
-
-    //final read length, trim 3p after the adapter was clipped
-    if (Lread>P.clip3pAfterAdapterNbases[iMate]) {
-        Lread =Lread - P.clip3pAfterAdapterNbases[iMate];
-    } else {
-        Lread=0;
-    };
-
-    clip3pNtotal=P.clip3pNbases[iMate] + clip3pAdapterN + P.clip3pAfterAdapterNbases[iMate];
-    clip5pNtotal=P.clip5pNbases[iMate];
 
     if (readName[0]=='@') {//fastq format, read qualities
         readFileType=2;
@@ -119,18 +95,6 @@ int readLoad(istream& readInStream, const Parameters& P, uint iMate, uint& Lread
             errOut << "SOLUTION: fix your fastq file\n";
             exitWithError(errOut.str(),std::cerr, P.inOut->logMain, EXIT_CODE_INPUT_FILES, P);
         };
-        if (P.outQSconversionAdd!=0) {
-            for (uint ii=0;ii<LreadOriginal;ii++) {
-                int qs=int(Qual[ii])+P.outQSconversionAdd;
-                if (qs<33) {
-                    qs=33;
-                } else if (qs>126) {
-                    qs=126;
-                };
-                Qual[ii]=qs;
-            };
-        };
-
     } else if (readName[0]=='>') {//fasta format, assign Qtop to all qualities
         readFileType=1;
         for (uint ii=0;ii<LreadOriginal;ii++) Qual[ii]='A';
@@ -141,13 +105,7 @@ int readLoad(istream& readInStream, const Parameters& P, uint iMate, uint& Lread
         exitWithError(errOut.str(),std::cerr, P.inOut->logMain, EXIT_CODE_INPUT_FILES, P);
     };
 
-    for (uint ii=0;ii<Lread;ii++) {//for now: qualities are all 1
-        if (SeqNum[ii]<4) {
-            QualNum[ii]=1;
-        } else {
-            QualNum[ii]=0;
-        };
-    };
+    readClipConvert(P, iMate, readFileType, Lread, Seq, SeqNum, Qual, QualNum, clip3pNtotal, clip5pNtotal, clip3pAdapterN);
 
 //     for (uint ii=0;ii<Lread;ii++) {//simply cut too high Qs
 //         QualNum[ii]=(Qual[ii+P.clip5pNbases[iMate]] > P.QasciiSubtract) ? (Qual[ii+P.clip5pNbases[iMate]] - P.QasciiSubtract) : 0; //substract QasciiSubtract
@@ -167,3 +125,70 @@ int readLoad(istream& readInStream, const Parameters& P, uint iMate, uint& Lread
     };
     return readFileType;
 };
+
+void readClipConvert(const Parameters& P, uint iMate, int readFileType, uint& Lread, char* Seq, char* SeqNum, char* Qual, char* QualNum, uint &clip3pNtotal, uint &clip5pNtotal, uint &clip3pAdapterN) {
+    //clip the loaded read and convert it to numeric sequence and qualities
+    //on input, Lread is the original read length; on output, the clipped length
+    uint LreadOriginal=Lread;
+    if ( Lread>(P.clip5pNbases[iMate]+P.clip3pNbases[iMate]) ) {
+        Lread=Lread-(P.clip5pNbases[iMate]+P.clip3pNbases[iMate]);
+    } else {
+        Lread=0;
+    };
+    convertNucleotidesToNumbersRemoveControls(Seq+P.clip5pNbases[iMate],SeqNum,Lread);
+
+    //clip the adapter
+    if (P.clip3pAdapterSeq.at(iMate).length()>0) {
+        clip3pAdapterN = Lread-localSearch(SeqNum,Lread,P.clip3pAdapterSeqNum[iMate],P.clip3pAdapterSeq.at(iMate).length(),P.clip3pAdapterMMp[iMate]);
+        Lread = Lread>clip3pAdapterN ? Lread-clip3pAdapterN : 0;
+    } else {
+        clip3pAdapterN = 0;
+    };
+
+    //final read length, trim 3p after the adapter was clipped
+    if (Lread>P.clip3pAfterAdapterNbases[iMate]) {
+        Lread =Lread - P.clip3pAfterAdapterNbases[iMate];
+    } else {
+        Lread=0;
+    };
+
+    clip3pNtotal=P.clip3pNbases[iMate] + clip3pAdapterN + P.clip3pAfterAdapterNbases[iMate];
+    clip5pNtotal=P.clip5pNbases[iMate];
+
+    if (readFileType==2 && P.outQSconversionAdd!=0) {
+        for (uint ii=0;ii<LreadOriginal;ii++) {
+            int qs=int(Qual[ii])+P.outQSconversionAdd;
+            if (qs<33) {
+                qs=33;
+            } else if (qs>126) {
+                qs=126;
+            };
+            Qual[ii]=qs;
+        };
+    };
+
+    for (uint ii=0;ii<Lread;ii++) {//for now: qualities are all 1
+        if (SeqNum[ii]<4) {
+            QualNum[ii]=1;
+        } else {
+            QualNum[ii]=0;
+        };
+    };
+};
+
+int readLoadRaw(const char* seqIn, uint seqLen, const char* qualIn, uint qualLen, const Parameters& P, uint iMate, uint& Lread, uint& LreadOriginal, char* Seq, char* SeqNum, char* Qual, char* QualNum, uint &clip3pNtotal, uint &clip5pNtotal, uint &clip3pAdapterN) {
+    //load one read given as raw sequence and quality strings, without a name
+    //the caller reports invalid reads: empty, longer than DEF_readSeqLengthMax, or with a quality string of another length
+    if (seqLen<1 || seqLen>DEF_readSeqLengthMax || qualLen!=seqLen)
+        return -1;
+
+    memcpy(Seq,seqIn,seqLen);
+    Seq[seqLen]=0;
+    memcpy(Qual,qualIn,qualLen);
+    Qual[qualLen]=0;
+
+    Lread=seqLen;
+    LreadOriginal=seqLen;
+    readClipConvert(P, iMate, 2, Lread, Seq, SeqNum, Qual, QualNum, clip3pNtotal, clip5pNtotal, clip3pAdapterN);
+    return 2;
+};
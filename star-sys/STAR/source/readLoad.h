@@ -6,5 +6,8 @@
 #include "SequenceFuns.h"
 
 int readLoad(istream& readInStream, const Parameters &P, uint iMate, uint& Lread, uint& readLengthPairOriginal, char* readName, char* Seq, char* SeqNum, char* Qual, char* QualNum, uint &clip3pNtotal, uint &clip5pNtotal, uint &clip3pAdapterN, uint &iReadAll, uint &readFilesIndex, char &readFilter, string &readNameExtra);
+//readLoadRaw returns -1 without loading the read if it is empty, longer than DEF_readSeqLengthMax, or its quality string has another length
+int readLoadRaw(const char* seqIn, uint seqLen, const char* qualIn, uint qualLen, const Parameters &P, uint iMate, uint& Lread, uint& LreadOriginal, char* Seq, char* SeqNum, char* Qual, char* QualNum, uint &clip3pNtotal, uint &clip5pNtotal, uint &clip3pAdapterN);
+void readClipConvert(const Parameters &P, uint iMate, int readFileType, uint& Lread, char* Seq, char* SeqNum, char* Qual, char* QualNum, uint &clip3pNtotal, uint &clip5pNtotal, uint &clip3pAdapterN);
 
 #endif
@@ -121,7 +121,7 @@ void sjdbBuildIndex (Parameters &P, char *Gsj, char *G, PackedArray &SA, PackedA
         exitWithError(errOut.str(),std::cerr, P.inOut->logMain, EXIT_CODE_GENOME_FILES, P);
     };
 
-    SA2.defineBits(mapGen.GstrandBit+1,mapGen.nSA);
+    SA2.defineBits(mapGen.SAbits(),mapGen.nSA);
     uint nGsjNew=sjNew*mapGen.sjdbLength; //this is the actual number of bytes added to the genome, while nGsj is the total size of all junctions
 
     uint N2bit= 1LLU << mapGen.GstrandBit;
@@ -129,7 +129,7 @@ void sjdbBuildIndex (Parameters &P, char *Gsj, char *G, PackedArray &SA, PackedA
 
     /*testing
     PackedArray SAo;
-    SAo.defineBits(mapGen.GstrandBit+1,mapGen.nSA);
+    SAo.defineBits(mapGen.SAbits(),mapGen.nSA);
     SAo.allocateArray();
     ifstream oldSAin("./DirTrue/SA");
     oldSAin.read(SAo.charArray,SAo.lengthByte);
@@ -284,7 +284,7 @@ void sjdbBuildIndex (Parameters &P, char *Gsj, char *G, PackedArray &SA, PackedA
     P.inOut->logMain  << timeMonthDayTime(rawtime) << "   Finished SAi" <<endl;
 
     //change parameters, most parameters are already re-defined in sjdbPrepare.cpp
-    SA.defineBits(mapGen.GstrandBit+1,mapGen.nSA);//same as SA2
+    SA.defineBits(mapGen.SAbits(),mapGen.nSA);//same as SA2
     SA.pointArray(SA2.charArray);
     mapGen.nSAbyte=SA.lengthByte;
     mapGen.sjGstart=mapGen.chrStart[mapGen.nChrReal];
@@ -4,6 +4,13 @@
 #include <sys/statvfs.h>
 #include <sys/stat.h>
 #include <stdio.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
 #define fstream_Chunk_Max 2147483647
 
 unsigned long long fstreamReadBig(std::ifstream &S, char* A, unsigned long long N) {
@@ -18,6 +25,77 @@ unsigned long long fstreamReadBig(std::ifstream &S, char* A, unsigned long long
     return C;
 };
 
+void preadParallel(std::vector<FileReadRegion> &regions, unsigned long long threadN, unsigned long long chunkBytes, const Parameters &P)
+{//read file regions with pread in chunks, from a pool of threads. Logs the time spent on each file
+    struct Chunk {
+        unsigned long long iRegion, offset, bytes, bytesRead;
+        int errnoRead;
+        std::chrono::steady_clock::time_point end;
+    };
+    std::vector<int> fds;
+    std::vector<Chunk> chunks;
+    for (unsigned long long ir=0; ir<regions.size(); ir++) {
+        int fd=open(regions[ir].fileName.c_str(), O_RDONLY);
+        if (fd<0) {
+            ostringstream errOut;
+            errOut << "EXITING because of FATAL ERROR: could not open genome file: " << regions[ir].fileName << ": " << strerror(errno) << "\n";
+            errOut << "SOLUTION: check that the path to genome files, specified in --genomeDir is correct and the files are present, and have user read permissions\n" <<flush;
+            exitWithError(errOut.str(),std::cerr, P.inOut->logMain, EXIT_CODE_GENOME_FILES, P);
+        };
+        fds.push_back(fd);
+        for (unsigned long long c=0; c<regions[ir].bytes; c+=chunkBytes)
+            chunks.push_back({ir, c, std::min(chunkBytes, regions[ir].bytes-c), 0, 0, {}});
+    };
+
+    auto start=std::chrono::steady_clock::now();
+    std::atomic<unsigned long long> chunkNext(0);
+    auto readChunks=[&]() {
+        for (unsigned long long ic=chunkNext++; ic<chunks.size(); ic=chunkNext++) {
+            Chunk &c=chunks[ic];
+            FileReadRegion &r=regions[c.iRegion];
+            while (c.bytesRead<c.bytes) {
+                ssize_t n=pread(fds[c.iRegion], r.array+c.offset+c.bytesRead, c.bytes-c.bytesRead, r.offset+c.offset+c.bytesRead);
+                if (n<0 && errno==EINTR)
+                    continue;
+                if (n<0)
+                    c.errnoRead=errno;
+                if (n<=0)
+                    break; //error, or the end of the file
+                c.bytesRead+=n;
+            };
+            c.end=std::chrono::steady_clock::now();
+        };
+    };
+    std::vector<std::thread> threads;
+    for (unsigned long long it=1; it<std::min(threadN, (unsigned long long) chunks.size()); it++)
+        threads.emplace_back(readChunks);
+    readChunks();
+    for (auto &t : threads)
+        t.join();
+    for (int fd : fds)
+        close(fd);
+
+    for (auto &r : regions)
+        r.bytesRead=0;
+    std::vector<std::chrono::steady_clock::time_point> ends(regions.size(), start);
+    for (auto &c : chunks) {
+        if (c.errnoRead!=0) {
+            ostringstream errOut;
+            errOut << "EXITING because of FATAL ERROR: failed reading genome file: " << regions[c.iRegion].fileName << " at byte " << regions[c.iRegion].offset+c.offset+c.bytesRead << ": " << strerror(c.errnoRead) << "\n";
+            errOut << "SOLUTION: check that the genome files are readable, or re-generate the genome index\n" <<flush;
+            exitWithError(errOut.str(),std::cerr, P.inOut->logMain, EXIT_CODE_GENOME_FILES, P);
+        };
+        regions[c.iRegion].bytesRead+=c.bytesRead;
+        ends[c.iRegion]=std::max(ends[c.iRegion], c.end);
+    };
+    for (unsigned long long ir=0; ir<regions.size(); ir++) {
+        P.inOut->logMain << "Loaded " << regions[ir].fileName << ": " << regions[ir].bytesRead << " bytes in " \
+                         << std::chrono::duration<double>(ends[ir]-start).count() << " s\n";
+    };
+    P.inOut->logMain << "Read " << regions.size() << " files with " << std::min(threadN, (unsigned long long) chunks.size()) << " threads in " \
+                     << std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count() << " s\n" << flush;
+};
+
 void fstreamWriteBig(std::ofstream &S, char* A, unsigned long long N, std::string fileName, std::string errorID, const Parameters &P) {
 
     struct statvfs statvfsBuf;
@@ -58,6 +136,12 @@ void fstreamWriteBig(std::ofstream &S, char* A, unsigned long long N, std::strin
     P.inOut->logMain << " done\n" <<flush;
 };
 
+bool fstreamWriteChunks(std::ofstream &S, const char* A, unsigned long long N) {
+    for (unsigned long long C=0; C<N && !S.fail(); C+=fstream_Chunk_Max)
+        S.write(A+C,min(N-C,(unsigned long long) fstream_Chunk_Max));
+    return !S.fail();
+};
+
 std::ofstream &ofstrOpen (std::string fileName, std::string errorID, const Parameters &P) {//open file 'fileName', generate error if cannot open
     std::ofstream & ofStream = *new std::ofstream(fileName.c_str(), std::fstream::out | std::fstream::trunc);
     if (ofStream.fail()) {//
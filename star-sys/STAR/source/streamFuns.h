@@ -5,7 +5,16 @@
 #include <fstream>
 
 unsigned long long fstreamReadBig(std::ifstream &S, char* A, unsigned long long N);
+
+struct FileReadRegion {//a region of a file to read with preadParallel
+    std::string fileName;
+    unsigned long long offset, bytes; //bytes may extend past the end of the file
+    char *array;
+    unsigned long long bytesRead; //set by preadParallel
+};
+void preadParallel(std::vector<FileReadRegion> &regions, unsigned long long threadN, unsigned long long chunkBytes, const Parameters &P);
 void fstreamWriteBig(std::ofstream &S, char* A, unsigned long long N, std::string fileName, std::string errorID, const Parameters &P) ;
+bool fstreamWriteChunks(std::ofstream &S, const char* A, unsigned long long N); //as fstreamWriteBig, returns false on a failure instead of exiting
 
 fstream  &fstrOpen  (std::string fileName, std::string errorID, const Parameters &P);
 ofstream &ofstrOpen (std::string fileName, std::string errorID, const Parameters &P);
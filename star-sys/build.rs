@@ -21,15 +21,24 @@ fn libcxx() -> &'static str {
 
 const FILES: &[&str] = &[
     "STAR/source/orbit.cpp",
+    "STAR/source/orbit_pool.cpp",
     "STAR/source/InOutStreams.cpp",
     "STAR/source/Parameters.cpp",
     "STAR/source/ParametersSolo.cpp",
     "STAR/source/ParametersChimeric_initialize.cpp",
     "STAR/source/PackedArray.cpp",
+    "STAR/source/XXH64.cpp",
     "STAR/source/SequenceFuns.cpp",
     "STAR/source/Genome.cpp",
     "STAR/source/Genome_insertSequences.cpp",
     "STAR/source/Genome_genomeGenerate.cpp",
+    "STAR/source/Genome_bundle.cpp",
+    "STAR/source/Genome_numa.cpp",
+    "STAR/source/Genome_warmUp.cpp",
+    "STAR/source/Genome_checksums.cpp",
+    "STAR/source/Genome_SAlcp.cpp",
+    "STAR/source/Genome_SAhash.cpp",
+    "STAR/source/SharedMemory.cpp",
     "STAR/source/streamFuns.cpp",
     "STAR/source/genomeScanFastaFiles.cpp",
     "STAR/source/TimeFunctions.cpp",
@@ -41,10 +50,12 @@ const FILES: &[&str] = &[
     "STAR/source/genomeSAindex.cpp",
     "STAR/source/ReadAlign_outputAlignments.cpp",
     "STAR/source/ReadAlign_outputTranscriptSAM.cpp",
+    "STAR/source/ReadAlign_alignBAM.cpp",
     "STAR/source/ReadAlign_quantTranscriptome.cpp",
     "STAR/source/ReadAlign_calcCIGAR.cpp",
     "STAR/source/ReadAlign_storeAligns.cpp",
     "STAR/source/SuffixArrayFuns.cpp",
+    "STAR/source/SeedPrefetch.cpp",
     "STAR/source/ReadAlign_oneRead.cpp",
     "STAR/source/ReadAlign_mapOneRead.cpp",
     "STAR/source/ReadAlign_stitchPieces.cpp",
@@ -73,6 +84,7 @@ const HEADERS: &[&str] = &[
     "STAR/source/funCompareUintAndSuffixes.h",
     "STAR/source/funCompareUintAndSuffixesMemcmp.h",
     "STAR/source/Genome.h",
+    "STAR/source/SharedMemory.h",
     "STAR/source/genomeParametersWrite.h",
     "STAR/source/genomeSAindex.h",
     "STAR/source/genomeScanFastaFiles.h",
@@ -85,12 +97,14 @@ const HEADERS: &[&str] = &[
     "STAR/source/orbit.h",
     "STAR/source/OutSJ.h",
     "STAR/source/PackedArray.h",
+    "STAR/source/XXH64.h",
     "STAR/source/ParametersChimeric.h",
     "STAR/source/parametersDefault.xxd",
     "STAR/source/Parameters.h",
     "STAR/source/ParametersSolo.h",
     "STAR/source/ReadAlign.h",
     "STAR/source/readLoad.h",
+    "STAR/source/SAMtext.h",
     "STAR/source/SequenceFuns.h",
     "STAR/source/serviceFuns.cpp",
     "STAR/source/sjAlignSplit.cpp",
@@ -104,15 +118,19 @@ const HEADERS: &[&str] = &[
     "STAR/source/streamFuns.h",
     "STAR/source/stringSubstituteAll.h",
     "STAR/source/SuffixArrayFuns.h",
+    "STAR/source/SeedPrefetch.h",
     "STAR/source/sysRemoveDir.h",
     "STAR/source/TimeFunctions.h",
     "STAR/source/Transcript.h",
     "STAR/source/Transcriptome.h",
 ];
 
+// Only compiled with the compare-benchmark feature, for the compare_seq_to_genome bench of orbit
+const BENCHMARK_FILES: &[&str] = &["STAR/source/SuffixArrayFuns_benchmark.cpp"];
+
 fn main() {
     // do not rebuild constitutively
-    for file in FILES {
+    for file in FILES.iter().chain(BENCHMARK_FILES) {
         println!("cargo:rerun-if-changed={file}");
     }
     for file in HEADERS {
@@ -124,12 +142,16 @@ fn main() {
         .cpp_link_stdlib(Some(libcxx()))
         .define("COMPILATION_TIME_PLACE", "\"build.rs\"")
         .define("_LIBCPP_REMOVE_TRANSITIVE_INCLUDES", None)
+        .define("POSIX_SHARED_MEM", None)
         .files(FILES)
         .flag("-std=c++17")
         .flag("-Wall")
         .flag("-Wextra")
         .flag("-Werror")
         .flag("-fvisibility=hidden");
+    if env::var_os("CARGO_FEATURE_COMPARE_BENCHMARK").is_some() {
+        build.files(BENCHMARK_FILES);
+    }
 
     if cfg!(target_feature = "sse3") {
         build.flag("-msse3");
@@ -157,6 +179,9 @@ fn main() {
     if cfg!(target_feature = "avx") {
         build.flag("-mavx");
     }
+    if cfg!(target_feature = "avx2") {
+        build.flag("-mavx2");
+    }
     if cfg!(target_feature = "bmi1") && cfg!(target_feature = "bmi2") {
         build.flag("-mbmi");
     }
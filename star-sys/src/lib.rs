@@ -24,15 +24,246 @@ extern "C" {
         arg3: *const ::std::os::raw::c_char,
     ) -> *const ::std::os::raw::c_char;
 }
+pub const ORBIT_BAD_READ: i32 = -1;
+pub const ORBIT_BAD_TAGS: i32 = -2;
+pub const ORBIT_BAD_NAME: i32 = -3;
+pub const ORBIT_BAD_MATES: i32 = -4;
+extern "C" {
+    pub fn align_read_sam(
+        arg1: *mut Aligner,
+        name: *const ::std::os::raw::c_char,
+        name_len: usize,
+        tags: *const ::std::os::raw::c_char,
+        tags_len: usize,
+        seq: *const ::std::os::raw::c_char,
+        seq_len: usize,
+        qual: *const ::std::os::raw::c_char,
+        qual_len: usize,
+        out: *mut *const ::std::os::raw::c_char,
+        out_len: *mut usize,
+    ) -> ::std::os::raw::c_int;
+}
+extern "C" {
+    pub fn align_read_pair_sam(
+        arg1: *mut Aligner,
+        name: *const ::std::os::raw::c_char,
+        name_len: usize,
+        tags: *const ::std::os::raw::c_char,
+        tags_len: usize,
+        seq1: *const ::std::os::raw::c_char,
+        seq1_len: usize,
+        qual1: *const ::std::os::raw::c_char,
+        qual1_len: usize,
+        seq2: *const ::std::os::raw::c_char,
+        seq2_len: usize,
+        qual2: *const ::std::os::raw::c_char,
+        qual2_len: usize,
+        out: *mut *const ::std::os::raw::c_char,
+        out_len: *mut usize,
+    ) -> ::std::os::raw::c_int;
+}
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct OrbitArena {
+    pub data: *mut ::std::os::raw::c_char,
+    pub capacity: usize,
+    pub offsets: *mut usize,
+    pub status: *mut ::std::os::raw::c_int,
+}
+extern "C" {
+    pub fn align_reads_batch(
+        arg1: *mut Aligner,
+        n: usize,
+        n_mates: usize,
+        names: *const *const ::std::os::raw::c_char,
+        name_lens: *const usize,
+        tags: *const *const ::std::os::raw::c_char,
+        tag_lens: *const usize,
+        seqs: *const *const ::std::os::raw::c_char,
+        seq_lens: *const usize,
+        quals: *const *const ::std::os::raw::c_char,
+        qual_lens: *const usize,
+        out: *mut OrbitArena,
+    ) -> usize;
+}
+extern "C" {
+    pub fn align_read_bam(
+        arg1: *mut Aligner,
+        name: *const ::std::os::raw::c_char,
+        name_len: usize,
+        tags: *const ::std::os::raw::c_char,
+        tags_len: usize,
+        seq: *const ::std::os::raw::c_char,
+        seq_len: usize,
+        qual: *const ::std::os::raw::c_char,
+        qual_len: usize,
+        out: *mut *const ::std::os::raw::c_char,
+        out_len: *mut usize,
+    ) -> ::std::os::raw::c_int;
+}
+extern "C" {
+    pub fn align_read_pair_bam(
+        arg1: *mut Aligner,
+        name: *const ::std::os::raw::c_char,
+        name_len: usize,
+        tags: *const ::std::os::raw::c_char,
+        tags_len: usize,
+        seq1: *const ::std::os::raw::c_char,
+        seq1_len: usize,
+        qual1: *const ::std::os::raw::c_char,
+        qual1_len: usize,
+        seq2: *const ::std::os::raw::c_char,
+        seq2_len: usize,
+        qual2: *const ::std::os::raw::c_char,
+        qual2_len: usize,
+        out: *mut *const ::std::os::raw::c_char,
+        out_len: *mut usize,
+    ) -> ::std::os::raw::c_int;
+}
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct OrbitPool {
+    _unused: [u8; 0],
+}
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct OrbitRead {
+    pub name: *const ::std::os::raw::c_char,
+    pub name_len: usize,
+    pub tags: *const ::std::os::raw::c_char,
+    pub tags_len: usize,
+    pub n_mates: usize,
+    pub seq: [*const ::std::os::raw::c_char; 2usize],
+    pub seq_len: [usize; 2usize],
+    pub qual: [*const ::std::os::raw::c_char; 2usize],
+    pub qual_len: [usize; 2usize],
+}
+#[repr(C)]
+#[derive(Debug, Copy, Clone)]
+pub struct OrbitCompletion {
+    pub tag: u64,
+    pub status: ::std::os::raw::c_int,
+    pub data: *const ::std::os::raw::c_char,
+    pub len: usize,
+}
+extern "C" {
+    pub fn init_pool(
+        arg1: *const StarRef,
+        n_threads: usize,
+        capacity: usize,
+        notify: ::std::option::Option<unsafe extern "C" fn(arg1: *mut ::std::os::raw::c_void)>,
+        notify_ctx: *mut ::std::os::raw::c_void,
+    ) -> *mut OrbitPool;
+}
+extern "C" {
+    pub fn orbit_submit(
+        arg1: *mut OrbitPool,
+        read: *const OrbitRead,
+        tag: u64,
+    ) -> ::std::os::raw::c_int;
+}
+extern "C" {
+    pub fn orbit_poll(arg1: *mut OrbitPool, out: *mut OrbitCompletion, max: usize) -> usize;
+}
+extern "C" {
+    pub fn destroy_pool(arg1: *mut OrbitPool);
+}
 extern "C" {
     pub fn init_star_ref(
         arg1: ::std::os::raw::c_int,
         arg2: *const *const ::std::os::raw::c_char,
     ) -> *const StarRef;
 }
+extern "C" {
+    pub fn ref_load_error(arg1: *const StarRef) -> *const ::std::os::raw::c_char;
+}
 extern "C" {
     pub fn init_aligner_from_ref(arg1: *const StarRef) -> *mut Aligner;
 }
+extern "C" {
+    pub fn init_aligner_on_numa_node(
+        arg1: *const StarRef,
+        node: ::std::os::raw::c_int,
+    ) -> *mut Aligner;
+}
+extern "C" {
+    pub fn aligner_numa_node(arg1: *const Aligner) -> ::std::os::raw::c_int;
+}
+extern "C" {
+    pub fn ref_numa_nodes(
+        arg1: *const StarRef,
+        nodes: *mut ::std::os::raw::c_int,
+        max_nodes: usize,
+    ) -> usize;
+}
+extern "C" {
+    pub fn bind_thread_to_numa_node(node: ::std::os::raw::c_int) -> ::std::os::raw::c_int;
+}
+#[repr(C)]
+#[derive(Debug, Default, Copy, Clone)]
+pub struct OrbitScratchUsage {
+    pub bytes: usize,
+    pub peak_seeds: usize,
+    pub peak_windows: usize,
+    pub peak_transcripts: usize,
+    pub peak_multimappers: usize,
+}
+extern "C" {
+    pub fn aligner_scratch_usage(arg1: *const Aligner, out: *mut OrbitScratchUsage);
+}
+extern "C" {
+    pub fn aligner_sa_hash_searches(arg1: *const Aligner) -> usize;
+}
+extern "C" {
+    pub fn ref_chr_count(arg1: *const StarRef) -> usize;
+}
+extern "C" {
+    pub fn ref_chr_name(arg1: *const StarRef, chr: usize) -> *const ::std::os::raw::c_char;
+}
+extern "C" {
+    pub fn ref_chr_length(arg1: *const StarRef, chr: usize) -> u64;
+}
+extern "C" {
+    pub fn write_ref_bundle(
+        arg1: *const StarRef,
+        path: *const ::std::os::raw::c_char,
+    ) -> *const ::std::os::raw::c_char;
+}
+extern "C" {
+    pub fn write_ref_checksums(arg1: *const StarRef) -> *const ::std::os::raw::c_char;
+}
+extern "C" {
+    pub fn write_ref_sa_lcp(arg1: *const StarRef) -> *const ::std::os::raw::c_char;
+}
+extern "C" {
+    pub fn ref_huge_pages(arg1: *const StarRef, huge: *mut usize, total: *mut usize);
+}
+#[repr(C)]
+#[derive(Debug, Default, Copy, Clone)]
+pub struct OrbitWarmUpTiming {
+    pub sa_index_seconds: f64,
+    pub genome_seconds: f64,
+    pub sa_seconds: f64,
+}
+extern "C" {
+    pub fn ref_warm_up(
+        arg1: *const StarRef,
+        level: ::std::os::raw::c_int,
+        n_threads: usize,
+        out: *mut OrbitWarmUpTiming,
+    );
+}
+#[cfg(feature = "compare-benchmark")]
+extern "C" {
+    pub fn compare_benchmark(
+        argc: ::std::os::raw::c_int,
+        argv: *const *const ::std::os::raw::c_char,
+        n: usize,
+        read_len: usize,
+        vector_seconds: *mut f64,
+        scalar_seconds: *mut f64,
+    ) -> usize;
+}
 extern "C" {
     pub fn destroy_aligner(arg1: *mut Aligner);
 }